@@ -0,0 +1,9 @@
+{
+  "targets": [
+    {
+      "target_name": "ossm_can",
+      "sources": ["can_raw.c"],
+      "cflags": ["-O2", "-Wall", "-Wextra"]
+    }
+  ]
+}
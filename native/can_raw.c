@@ -0,0 +1,421 @@
+// Batched CAN_RAW socket I/O for CanBus
+//
+// Frames are pulled with recvmmsg() and written straight into the typed
+// arrays of a JS FrameBatch, and pushed with sendmmsg(), so a burst of
+// frames costs a few syscalls and one JS callback instead of one of each
+// per frame. Readiness comes from a uv_poll handle on Node's own loop.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#include <node_api.h>
+#include <uv.h>
+
+#define MAX_BATCH 256
+#define MAX_FILTERS 512
+
+enum { ARR_IDS, ARR_EXT, ARR_DLCS, ARR_DATA, ARR_TIMESTAMPS, ARR_COUNT };
+
+typedef struct {
+  int fd;
+  napi_env env;
+  uv_poll_t poll;
+  napi_ref on_readable;
+  napi_async_context async_ctx;
+
+  // FrameBatch arrays, kept alive by references while the socket is open
+  napi_ref arrays[ARR_COUNT];
+  uint32_t *ids;
+  uint8_t *ext;
+  uint8_t *dlcs;
+  uint8_t *data;
+  double *timestamps;
+  size_t capacity;
+
+  // recvmmsg / sendmmsg scratch
+  struct can_frame frames[MAX_BATCH];
+  struct iovec iov[MAX_BATCH];
+  struct mmsghdr msgs[MAX_BATCH];
+  char control[MAX_BATCH][CMSG_SPACE(sizeof(struct timeval))];
+  struct can_frame tx_frames[MAX_BATCH];
+  struct iovec tx_iov[MAX_BATCH];
+  struct mmsghdr tx_msgs[MAX_BATCH];
+} can_socket;
+
+#define CALL(env, call)                                   \
+  do {                                                    \
+    if ((call) != napi_ok) {                              \
+      throw_last(env);                                    \
+      return NULL;                                        \
+    }                                                     \
+  } while (0)
+
+static void throw_last(napi_env env) {
+  bool pending = false;
+  napi_is_exception_pending(env, &pending);
+  if (pending) return;
+  const napi_extended_error_info *info = NULL;
+  napi_get_last_error_info(env, &info);
+  napi_throw_error(env, NULL, info && info->error_message ? info->error_message : "N-API call failed");
+}
+
+// Throw an Error whose .code is the errno name (e.g. "ENOBUFS")
+static napi_value throw_errno(napi_env env, const char *what, int err) {
+  char msg[256];
+  snprintf(msg, sizeof(msg), "%s: %s", what, strerror(err));
+  napi_throw_error(env, uv_err_name(-err), msg);
+  return NULL;
+}
+
+static can_socket *get_socket(napi_env env, napi_value value) {
+  can_socket *s = NULL;
+  if (napi_get_value_external(env, value, (void **)&s) != napi_ok || s == NULL) {
+    napi_throw_type_error(env, NULL, "Expected a CAN socket handle");
+    return NULL;
+  }
+  if (s->fd < 0) {
+    napi_throw_error(env, NULL, "CAN socket is closed");
+    return NULL;
+  }
+  return s;
+}
+
+static void *typed_array(napi_env env, napi_value value, napi_typedarray_type want, size_t *length) {
+  bool is_typed = false;
+  napi_typedarray_type type;
+  void *data = NULL;
+  if (napi_is_typedarray(env, value, &is_typed) != napi_ok || !is_typed) return NULL;
+  if (napi_get_typedarray_info(env, value, &type, length, &data, NULL, NULL) != napi_ok) return NULL;
+  return type == want ? data : NULL;
+}
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (double)ts.tv_sec * 1e6 + (double)(ts.tv_nsec / 1000);
+}
+
+static void release(can_socket *s) {
+  if (s->fd < 0) return;
+  uv_poll_stop(&s->poll);
+  close(s->fd);
+  s->fd = -1;
+
+  napi_env env = s->env;
+  napi_delete_reference(env, s->on_readable);
+  for (int i = 0; i < ARR_COUNT; i++) napi_delete_reference(env, s->arrays[i]);
+  napi_async_destroy(env, s->async_ctx);
+  s->ids = NULL;
+  s->ext = NULL;
+  s->dlcs = NULL;
+  s->data = NULL;
+  s->timestamps = NULL;
+  s->capacity = 0;
+}
+
+static void on_handle_closed(uv_handle_t *handle) {
+  free(handle->data);
+}
+
+static void finalize_socket(napi_env env, void *data, void *hint) {
+  (void)env;
+  (void)hint;
+  can_socket *s = data;
+  release(s);
+  uv_close((uv_handle_t *)&s->poll, on_handle_closed);
+}
+
+// Socket readable: let JS drain it with recv()
+static void on_poll(uv_poll_t *handle, int status, int events) {
+  (void)status;
+  (void)events;
+  can_socket *s = handle->data;
+  if (s->fd < 0) return;
+
+  napi_env env = s->env;
+  napi_handle_scope scope;
+  napi_value callback, recv;
+  napi_open_handle_scope(env, &scope);
+  napi_get_reference_value(env, s->on_readable, &callback);
+  napi_get_undefined(env, &recv);
+  if (napi_make_callback(env, s->async_ctx, recv, callback, 0, NULL, NULL) == napi_pending_exception) {
+    napi_value err;
+    napi_get_and_clear_last_exception(env, &err);
+    napi_fatal_exception(env, err);
+  }
+  napi_close_handle_scope(env, scope);
+}
+
+// open(ifname, ids, ext, dlcs, data, timestamps, onReadable) -> handle
+static napi_value js_open(napi_env env, napi_callback_info info) {
+  size_t argc = 7;
+  napi_value argv[7];
+  CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+  if (argc < 7) {
+    napi_throw_type_error(env, NULL, "open(ifname, ids, ext, dlcs, data, timestamps, onReadable)");
+    return NULL;
+  }
+
+  char ifname[IFNAMSIZ];
+  size_t len = 0;
+  CALL(env, napi_get_value_string_utf8(env, argv[0], ifname, sizeof(ifname), &len));
+
+  size_t n_ids, n_ext, n_dlcs, n_data, n_ts;
+  uint32_t *ids = typed_array(env, argv[1], napi_uint32_array, &n_ids);
+  uint8_t *ext = typed_array(env, argv[2], napi_uint8_array, &n_ext);
+  uint8_t *dlcs = typed_array(env, argv[3], napi_uint8_array, &n_dlcs);
+  uint8_t *data = typed_array(env, argv[4], napi_uint8_array, &n_data);
+  double *timestamps = typed_array(env, argv[5], napi_float64_array, &n_ts);
+  if (!ids || !ext || !dlcs || !data || !timestamps) {
+    napi_throw_type_error(env, NULL, "Batch arrays must be Uint32Array, Uint8Array x3 and Float64Array");
+    return NULL;
+  }
+  size_t capacity = n_ids;
+  if (n_ext < capacity) capacity = n_ext;
+  if (n_dlcs < capacity) capacity = n_dlcs;
+  if (n_data / 8 < capacity) capacity = n_data / 8;
+  if (n_ts < capacity) capacity = n_ts;
+
+  unsigned int index = if_nametoindex(ifname);
+  if (index == 0) return throw_errno(env, ifname, errno);
+
+  int fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+  if (fd < 0) return throw_errno(env, "socket", errno);
+
+  int on = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on)) < 0) {
+    int err = errno;
+    close(fd);
+    return throw_errno(env, "SO_TIMESTAMP", err);
+  }
+
+  struct sockaddr_can addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = (int)index;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    int err = errno;
+    close(fd);
+    return throw_errno(env, ifname, err);
+  }
+
+  can_socket *s = calloc(1, sizeof(*s));
+  if (!s) {
+    close(fd);
+    return throw_errno(env, "calloc", ENOMEM);
+  }
+  s->fd = fd;
+  s->env = env;
+  s->ids = ids;
+  s->ext = ext;
+  s->dlcs = dlcs;
+  s->data = data;
+  s->timestamps = timestamps;
+  s->capacity = capacity;
+  for (int i = 0; i < ARR_COUNT; i++) napi_create_reference(env, argv[1 + i], 1, &s->arrays[i]);
+  napi_create_reference(env, argv[6], 1, &s->on_readable);
+
+  napi_value resource, name;
+  napi_create_object(env, &resource);
+  napi_create_string_utf8(env, "ossm:CanSocket", NAPI_AUTO_LENGTH, &name);
+  napi_async_init(env, resource, name, &s->async_ctx);
+
+  uv_loop_t *loop = NULL;
+  napi_get_uv_event_loop(env, &loop);
+  uv_poll_init(loop, &s->poll, fd);
+  s->poll.data = s;
+  uv_poll_start(&s->poll, UV_READABLE, on_poll);
+
+  napi_value handle;
+  if (napi_create_external(env, s, finalize_socket, NULL, &handle) != napi_ok) {
+    finalize_socket(env, s, NULL);
+    throw_last(env);
+    return NULL;
+  }
+  return handle;
+}
+
+// recv(handle, offset, max) -> frames written at [offset, offset + n)
+static napi_value js_recv(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value argv[3];
+  uint32_t offset, max;
+  CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+  can_socket *s = get_socket(env, argv[0]);
+  if (!s) return NULL;
+  CALL(env, napi_get_value_uint32(env, argv[1], &offset));
+  CALL(env, napi_get_value_uint32(env, argv[2], &max));
+
+  if (offset >= s->capacity) max = 0;
+  else if (max > s->capacity - offset) max = (uint32_t)(s->capacity - offset);
+  if (max > MAX_BATCH) max = MAX_BATCH;
+
+  int n = 0;
+  if (max > 0) {
+    for (uint32_t i = 0; i < max; i++) {
+      s->iov[i].iov_base = &s->frames[i];
+      s->iov[i].iov_len = sizeof(struct can_frame);
+      memset(&s->msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+      s->msgs[i].msg_hdr.msg_iov = &s->iov[i];
+      s->msgs[i].msg_hdr.msg_iovlen = 1;
+      s->msgs[i].msg_hdr.msg_control = s->control[i];
+      s->msgs[i].msg_hdr.msg_controllen = sizeof(s->control[i]);
+    }
+
+    n = recvmmsg(s->fd, s->msgs, max, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) n = 0;
+      else return throw_errno(env, "recvmmsg", errno);
+    }
+  }
+
+  double fallback = 0;
+  int written = 0;
+  for (int i = 0; i < n; i++) {
+    if (s->msgs[i].msg_len < sizeof(struct can_frame)) continue;  // Not a classic CAN frame
+    const struct can_frame *f = &s->frames[i];
+    uint32_t slot = offset + (uint32_t)written++;
+    int eff = (f->can_id & CAN_EFF_FLAG) != 0;
+
+    s->ids[slot] = f->can_id & (eff ? CAN_EFF_MASK : CAN_SFF_MASK);
+    s->ext[slot] = (uint8_t)eff;
+    s->dlcs[slot] = f->can_dlc > 8 ? 8 : f->can_dlc;
+    memcpy(s->data + (size_t)slot * 8, f->data, 8);
+
+    double ts = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&s->msgs[i].msg_hdr); c; c = CMSG_NXTHDR(&s->msgs[i].msg_hdr, c)) {
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMP) {
+        struct timeval tv;
+        memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+        ts = (double)tv.tv_sec * 1e6 + (double)tv.tv_usec;
+      }
+    }
+    if (ts == 0) ts = fallback ? fallback : (fallback = now_us());
+    s->timestamps[slot] = ts;
+  }
+
+  napi_value result;
+  CALL(env, napi_create_uint32(env, (uint32_t)written, &result));
+  return result;
+}
+
+// send(handle, ids, ext, dlcs, data, count) -> frames queued to the kernel.
+// Throws (with .code) only if nothing could be sent.
+static napi_value js_send(napi_env env, napi_callback_info info) {
+  size_t argc = 6;
+  napi_value argv[6];
+  uint32_t count;
+  CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+  can_socket *s = get_socket(env, argv[0]);
+  if (!s) return NULL;
+
+  size_t n_ids, n_ext, n_dlcs, n_data;
+  const uint32_t *ids = typed_array(env, argv[1], napi_uint32_array, &n_ids);
+  const uint8_t *ext = typed_array(env, argv[2], napi_uint8_array, &n_ext);
+  const uint8_t *dlcs = typed_array(env, argv[3], napi_uint8_array, &n_dlcs);
+  const uint8_t *data = typed_array(env, argv[4], napi_uint8_array, &n_data);
+  if (!ids || !ext || !dlcs || !data) {
+    napi_throw_type_error(env, NULL, "Frame arrays must be Uint32Array and Uint8Array x3");
+    return NULL;
+  }
+  CALL(env, napi_get_value_uint32(env, argv[5], &count));
+  if (count > n_ids || count > n_ext || count > n_dlcs || count > n_data / 8) {
+    napi_throw_range_error(env, NULL, "Frame count exceeds array length");
+    return NULL;
+  }
+  if (count > MAX_BATCH) count = MAX_BATCH;
+
+  struct can_frame *frames = s->tx_frames;
+  struct iovec *iov = s->tx_iov;
+  struct mmsghdr *msgs = s->tx_msgs;
+  for (uint32_t i = 0; i < count; i++) {
+    memset(&frames[i], 0, sizeof(frames[i]));
+    frames[i].can_id = ext[i] ? ((ids[i] & CAN_EFF_MASK) | CAN_EFF_FLAG) : (ids[i] & CAN_SFF_MASK);
+    frames[i].can_dlc = dlcs[i] > 8 ? 8 : dlcs[i];
+    memcpy(frames[i].data, data + (size_t)i * 8, frames[i].can_dlc);
+    iov[i].iov_base = &frames[i];
+    iov[i].iov_len = sizeof(struct can_frame);
+    memset(&msgs[i], 0, sizeof(msgs[i]));
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int n = count > 0 ? sendmmsg(s->fd, msgs, count, MSG_DONTWAIT) : 0;
+  if (n < 0) return throw_errno(env, "sendmmsg", errno);
+
+  napi_value result;
+  CALL(env, napi_create_uint32(env, (uint32_t)n, &result));
+  return result;
+}
+
+// setFilters(handle, Uint32Array [id0, mask0, id1, mask1, ...]); empty = receive nothing
+static napi_value js_set_filters(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+  can_socket *s = get_socket(env, argv[0]);
+  if (!s) return NULL;
+
+  size_t length;
+  const uint32_t *pairs = typed_array(env, argv[1], napi_uint32_array, &length);
+  if (!pairs) {
+    napi_throw_type_error(env, NULL, "Filters must be a Uint32Array of id/mask pairs");
+    return NULL;
+  }
+  size_t count = length / 2;
+  if (count > MAX_FILTERS) {
+    napi_throw_range_error(env, NULL, "Too many CAN filters");
+    return NULL;
+  }
+
+  struct can_filter filters[MAX_FILTERS];
+  for (size_t i = 0; i < count; i++) {
+    filters[i].can_id = pairs[i * 2];
+    filters[i].can_mask = pairs[i * 2 + 1];
+  }
+  if (setsockopt(s->fd, SOL_CAN_RAW, CAN_RAW_FILTER, count ? filters : NULL,
+                 (socklen_t)(count * sizeof(struct can_filter))) < 0) {
+    return throw_errno(env, "CAN_RAW_FILTER", errno);
+  }
+  return NULL;
+}
+
+// close(handle); safe to call more than once
+static napi_value js_close(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  can_socket *s = NULL;
+  CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+  if (argc < 1 || napi_get_value_external(env, argv[0], (void **)&s) != napi_ok || s == NULL) {
+    napi_throw_type_error(env, NULL, "Expected a CAN socket handle");
+    return NULL;
+  }
+  release(s);
+  return NULL;
+}
+
+static napi_value init(napi_env env, napi_value exports) {
+  napi_property_descriptor props[] = {
+    { "open", NULL, js_open, NULL, NULL, NULL, napi_default, NULL },
+    { "recv", NULL, js_recv, NULL, NULL, NULL, napi_default, NULL },
+    { "send", NULL, js_send, NULL, NULL, NULL, napi_default, NULL },
+    { "setFilters", NULL, js_set_filters, NULL, NULL, NULL, napi_default, NULL },
+    { "close", NULL, js_close, NULL, NULL, NULL, napi_default, NULL },
+    { "maxBatch", NULL, NULL, NULL, NULL, NULL, napi_default, NULL },
+  };
+  napi_value max_batch;
+  napi_create_uint32(env, MAX_BATCH, &max_batch);
+  props[5].value = max_batch;
+  napi_define_properties(env, exports, sizeof(props) / sizeof(props[0]), props);
+  return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
@@ -0,0 +1,27 @@
+#!/usr/bin/env node
+// Build dist/bundle: the CLI and its ingest worker as two self-contained
+// files, so startup loads one script instead of resolving dozens of
+// modules. The socketcan package and the optional native addon stay
+// external - they are compiled binaries loaded from disk at runtime.
+//
+// dist/bundle sits at the same depth as dist/can, so the addon's relative
+// path (../../native/build/...) resolves the same from either build.
+const esbuild = require('esbuild');
+const path = require('path');
+
+const root = path.join(__dirname, '..');
+
+esbuild.build({
+  absWorkingDir: root,
+  // The worker must be named worker.js next to index.js (see ingest/client.ts)
+  entryPoints: { index: 'src/index.ts', worker: 'src/ingest/worker.ts' },
+  outdir: 'dist/bundle',
+  bundle: true,
+  platform: 'node',
+  format: 'cjs',
+  target: 'node18',
+  external: ['socketcan', '*.node'],
+  minifySyntax: true,
+  legalComments: 'none',
+  logLevel: 'info',
+}).catch(() => process.exit(1));
@@ -0,0 +1,195 @@
+#!/usr/bin/env node
+// Generate src/protocol/signals.generated.ts from definitions/ossm.json:
+// PGN and SIGNAL constants, the SensorData interface, the descriptor table
+// and one straight-line decoder function per PGN. Scaling constants are
+// inlined as literals, so each decoder is a fixed sequence of loads,
+// compares and stores that V8 compiles like hand-written code.
+//
+//   node scripts/gen-signals.js           Write the generated file
+//   node scripts/gen-signals.js --check   Exit 1 if it is out of date
+//
+// Signal slots follow the order of "signals" in the definition file. They
+// index shared memory and recordings, so append new signals at the end.
+const fs = require('fs');
+const path = require('path');
+
+const root = path.join(__dirname, '..');
+const SOURCE = 'definitions/ossm.json';
+const OUTPUT = 'src/protocol/signals.generated.ts';
+
+const PDU2_BASE = 0xF000;
+const MAX_SIGNALS = 31;  // Changed masks are 32-bit integers
+const NA = { 1: 0xFF, 2: 0xFFFF };
+
+function fail(message) {
+  console.error(`${SOURCE}: ${message}`);
+  process.exit(1);
+}
+
+function validate(def) {
+  if (!Array.isArray(def.signals) || !Array.isArray(def.pgns)) fail('expected "signals" and "pgns" arrays');
+  if (def.signals.length > MAX_SIGNALS) fail(`at most ${MAX_SIGNALS} signals are supported`);
+
+  const slots = new Map();
+  def.signals.forEach((s, slot) => {
+    if (!/^[a-z][A-Za-z0-9]*$/.test(s.name)) fail(`signal name '${s.name}' must be camelCase`);
+    if (slots.has(s.name)) fail(`duplicate signal '${s.name}'`);
+    slots.set(s.name, slot);
+  });
+
+  const pgns = new Set();
+  for (const p of def.pgns) {
+    if (!/^[A-Z][A-Z0-9_]*$/.test(p.name)) fail(`PGN name '${p.name}' must be UPPER_CASE`);
+    if (!Number.isInteger(p.pgn) || p.pgn < PDU2_BASE || p.pgn > 0xFFFF) fail(`${p.name}: ${p.pgn} is not a PDU2 PGN`);
+    if (pgns.has(p.pgn)) fail(`${p.name}: PGN ${p.pgn} defined twice`);
+    if (p.intervalMs !== undefined && !(p.intervalMs > 0)) fail(`${p.name}: intervalMs must be positive`);
+    pgns.add(p.pgn);
+
+    const used = new Array(8).fill(null);
+    for (const f of p.fields) {
+      if (!slots.has(f.signal)) fail(`${p.name}: unknown signal '${f.signal}'`);
+      if (f.width !== 1 && f.width !== 2) fail(`${p.name}.${f.signal}: width must be 1 or 2`);
+      if (!Number.isInteger(f.byte) || f.byte < 0 || f.byte + f.width > 8) fail(`${p.name}.${f.signal}: byte out of range`);
+      if (typeof f.scale !== 'number' || !(f.scale > 0)) fail(`${p.name}.${f.signal}: scale must be positive`);
+      for (let b = f.byte; b < f.byte + f.width; b++) {
+        if (used[b]) fail(`${p.name}: ${f.signal} overlaps ${used[b]} at byte ${b}`);
+        used[b] = f.signal;
+      }
+    }
+  }
+  return slots;
+}
+
+const hex = (n, digits) => `0x${n.toString(16).toUpperCase().padStart(digits, '0')}`;
+
+function pascal(name) {
+  return name.toLowerCase().replace(/(^|_)([a-z0-9])/g, (_, __, c) => c.toUpperCase());
+}
+
+// raw * scale + offset, with the identity parts left out
+function scaled(f) {
+  let expr = f.scale === 1 ? 'raw' : `raw * ${f.scale}`;
+  const offset = f.offset ?? 0;
+  if (offset > 0) expr += ` + ${offset}`;
+  if (offset < 0) expr += ` - ${-offset}`;
+  return expr;
+}
+
+function generate(def) {
+  const slots = validate(def);
+  const out = [];
+  const line = (s = '') => out.push(s);
+
+  line(`// Generated by scripts/gen-signals.js from ${SOURCE} - do not edit`);
+  line('//');
+  line('// Edit the definition file and run `npm run generate` (also run by');
+  line('// `npm run build`).');
+  line("import type { FrameDecoder, PgnDescriptor } from './decoder';");
+  line();
+
+  line('// Standard J1939 PGNs for sensor data');
+  line('export const PGN = {');
+  const width = Math.max(...def.pgns.map(p => `${p.name}: ${p.pgn},`.length));
+  for (const p of def.pgns) {
+    line(`  ${`${p.name}: ${p.pgn},`.padEnd(width)} // ${hex(p.pgn, 4)}${p.description ? ` - ${p.description}` : ''}`);
+  }
+  line('} as const;');
+  line();
+
+  // Where each signal comes from, for the interface comments
+  const sources = new Map(def.signals.map(s => [s.name, []]));
+  for (const p of def.pgns) {
+    for (const f of p.fields) sources.get(f.signal).push(f.spn ? `SPN ${f.spn}` : p.name);
+  }
+
+  line('export interface SensorData {');
+  const nameWidth = Math.max(...def.signals.map(s => s.name.length)) + 9;
+  def.signals.forEach((s, slot) => {
+    if (s.group) {
+      if (slot > 0) line();
+      line(`  // ${s.group}`);
+    }
+    const notes = [s.unit, ...new Set(sources.get(s.name))].filter(Boolean).join(', ');
+    line(`  ${`${s.name}?: number;`.padEnd(nameWidth)}${notes ? `  // ${notes}` : ''}`.trimEnd());
+  });
+  line('}');
+  line();
+
+  line('// Signal IDs - fixed slot index into the sensor store');
+  line('export const SIGNAL = {');
+  def.signals.forEach((s, slot) => line(`  ${s.name}: ${slot},`));
+  line('} as const satisfies Record<keyof SensorData, number>;');
+  line();
+  line(`export const SIGNAL_COUNT = ${def.signals.length};`);
+  line();
+
+  line('// One descriptor per PGN broadcast by OSSM');
+  line('export const PGN_DESCRIPTORS: PgnDescriptor[] = [');
+  for (const p of def.pgns) {
+    line('  {');
+    line(`    pgn: PGN.${p.name},`);
+    line(`    intervalMs: ${p.intervalMs ?? 0},`);
+    line('    fields: [');
+    for (const f of p.fields) {
+      line(
+        `      { signal: SIGNAL.${f.signal}, byte: ${f.byte}, width: ${f.width}, ` +
+        `scale: ${f.scale}, offset: ${f.offset ?? 0}, na: ${hex(f.na ?? NA[f.width], 2 * f.width)} },`
+      );
+    }
+    line('    ],');
+    line('  },');
+  }
+  line('];');
+
+  for (const p of def.pgns) {
+    line();
+    line(`// ${hex(p.pgn, 4)} ${p.name}`);
+    line(`const decode${pascal(p.name)}: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {`);
+    line('  let changed = 0;');
+    line('  let carried = 0;');
+    line('  let raw: number;');
+    line('  let value: number;');
+    for (const f of p.fields) {
+      const slot = slots.get(f.signal);
+      const at = f.byte === 0 ? 'base' : `base + ${f.byte}`;
+      const read = f.width === 1 ? `data[${at}]` : `data[${at}] | (data[base + ${f.byte + 1}] << 8)`;
+      line(`  if (len >= ${f.byte + f.width}) {  // ${f.signal}`);
+      line(`    raw = ${read};`);
+      line(`    if (raw !== ${hex(f.na ?? NA[f.width], 2 * f.width)}) {`);
+      line(`      value = ${scaled(f)};`);
+      line(`      updated[${slot}] = timestamp;`);
+      line(`      carried |= ${hex(2 ** slot, 1)};`);
+      line(`      if (values[${slot}] !== value) {`);
+      line(`        values[${slot}] = value;`);
+      line(`        changed |= ${hex(2 ** slot, 1)};`);
+      line('      }');
+      line('    }');
+      line('  }');
+    }
+    line('  sampled[0] = carried;');
+    line('  return changed;');
+    line('};');
+  }
+  line();
+
+  line('// Direct-indexed by PGN - 0xF000');
+  line('export const PDU2_DECODERS: (FrameDecoder | null)[] = new Array(0x1000).fill(null);');
+  for (const p of def.pgns) line(`PDU2_DECODERS[${hex(p.pgn - PDU2_BASE, 3)}] = decode${pascal(p.name)};`);
+
+  return out.join('\n') + '\n';
+}
+
+const def = JSON.parse(fs.readFileSync(path.join(root, SOURCE), 'utf8'));
+const code = generate(def);
+const target = path.join(root, OUTPUT);
+
+if (process.argv.includes('--check')) {
+  const current = fs.existsSync(target) ? fs.readFileSync(target, 'utf8') : '';
+  if (current !== code) {
+    console.error(`${OUTPUT} is out of date - run npm run generate`);
+    process.exit(1);
+  }
+} else {
+  fs.writeFileSync(target, code);
+  console.log(`Wrote ${OUTPUT} (${def.signals.length} signals, ${def.pgns.length} PGNs)`);
+}
@@ -0,0 +1,155 @@
+// Decoder benchmark: replays frames through J1939Protocol and reports
+// throughput, batch processing latency and heap growth.
+//
+// Latency percentiles are over whole batches: a frame waits for its batch,
+// so that is what a frame sees. Single frames are too short to time on
+// their own; the unbatched run (one frame per batch) gives their spread.
+//
+//   npm run bench                                   # 1M synthetic frames
+//   npm run bench -- --frames 200000 --batch 16
+//   npm run bench -- --file drive.bin --loops 10    # A capture from --log
+import { readCapture } from '../capture/reader';
+import { ReplayBus, syntheticOssmStream } from '../can/replay';
+import { FrameBatch } from '../can/socketcan';
+import { J1939Protocol } from '../protocol/j1939';
+
+interface BenchOptions {
+  frames: number;
+  batchSize: number;
+  loops: number;
+  file?: string;
+  json: boolean;
+}
+
+interface RunResult {
+  frames: number;
+  seconds: number;
+  framesPerSec: number;    // End to end, including replay overhead
+  decodePerSec: number;    // Time spent inside the protocol's batch handler only
+  meanFrameUs: number;     // Decode time per frame, averaged
+  batchP50Us: number;      // Time to process one batch
+  batchP99Us: number;
+  batchMaxUs: number;
+  heapGrowthBytes: number;
+}
+
+function parseArgs(): BenchOptions {
+  const args = process.argv.slice(2);
+  const options: BenchOptions = { frames: 1_000_000, batchSize: 64, loops: 1, json: false };
+  for (let i = 0; i < args.length; i++) {
+    const next = () => {
+      const value = Number(args[++i]);
+      if (!Number.isFinite(value) || value < 1) throw new Error(`${args[i - 1]} needs a positive number`);
+      return Math.floor(value);
+    };
+    if (args[i] === '--frames') options.frames = next();
+    else if (args[i] === '--batch') options.batchSize = next();
+    else if (args[i] === '--loops') options.loops = next();
+    else if (args[i] === '--file' && args[i + 1]) options.file = args[++i];
+    else if (args[i] === '--json') options.json = true;
+    else throw new Error(`Unknown option '${args[i]}'`);
+  }
+  return options;
+}
+
+// One setImmediate per frame is slow; the unbatched run uses a sample
+const SINGLE_FRAME_RUN = 100_000;
+
+const gc = (globalThis as { gc?: () => void }).gc;
+
+function heapUsed(): number {
+  gc?.();
+  return process.memoryUsage().heapUsed;
+}
+
+function percentile(sorted: Float64Array, p: number): number {
+  if (sorted.length === 0) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+function head(log: FrameBatch, count: number): FrameBatch {
+  if (log.count <= count) return log;
+  const sample = new FrameBatch(count);
+  sample.append(log, 0, count);
+  return sample;
+}
+
+async function run(log: FrameBatch, batchSize: number, loops: number): Promise<RunResult> {
+  const bus = new ReplayBus(log, { batchSize, loops });
+
+  // Handlers run in registration order, so these two bracket the protocol's own
+  const maxBatches = Math.ceil((log.count * loops) / batchSize) + loops;
+  const batchUs = new Float64Array(maxBatches);
+  let batches = 0;
+  let batchStart = 0;
+  let decodeMs = 0;
+  bus.onBatch(() => {
+    batchStart = performance.now();
+  });
+  const protocol = new J1939Protocol(bus);
+  bus.onBatch(batch => {
+    const ms = performance.now() - batchStart;
+    decodeMs += ms;
+    if (batches < maxBatches && batch.count > 0) batchUs[batches++] = ms * 1000;
+  });
+
+  const heapBefore = heapUsed();
+  const started = performance.now();
+  bus.connect();
+  await bus.done;
+  const seconds = (performance.now() - started) / 1000;
+  const heapAfter = heapUsed();
+  protocol.close();
+
+  const frames = bus.getStats().delivered;
+  const latencies = batchUs.subarray(0, batches).sort();
+  return {
+    frames,
+    seconds,
+    framesPerSec: frames / seconds,
+    decodePerSec: decodeMs > 0 ? frames / (decodeMs / 1000) : 0,
+    meanFrameUs: frames > 0 ? (decodeMs * 1000) / frames : 0,
+    batchP50Us: percentile(latencies, 0.5),
+    batchP99Us: percentile(latencies, 0.99),
+    batchMaxUs: batches > 0 ? latencies[batches - 1] : 0,
+    heapGrowthBytes: heapAfter - heapBefore,
+  };
+}
+
+function report(label: string, r: RunResult): void {
+  console.log(`${label}`);
+  console.log(`  frames          ${r.frames} in ${r.seconds.toFixed(2)} s`);
+  console.log(`  end to end      ${Math.round(r.framesPerSec).toLocaleString()} frames/s`);
+  console.log(`  decode only     ${Math.round(r.decodePerSec).toLocaleString()} frames/s`);
+  console.log(`  per frame       ${r.meanFrameUs.toFixed(3)} us mean`);
+  console.log(
+    `  per batch       p50 ${r.batchP50Us.toFixed(1)} us, p99 ${r.batchP99Us.toFixed(1)} us, ` +
+    `max ${r.batchMaxUs.toFixed(1)} us`
+  );
+  console.log(`  heap growth     ${(r.heapGrowthBytes / 1024).toFixed(1)} KiB`);
+}
+
+async function main(): Promise<void> {
+  const options = parseArgs();
+  const log = options.file ? readCapture(options.file) : syntheticOssmStream(options.frames);
+  const source = options.file ? options.file : 'synthetic OSSM stream';
+
+  // Warm up so the JIT has settled before measuring
+  await run(head(log, 50_000), options.batchSize, 1);
+
+  const batched = await run(log, options.batchSize, options.loops);
+  const single = await run(head(log, SINGLE_FRAME_RUN), 1, 1);
+
+  if (options.json) {
+    console.log(JSON.stringify({ source, batchSize: options.batchSize, batched, single }, null, 2));
+    return;
+  }
+  if (!gc) console.log('(run node with --expose-gc for accurate heap figures)\n');
+  report(`Batched (${options.batchSize} frames/batch), ${source}`, batched);
+  report('Unbatched (1 frame/batch)', single);
+}
+
+main().catch(err => {
+  console.error((err as Error).message);
+  process.exit(1);
+});
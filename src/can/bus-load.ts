@@ -0,0 +1,70 @@
+// Bus load from the interface's kernel counters
+//
+// The kernel counts every frame the controller receives or sends before
+// any socket filter applies, so /sys/class/net/<if>/statistics sees the
+// whole bus even when this process only receives OSSM frames. Sampled once
+// a second; each frame is costed as an extended (29-bit) data frame of its
+// length without stuff bits, so the figure is a slight underestimate.
+import * as fs from 'fs';
+
+export const DEFAULT_BITRATE = 250000;  // J1939-11/-15
+
+// SOF, 29-bit ID, SRR, IDE, RTR, r1, r0, DLC, CRC, delimiters, ACK, EOF and intermission
+const FRAME_OVERHEAD_BITS = 67;
+const SAMPLE_MS = 1000;
+const COUNTERS = ['rx_packets', 'rx_bytes', 'tx_packets', 'tx_bytes'];
+
+export class BusLoadMeter {
+  private readonly paths: string[];
+  private readonly bitrate: number;
+  private last: number[] | null = null;
+  private lastAt = 0;
+  private timer: NodeJS.Timeout | null = null;
+  load = 0;  // % of the bitrate over the last sample (0 until the second sample)
+
+  constructor(interfaceName: string, bitrate: number = DEFAULT_BITRATE) {
+    this.paths = COUNTERS.map(name => `/sys/class/net/${interfaceName}/statistics/${name}`);
+    this.bitrate = bitrate;
+  }
+
+  // False if the interface has no counters to read (not Linux, or gone)
+  start(): boolean {
+    if (this.timer) return true;
+    this.last = this.read();
+    if (!this.last) return false;
+    this.lastAt = performance.now();
+    this.timer = setInterval(() => this.sample(), SAMPLE_MS);
+    this.timer.unref();
+    return true;
+  }
+
+  stop(): void {
+    if (this.timer) clearInterval(this.timer);
+    this.timer = null;
+    this.last = null;
+    this.load = 0;
+  }
+
+  private sample(): void {
+    const now = performance.now();
+    const counts = this.read();
+    if (!counts || !this.last) return;
+    const frames = counts[0] - this.last[0] + counts[2] - this.last[2];
+    const bytes = counts[1] - this.last[1] + counts[3] - this.last[3];
+    const seconds = (now - this.lastAt) / 1000;
+    // Counters reset when the interface is brought down and up again
+    if (frames >= 0 && bytes >= 0 && seconds > 0) {
+      this.load = (frames * FRAME_OVERHEAD_BITS + bytes * 8) / (this.bitrate * seconds) * 100;
+    }
+    this.last = counts;
+    this.lastAt = now;
+  }
+
+  private read(): number[] | null {
+    try {
+      return this.paths.map(path => Number(fs.readFileSync(path, 'ascii')));
+    } catch {
+      return null;
+    }
+  }
+}
@@ -0,0 +1,42 @@
+// Optional native CAN_RAW backend (native/can_raw.c, built with `npm run build:native`)
+//
+// The addon reads with recvmmsg() straight into a FrameBatch's arrays and
+// writes with sendmmsg(). When it has not been built, CanBus falls back to
+// the socketcan package.
+
+// Opaque socket handle owned by the addon
+export type NativeSocket = { readonly __nativeCanSocket: unique symbol };
+
+export interface NativeCan {
+  readonly maxBatch: number;
+  open(
+    ifname: string,
+    ids: Uint32Array,
+    ext: Uint8Array,
+    dlcs: Uint8Array,
+    data: Uint8Array,
+    timestamps: Float64Array,
+    onReadable: () => void
+  ): NativeSocket;
+  // Receive up to `max` frames into batch slots starting at `offset`
+  recv(socket: NativeSocket, offset: number, max: number): number;
+  // Send `count` frames; returns how many the kernel accepted
+  send(socket: NativeSocket, ids: Uint32Array, ext: Uint8Array, dlcs: Uint8Array, data: Uint8Array, count: number): number;
+  // Flat [id, mask, id, mask, ...]; empty = receive nothing
+  setFilters(socket: NativeSocket, pairs: Uint32Array): void;
+  close(socket: NativeSocket): void;
+}
+
+let loaded: NativeCan | null | undefined;
+
+// The addon, or null if it is not built for this platform / Node version
+export function loadNativeCan(): NativeCan | null {
+  if (loaded === undefined) {
+    try {
+      loaded = require('../../native/build/Release/ossm_can.node') as NativeCan;
+    } catch {
+      loaded = null;
+    }
+  }
+  return loaded;
+}
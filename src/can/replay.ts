@@ -0,0 +1,280 @@
+// Replay bus: feeds recorded or synthetic frames through the CanTransport
+// interface, so the protocol stack can be exercised and benchmarked
+// without hardware.
+//
+// Frames come from a packed FrameBatch - see readCapture() in
+// ../capture/reader and syntheticOssmStream() below - and are delivered
+// in batches exactly as CanBus delivers them, after the same kernel-style
+// filtering.
+import { BusMetrics, emptyBusMetrics } from '../metrics/metrics';
+import { PGN_DESCRIPTORS } from '../protocol/decoder';
+import { CAN_EFF_FLAG, CanFilter, CanFrame, CanTransport, FrameBatch, TxLane, TxOptions } from './socketcan';
+
+export interface ReplayOptions {
+  batchSize?: number;  // Frames per delivered batch (default 64)
+  rate?: number;       // Frames per second (0 = as fast as possible, the default)
+  speed?: number;      // With rate 0: follow the recorded timestamps at this speed (0 = ignore them)
+  loops?: number;      // Times to play the log through (default 1)
+  onSend?: (frame: CanFrame) => void;  // Frames "transmitted" by the stack
+}
+
+export interface ReplayStats {
+  delivered: number;  // Frames handed to handlers
+  filtered: number;   // Frames rejected by the installed filters
+}
+
+const TICK_MS = 1;
+
+export class ReplayBus implements CanTransport {
+  private readonly log: FrameBatch;
+  private readonly batch: FrameBatch;
+  private readonly rate: number;
+  private readonly speed: number;
+  private readonly loops: number;
+  private readonly onSend: (frame: CanFrame) => void;
+  private readonly filterSets = new Map<unknown, CanFilter[] | null>();
+  private filters: CanFilter[] | null = null;  // Merged; null = accept all
+  private readonly batchHandlers: ((batch: FrameBatch) => void)[] = [];
+  private readonly messageHandlers: ((frame: CanFrame) => void)[] = [];
+  private running = false;
+  private position = 0;  // Next frame in the log
+  private loop = 0;
+  private readonly stats: ReplayStats = { delivered: 0, filtered: 0 };
+  private readonly metrics = emptyBusMetrics();
+  private startedAt = 0;
+  private consumed = 0;  // Frames taken from the log since start (rate mode)
+  private resolveDone: () => void = () => {};
+  readonly done: Promise<void>;
+
+  constructor(log: FrameBatch, options: ReplayOptions = {}) {
+    this.log = log;
+    this.batch = new FrameBatch(Math.max(1, options.batchSize ?? 64));
+    this.rate = Math.max(0, options.rate ?? 0);
+    this.speed = Math.max(0, options.speed ?? 0);
+    this.loops = Math.max(1, options.loops ?? 1);
+    this.onSend = options.onSend ?? (() => {});
+    this.done = new Promise(resolve => {
+      this.resolveDone = resolve;
+    });
+  }
+
+  // Start playback; `done` resolves when the log has been played `loops` times
+  connect(): void {
+    if (this.running) return;
+    this.running = true;
+    this.startedAt = performance.now();
+    this.schedule();
+  }
+
+  disconnect(): void {
+    if (!this.running) return;
+    this.running = false;
+    this.batch.count = 0;
+    this.resolveDone();
+  }
+
+  // Sent frames never wait, so onDone is called straight away
+  send(frame: CanFrame, lane?: TxLane, options: TxOptions = {}): void {
+    this.sendBatch([frame], lane, options);
+  }
+
+  sendBatch(frames: CanFrame[], lane?: TxLane, options: TxOptions = {}): void {
+    if (!this.running) throw new Error('CAN bus not connected');
+    for (const frame of frames) {
+      this.metrics.framesSent++;
+      this.metrics.bytesSent += frame.data.length;
+      this.onSend(frame);
+    }
+    options.onDone?.();
+  }
+
+  setFilters(filters: CanFilter[] | null, owner: unknown = this): void {
+    this.filterSets.set(owner, filters ? filters.map(f => ({ id: f.id >>> 0, mask: f.mask >>> 0 })) : null);
+    this.mergeFilters();
+  }
+
+  clearFilters(owner: unknown = this): void {
+    this.filterSets.delete(owner);
+    this.mergeFilters();
+  }
+
+  onBatch(handler: (batch: FrameBatch) => void): void {
+    this.batchHandlers.push(handler);
+  }
+
+  onMessage(handler: (frame: CanFrame) => void): void {
+    this.messageHandlers.push(handler);
+  }
+
+  removeHandler(handler: ((batch: FrameBatch) => void) | ((frame: CanFrame) => void)): void {
+    for (const list of [this.batchHandlers, this.messageHandlers] as unknown[][]) {
+      const i = list.indexOf(handler);
+      if (i >= 0) list.splice(i, 1);
+    }
+  }
+
+  get isConnected(): boolean {
+    return this.running;
+  }
+
+  getStats(): ReplayStats {
+    return { ...this.stats };
+  }
+
+  getMetrics(): BusMetrics {
+    return { ...this.metrics };
+  }
+
+  private mergeFilters(): void {
+    let acceptAll = this.filterSets.size === 0;
+    const merged: CanFilter[] = [];
+    for (const filters of this.filterSets.values()) {
+      if (filters === null) acceptAll = true;
+      else merged.push(...filters);
+    }
+    this.filters = acceptAll ? null : merged;
+  }
+
+  private schedule(): void {
+    if (!this.running) return;
+    if (this.rate === 0 && this.speed === 0) {
+      setImmediate(() => this.tick());  // Flat out, but let I/O and timers run between batches
+    } else {
+      setTimeout(() => this.tick(), TICK_MS);
+    }
+  }
+
+  private tick(): void {
+    if (!this.running) return;
+
+    let due: number;
+    if (this.rate > 0) {
+      const target = Math.floor((performance.now() - this.startedAt) / 1000 * this.rate);
+      due = target - this.consumed;
+    } else if (this.speed > 0) {
+      due = this.dueByTimestamp();
+    } else {
+      due = this.batch.capacity;
+    }
+
+    while (due > 0 && this.running) {
+      const taken = this.fill(due);
+      if (taken === 0) break;
+      due -= taken;
+      this.consumed += taken;
+      this.flush();
+    }
+    this.schedule();
+  }
+
+  // Frames whose recorded time (relative to the first frame, scaled) has passed
+  private dueByTimestamp(): number {
+    const log = this.log;
+    if (log.count === 0) return 0;
+    const elapsedUs = (performance.now() - this.startedAt) * 1000 * this.speed;
+    const span = log.timestamps[log.count - 1] - log.timestamps[0];
+    const loopOffset = this.loop * span;
+    let n = 0;
+    for (let i = this.position; i < log.count; i++) {
+      if (log.timestamps[i] - log.timestamps[0] + loopOffset > elapsedUs) break;
+      n++;
+    }
+    // At the end of a pass, report one more so fill() rolls over to the next loop
+    return n === 0 && this.position >= log.count ? 1 : n;
+  }
+
+  // Move up to `max` log frames into the delivery batch, applying filters.
+  // Returns the number of log frames consumed; stops playback at the end.
+  private fill(max: number): number {
+    const log = this.log;
+    const batch = this.batch;
+    let taken = 0;
+
+    while (taken < max && batch.count < batch.capacity) {
+      if (this.position >= log.count) {
+        if (++this.loop >= this.loops || log.count === 0) {
+          this.flush();
+          this.disconnect();
+          return taken;
+        }
+        this.position = 0;
+      }
+
+      const want = Math.min(max - taken, batch.capacity - batch.count, log.count - this.position);
+      if (this.filters === null) {
+        batch.append(log, this.position, want);
+      } else {
+        for (let i = this.position; i < this.position + want; i++) {
+          if (this.accepts(log.ids[i], log.ext[i])) batch.append(log, i, 1);
+          else this.stats.filtered++;
+        }
+      }
+      this.position += want;
+      taken += want;
+    }
+    return taken;
+  }
+
+  private accepts(id: number, ext: number): boolean {
+    const canId = (ext ? id | CAN_EFF_FLAG : id) >>> 0;
+    for (const f of this.filters!) {
+      if (((canId & f.mask) >>> 0) === ((f.id & f.mask) >>> 0)) return true;
+    }
+    return false;
+  }
+
+  private flush(): void {
+    const batch = this.batch;
+    if (batch.count === 0) return;
+    try {
+      this.stats.delivered += batch.count;
+      this.metrics.framesReceived += batch.count;
+      for (let i = 0; i < batch.count; i++) this.metrics.bytesReceived += batch.dlcs[i];
+      for (const handler of this.batchHandlers) handler(batch);
+      for (const handler of this.messageHandlers) {
+        for (let i = 0; i < batch.count; i++) handler(batch.frame(i));
+      }
+    } finally {
+      batch.count = 0;
+    }
+  }
+}
+
+export interface SyntheticOptions {
+  sourceAddress?: number;  // Default 0x95
+  intervalUs?: number;     // Timestamp spacing between frames (default 1000)
+  seed?: number;           // Random walk seed, for repeatable runs
+}
+
+// A repeatable OSSM broadcast: every sensor PGN in turn, with each signal
+// doing a small random walk so decoded values keep changing
+export function syntheticOssmStream(count: number, options: SyntheticOptions = {}): FrameBatch {
+  const sa = options.sourceAddress ?? 0x95;
+  const intervalUs = options.intervalUs ?? 1000;
+  let seed = (options.seed ?? 1) >>> 0;
+  const random = () => {
+    seed = (Math.imul(seed, 1664525) + 1013904223) >>> 0;
+    return seed / 0x100000000;
+  };
+
+  // Current raw value per descriptor field
+  const raw = PGN_DESCRIPTORS.map(d => d.fields.map(f => Math.floor(random() * (f.width === 1 ? 200 : 0xF000))));
+  const batch = new FrameBatch(Math.max(1, count));
+  const start = Date.now() * 1000;
+  const frame = new Uint8Array(8);
+
+  for (let i = 0; i < count; i++) {
+    const d = i % PGN_DESCRIPTORS.length;
+    const desc = PGN_DESCRIPTORS[d];
+    frame.fill(0xFF);
+    desc.fields.forEach((f, k) => {
+      const max = f.width === 1 ? 0xFA : 0xFAFF;
+      const step = Math.round((random() - 0.5) * (f.width === 1 ? 4 : 256));
+      const v = raw[d][k] = Math.min(max, Math.max(0, raw[d][k] + step));
+      frame[f.byte] = v & 0xFF;
+      if (f.width === 2) frame[f.byte + 1] = v >> 8;
+    });
+    batch.push(((6 << 26) | (desc.pgn << 8) | sa) >>> 0, true, frame, start + i * intervalUs);
+  }
+  return batch;
+}
@@ -1,36 +1,302 @@
 // SocketCAN wrapper for J1939 communication
-import { createRawChannel, RawChannel } from 'socketcan';
+import { createRawChannel, RawChannel, RawMessage } from 'socketcan';
+import { BusMetrics, emptyBusMetrics } from '../metrics/metrics';
+import { BusLoadMeter } from './bus-load';
+import { NativeCan, NativeSocket, loadNativeCan } from './native';
 
 export interface CanFrame {
   id: number;
   data: Buffer;
-  ext: boolean;  // Extended (29-bit) ID
+  ext: boolean;        // Extended (29-bit) ID
+  timestamp?: number;  // Kernel receive time, microseconds since the epoch
 }
 
-export class CanBus {
+// SocketCAN ID flags (linux/can.h)
+export const CAN_EFF_FLAG = 0x80000000;  // Extended frame format
+export const CAN_EFF_MASK = 0x1FFFFFFF;
+
+// Kernel receive filter: a frame passes when (can_id & mask) === (id & mask)
+export interface CanFilter {
+  id: number;
+  mask: number;
+}
+
+// 'native' uses the recvmmsg/sendmmsg addon, 'socketcan' the npm package,
+// 'auto' the addon when it is built
+export type CanBackend = 'auto' | 'native' | 'socketcan';
+
+// Transmit lanes: queued control frames (commands, TP connection
+// management, requests) always go out before queued bulk data
+export type TxLane = 'control' | 'bulk';
+
+// 'blocked' = the kernel queue is full; 'stalled' = nothing has gone out
+// for STALL_AFTER_MS, or the link is down. A stall is usually the
+// controller being bus-off, but error frames are not read to tell.
+export type TxState = 'active' | 'blocked' | 'stalled';
+
+export interface CanBusOptions {
+  batchSize?: number;     // Max frames delivered per batch (default 64)
+  maxLatencyMs?: number;  // Max time a frame waits in a partial batch (0 = flush next tick)
+  backend?: CanBackend;   // Default 'auto'
+  txQueueLimit?: number;  // Frames held while the kernel queue is full (default 1024)
+  txMaxAgeMs?: number;    // Queued control frames older than this are dropped (default 1250)
+  bitrate?: number;       // For the bus load figure (default 250000)
+}
+
+// Per-send options for frames that may have to wait in the transmit queue
+export interface TxOptions {
+  maxAgeMs?: number;               // Drop them if still queued this long (default: txMaxAgeMs, bulk never)
+  signal?: AbortSignal;            // Drop them if still queued when this aborts
+  onDone?: (err?: Error) => void;  // Every frame written, or why the rest were dropped
+}
+
+// Thrown by send() when the transmit queue is at its limit
+export class TxQueueFullError extends Error {
+  readonly code = 'ENOBUFS';
+
+  constructor(message: string) {
+    super(message);
+    this.name = 'TxQueueFullError';
+  }
+}
+
+// Passed to onDone when queued frames are dropped unsent
+export class TxDroppedError extends Error {
+  constructor(message: string) {
+    super(message);
+    this.name = 'TxDroppedError';
+  }
+}
+
+const DEFAULT_BATCH_SIZE = 64;
+const DEFAULT_TX_QUEUE_LIMIT = 1024;
+// A control frame with no age of its own (TP connection management, PGN
+// requests) is useless after this: J1939-21 T2/T3, the longest a TP peer
+// waits for it. Commands pass their own response timeout instead.
+const DEFAULT_TX_MAX_AGE_MS = 1250;
+const TX_RETRY_MIN_MS = 1;
+const TX_RETRY_MAX_MS = 100;
+const STALL_AFTER_MS = 500;  // Blocked this long = stalled
+const SOCKETCAN_TX_BATCH = 64;
+
+// Errors that mean "try again later" rather than "this frame is bad"
+const RETRYABLE = new Set(['ENOBUFS', 'EAGAIN', 'EWOULDBLOCK', 'ENETDOWN']);
+
+interface QueuedFrame {
+  frame: CanFrame;
+  queuedAt: number;   // ms
+  expiresAt: number;  // ms
+  request: TxRequest | null;
+}
+
+// One send's options, shared by its queued frames
+interface TxRequest {
+  pending: number;  // Frames not yet written
+  failed: boolean;
+  signal: AbortSignal | null;
+  onDone: ((err?: Error) => void) | null;
+}
+
+// FIFO with O(1) removal from the front
+class TxLaneQueue {
+  private items: QueuedFrame[] = [];
+  private head = 0;
+
+  get length(): number {
+    return this.items.length - this.head;
+  }
+
+  push(item: QueuedFrame): void {
+    this.items.push(item);
+  }
+
+  peek(i: number = 0): QueuedFrame {
+    return this.items[this.head + i];
+  }
+
+  drop(count: number): void {
+    this.head += count;
+    if (this.head === this.items.length) {
+      this.items = [];
+      this.head = 0;
+    } else if (this.head > 1024 && this.head * 2 > this.items.length) {
+      this.items = this.items.slice(this.head);
+      this.head = 0;
+    }
+  }
+
+  // Take out the frames `stale` picks, keeping the rest in order
+  remove(stale: (item: QueuedFrame) => boolean): QueuedFrame[] | null {
+    let removed: QueuedFrame[] | null = null;
+    let kept = this.head;
+    for (let i = this.head; i < this.items.length; i++) {
+      const item = this.items[i];
+      if (stale(item)) (removed ??= []).push(item);
+      else this.items[kept++] = item;
+    }
+    this.items.length = kept;
+    if (kept === this.head) this.clear();
+    return removed;
+  }
+
+  clear(): QueuedFrame[] {
+    const items = this.head === 0 ? this.items : this.items.slice(this.head);
+    this.items = [];
+    this.head = 0;
+    return items;
+  }
+}
+
+// Packed, reusable batch of received frames. Slots [0, count) are valid
+// only until the batch handler returns - the buffers are then refilled.
+export class FrameBatch {
+  count = 0;
+  readonly capacity: number;
+  readonly ids: Uint32Array;          // CAN ID
+  readonly ext: Uint8Array;           // 1 = extended (29-bit) ID
+  readonly dlcs: Uint8Array;          // Data length
+  readonly data: Uint8Array;          // 8 bytes per frame, frame i at i * 8
+  readonly timestamps: Float64Array;  // Kernel receive time, microseconds since the epoch
+  private missingTimestamps = false;
+
+  constructor(capacity: number) {
+    this.capacity = capacity;
+    this.ids = new Uint32Array(capacity);
+    this.ext = new Uint8Array(capacity);
+    this.dlcs = new Uint8Array(capacity);
+    this.data = new Uint8Array(capacity * 8);
+    this.timestamps = new Float64Array(capacity);
+  }
+
+  // Append a frame. Returns true when the batch is full.
+  push(id: number, ext: boolean, data: Uint8Array, timestamp: number): boolean {
+    const i = this.count++;
+    const dlc = data.length < 8 ? data.length : 8;
+    this.ids[i] = id;
+    this.ext[i] = ext ? 1 : 0;
+    this.dlcs[i] = dlc;
+    this.data.set(dlc === data.length ? data : data.subarray(0, dlc), i * 8);
+    this.timestamps[i] = timestamp;
+    if (timestamp === 0) this.missingTimestamps = true;
+    return this.count === this.capacity;
+  }
+
+  // Append frames [start, start + count) of another batch; returns how many fit
+  append(src: FrameBatch, start: number, count: number): number {
+    const n = Math.min(count, this.capacity - this.count);
+    const at = this.count;
+    const end = start + n;
+    this.ids.set(src.ids.subarray(start, end), at);
+    this.ext.set(src.ext.subarray(start, end), at);
+    this.dlcs.set(src.dlcs.subarray(start, end), at);
+    this.data.set(src.data.subarray(start * 8, end * 8), at * 8);
+    this.timestamps.set(src.timestamps.subarray(start, end), at);
+    this.count += n;
+    return n;
+  }
+
+  // Stamp frames that arrived without a kernel timestamp, using one clock
+  // read for the whole batch
+  fillMissingTimestamps(): void {
+    if (!this.missingTimestamps) return;
+    this.missingTimestamps = false;
+    const now = Date.now() * 1000;
+    for (let i = 0; i < this.count; i++) {
+      if (this.timestamps[i] === 0) this.timestamps[i] = now;
+    }
+  }
+
+  // Copy frame i out as a standalone CanFrame
+  frame(i: number): CanFrame {
+    const base = i * 8;
+    return {
+      id: this.ids[i],
+      data: Buffer.from(this.data.subarray(base, base + this.dlcs[i])),
+      ext: this.ext[i] === 1,
+      timestamp: this.timestamps[i]
+    };
+  }
+}
+
+// What the protocol layer needs from a bus. CanBus is the SocketCAN
+// implementation; ReplayBus (./replay) plays back captures and synthetic
+// streams for benchmarks.
+export interface CanTransport {
+  connect(): void;
+  disconnect(): void;
+  send(frame: CanFrame, lane?: TxLane, options?: TxOptions): void;
+  sendBatch(frames: CanFrame[], lane?: TxLane, options?: TxOptions): void;
+  setFilters(filters: CanFilter[] | null, owner?: unknown): void;
+  clearFilters(owner?: unknown): void;
+  onBatch(handler: (batch: FrameBatch) => void): void;
+  onMessage(handler: (frame: CanFrame) => void): void;
+  removeHandler(handler: ((batch: FrameBatch) => void) | ((frame: CanFrame) => void)): void;
+  getMetrics(): BusMetrics;
+  readonly isConnected: boolean;
+}
+
+export class CanBus implements CanTransport {
   private channel: RawChannel | null = null;
+  private native: NativeSocket | null = null;
+  private addon: NativeCan | null = null;
   private readonly interfaceName: string;
-  private messageHandler: ((frame: CanFrame) => void) | null = null;
+  private readonly batch: FrameBatch;
+  private tx = new FrameBatch(16);  // Native send staging, grown by sendBatch
+  private readonly maxLatencyMs: number;
+  private readonly backend: CanBackend;
+  private flushScheduled = false;
+  private readonly filterSets = new Map<unknown, CanFilter[] | null>();
+  private readonly batchHandlers: ((batch: FrameBatch) => void)[] = [];
+  private readonly messageHandlers: ((frame: CanFrame) => void)[] = [];
+  private readonly metrics = emptyBusMetrics();
+  private readonly loadMeter: BusLoadMeter;
+  private readonly lanes = { control: new TxLaneQueue(), bulk: new TxLaneQueue() };
+  private readonly txQueueLimit: number;
+  private readonly txMaxAgeMs: number;
+  private readonly txStateHandlers: ((state: TxState) => void)[] = [];
+  private state: TxState = 'active';
+  private blockedSince = 0;
+  private retryMs = TX_RETRY_MIN_MS;
+  private retryTimer: NodeJS.Timeout | null = null;
+  private written = 0;  // Frames write() sent before it threw
 
-  constructor(interfaceName: string = 'can0') {
+  constructor(interfaceName: string = 'can0', options: CanBusOptions = {}) {
     this.interfaceName = interfaceName;
+    this.batch = new FrameBatch(Math.max(1, options.batchSize ?? DEFAULT_BATCH_SIZE));
+    this.maxLatencyMs = Math.max(0, options.maxLatencyMs ?? 0);
+    this.backend = options.backend ?? 'auto';
+    this.txQueueLimit = Math.max(1, options.txQueueLimit ?? DEFAULT_TX_QUEUE_LIMIT);
+    this.txMaxAgeMs = options.txMaxAgeMs ?? DEFAULT_TX_MAX_AGE_MS;
+    this.loadMeter = new BusLoadMeter(interfaceName, options.bitrate);
   }
 
   connect(): void {
+    const addon = this.backend === 'socketcan' ? null : loadNativeCan();
+    if (!addon && this.backend === 'native') {
+      throw new Error('Native CAN backend is not built (run `npm run build:native`)');
+    }
+
     try {
+      if (addon) {
+        this.connectNative(addon);
+        this.loadMeter.start();
+        return;
+      }
+
       this.channel = createRawChannel(this.interfaceName, true);  // true = timestamps
 
-      this.channel.addListener('onMessage', (msg: { id: number; data: Buffer; ext: boolean }) => {
-        if (this.messageHandler) {
-          this.messageHandler({
-            id: msg.id,
-            data: msg.data,
-            ext: msg.ext
-          });
+      this.channel.addListener('onMessage', (msg: RawMessage) => {
+        const ts = msg.ts_sec !== undefined ? msg.ts_sec * 1e6 + (msg.ts_usec ?? 0) : 0;
+        if (this.batch.push(msg.id, msg.ext, msg.data, ts)) {
+          this.flush();
+        } else if (!this.flushScheduled) {
+          this.scheduleFlush();
         }
       });
 
+      if (this.filterSets.size > 0) this.applyFilters();
       this.channel.start();
+      this.loadMeter.start();
     } catch (err) {
       throw new Error(
         `Failed to open CAN interface '${this.interfaceName}'. ` +
@@ -46,24 +312,349 @@ export class CanBus {
       this.channel.stop();
       this.channel = null;
     }
+    if (this.native) {
+      this.addon!.close(this.native);
+      this.native = null;
+    }
+    this.batch.count = 0;
+    this.loadMeter.stop();
+    if (this.retryTimer) clearTimeout(this.retryTimer);
+    this.retryTimer = null;
+    const dropped = new TxDroppedError('CAN bus disconnected before the frame was sent');
+    for (const queue of [this.lanes.control, this.lanes.bulk]) {
+      const items = queue.clear();
+      this.metrics.txDropped += items.length;
+      for (const item of items) this.fail(item, dropped);
+    }
+    this.metrics.txQueued = 0;
+    this.setState('active');
+  }
+
+  send(frame: CanFrame, lane: TxLane = 'control', options: TxOptions = {}): void {
+    this.sendBatch([frame], lane, options);
   }
 
-  send(frame: CanFrame): void {
-    if (!this.channel) {
+  // Send frames in order: straight to the kernel while it has room
+  // (one sendmmsg() per batch on the native backend), otherwise queued in
+  // their lane and sent as room frees up. Throws TxQueueFullError when the
+  // queue is at its limit, and on errors retrying cannot fix; onDone is
+  // only called when sendBatch returns.
+  sendBatch(frames: CanFrame[], lane: TxLane = 'control', options: TxOptions = {}): void {
+    if (!this.isConnected) {
       throw new Error('CAN bus not connected');
     }
-    this.channel.send({
-      id: frame.id,
-      data: frame.data,
-      ext: frame.ext
-    });
+    let sent = 0;
+    const direct = this.queued === 0;  // Otherwise queue behind what is waiting
+    if (direct) {
+      sent = this.write(frames, 0, frames.length);
+      if (sent === frames.length) {
+        if (this.state !== 'active') this.setState('active');
+        options.onDone?.();
+        return;
+      }
+    }
+
+    const rest = frames.length - sent;
+    if (this.queued + rest > this.txQueueLimit) {
+      this.metrics.sendErrors += rest;
+      throw new TxQueueFullError(`CAN transmit queue full, ${rest} of ${frames.length} frames not sent`);
+    }
+    const queue = this.lanes[lane];
+    const now = Date.now();
+    const maxAgeMs = options.maxAgeMs ?? (lane === 'control' ? this.txMaxAgeMs : Infinity);
+    const request: TxRequest | null = options.onDone || options.signal
+      ? { pending: rest, failed: false, signal: options.signal ?? null, onDone: options.onDone ?? null }
+      : null;
+    for (let i = sent; i < frames.length; i++) {
+      queue.push({ frame: frames[i], queuedAt: now, expiresAt: now + maxAgeMs, request });
+    }
+    this.metrics.txQueued = this.queued;
+
+    if (!direct && this.retryTimer === null) this.drain();
+    else this.blocked();
   }
 
+  // Current transmit state; see TxState
+  get txState(): TxState {
+    return this.state;
+  }
+
+  // Called on every transmit state change. Returns an unsubscribe function.
+  onTxState(handler: (state: TxState) => void): () => void {
+    this.txStateHandlers.push(handler);
+    return () => {
+      const i = this.txStateHandlers.indexOf(handler);
+      if (i >= 0) this.txStateHandlers.splice(i, 1);
+    };
+  }
+
+  private get queued(): number {
+    return this.lanes.control.length + this.lanes.bulk.length;
+  }
+
+  // Write frames [start, start + count) to the kernel. Returns how many it
+  // took before its queue filled; throws on any other error.
+  private write(frames: CanFrame[], start: number, count: number): number {
+    let sent = 0;
+    try {
+      if (this.native) {
+        const addon = this.addon!;
+        while (sent < count) {
+          const n = Math.min(count - sent, addon.maxBatch);
+          if (this.tx.capacity < n) this.tx = new FrameBatch(n);
+          const tx = this.tx;
+          tx.count = 0;
+          for (let i = 0; i < n; i++) {
+            const frame = frames[start + sent + i];
+            tx.push(frame.id, frame.ext, frame.data, 0);
+          }
+          // The kernel may take only part of the batch when its queue is nearly full
+          const accepted = addon.send(this.native!, tx.ids, tx.ext, tx.dlcs, tx.data, n);
+          for (let i = 0; i < accepted; i++) this.metrics.bytesSent += tx.dlcs[i];
+          this.metrics.framesSent += accepted;
+          sent += accepted;
+          if (accepted < n) break;
+        }
+      } else {
+        const channel = this.channel!;
+        for (; sent < count; sent++) {
+          const frame = frames[start + sent];
+          channel.send({ id: frame.id, data: frame.data, ext: frame.ext });
+          this.metrics.framesSent++;
+          this.metrics.bytesSent += frame.data.length;
+        }
+      }
+    } catch (err) {
+      if (!isRetryable(err)) {
+        this.metrics.sendErrors++;
+        this.written = sent;
+        throw err;
+      }
+      if ((err as NodeJS.ErrnoException).code === 'ENETDOWN') this.setState('stalled');
+    }
+    return sent;
+  }
+
+  // Send what the kernel will take, control lane first
+  private drain(): void {
+    this.retryTimer = null;
+    if (!this.isConnected) return;
+    this.expire();
+
+    let progressed = false;
+    for (const queue of [this.lanes.control, this.lanes.bulk]) {
+      while (queue.length > 0) {
+        const count = Math.min(queue.length, this.native ? this.addon!.maxBatch : SOCKETCAN_TX_BATCH);
+        const frames: CanFrame[] = new Array(count);
+        for (let i = 0; i < count; i++) frames[i] = queue.peek(i).frame;
+        let sent: number;
+        let error: Error | null = null;
+        try {
+          sent = this.write(frames, 0, count);
+        } catch (err) {
+          sent = this.written;
+          error = err as Error;
+        }
+        for (let i = 0; i < sent; i++) this.delivered(queue.peek(i));
+        queue.drop(sent);
+        if (sent > 0) progressed = true;
+        if (error) {
+          // This frame can never go out (counted in write()); the rest may
+          this.fail(queue.peek(0), error);
+          queue.drop(1);
+          this.expire();  // With the rest of its send
+          continue;
+        }
+        if (sent < count) break;
+      }
+      if (queue.length > 0) break;
+    }
+    this.metrics.txQueued = this.queued;
+
+    if (this.queued === 0) {
+      this.retryMs = TX_RETRY_MIN_MS;
+      this.setState('active');
+      return;
+    }
+    if (progressed) {
+      this.retryMs = TX_RETRY_MIN_MS;
+      if (this.state === 'stalled') this.setState('blocked');
+      this.blockedSince = Date.now();
+    }
+    this.blocked();
+  }
+
+  // The kernel queue is full: note how long, and retry with backoff
+  private blocked(): void {
+    const now = Date.now();
+    if (this.state === 'active') {
+      this.blockedSince = now;
+      this.setState('blocked');
+    } else if (this.state === 'blocked' && now - this.blockedSince >= STALL_AFTER_MS) {
+      this.setState('stalled');
+    }
+    if (this.retryTimer !== null) return;
+    this.retryTimer = setTimeout(() => this.drain(), this.retryMs);
+    this.retryMs = Math.min(this.retryMs * 2, TX_RETRY_MAX_MS);
+  }
+
+  // Drop queued frames that outlived their age, were withdrawn, or belong
+  // to a send that already failed. Sending them late would only answer for
+  // something newer (a command's reply would go to the next command).
+  private expire(): void {
+    const now = Date.now();
+    const stale = (item: QueuedFrame) => item.expiresAt <= now ||
+      (item.request !== null && (item.request.failed || item.request.signal?.aborted === true));
+    for (const queue of [this.lanes.control, this.lanes.bulk]) {
+      const removed = queue.remove(stale);
+      if (!removed) continue;
+      this.metrics.txDropped += removed.length;
+      for (const item of removed) {
+        this.fail(item, new TxDroppedError(item.expiresAt <= now
+          ? `Frame not sent: waited ${now - item.queuedAt} ms in the CAN transmit queue`
+          : 'Frame withdrawn before it was sent'));
+      }
+    }
+  }
+
+  private delivered(item: QueuedFrame): void {
+    const request = item.request;
+    if (request && --request.pending === 0 && !request.failed) request.onDone?.();
+  }
+
+  // Report the first lost frame of a send; its other frames drop with it
+  private fail(item: QueuedFrame, err: Error): void {
+    const request = item.request;
+    if (!request || request.failed) return;
+    request.failed = true;
+    request.onDone?.(err);
+  }
+
+  private setState(state: TxState): void {
+    if (state === this.state) return;
+    this.state = state;
+    if (state === 'stalled') this.metrics.txStalls++;
+    for (const handler of this.txStateHandlers) handler(state);
+  }
+
+  // Install kernel-side CAN_RAW_FILTER masks (null = receive everything).
+  // Each owner (e.g. one protocol instance per target on a shared bus) has
+  // its own set; the kernel gets their union. Sets persist across reconnects
+  // and can be replaced at any time.
+  setFilters(filters: CanFilter[] | null, owner: unknown = this): void {
+    this.filterSets.set(owner, filters ? filters.map(f => ({ id: f.id >>> 0, mask: f.mask >>> 0 })) : null);
+    if (this.isConnected) this.applyFilters();
+  }
+
+  clearFilters(owner: unknown = this): void {
+    this.filterSets.delete(owner);
+    if (this.isConnected) this.applyFilters();
+  }
+
+  // Receive frames in packed batches
+  onBatch(handler: (batch: FrameBatch) => void): void {
+    this.batchHandlers.push(handler);
+  }
+
+  // Receive frames one at a time (adapter over the batch path)
   onMessage(handler: (frame: CanFrame) => void): void {
-    this.messageHandler = handler;
+    this.messageHandlers.push(handler);
+  }
+
+  removeHandler(handler: ((batch: FrameBatch) => void) | ((frame: CanFrame) => void)): void {
+    for (const list of [this.batchHandlers, this.messageHandlers] as unknown[][]) {
+      const i = list.indexOf(handler);
+      if (i >= 0) list.splice(i, 1);
+    }
   }
 
   get isConnected(): boolean {
-    return this.channel !== null;
+    return this.channel !== null || this.native !== null;
+  }
+
+  getMetrics(): BusMetrics {
+    return { ...this.metrics, busLoad: this.loadMeter.load };
+  }
+
+  private connectNative(addon: NativeCan): void {
+    const batch = this.batch;
+    this.addon = addon;
+    this.native = addon.open(this.interfaceName, batch.ids, batch.ext, batch.dlcs, batch.data,
+      batch.timestamps, () => this.drainNative());
+    if (this.filterSets.size > 0) this.applyFilters();
+  }
+
+  // Socket readable: pull frames straight into the batch until the kernel
+  // queue is empty, delivering each batch as it fills
+  private drainNative(): void {
+    const batch = this.batch;
+    while (this.native) {
+      const room = batch.capacity - batch.count;
+      const n = this.addon!.recv(this.native, batch.count, room);
+      batch.count += n;
+      if (batch.count === batch.capacity) this.flush();
+      if (n < room) break;
+    }
+    if (batch.count > 0 && !this.flushScheduled) this.scheduleFlush();
   }
+
+  private applyFilters(): void {
+    const merged: CanFilter[] = [];
+    let acceptAll = this.filterSets.size === 0;
+    for (const filters of this.filterSets.values()) {
+      if (filters === null) acceptAll = true;
+      else merged.push(...filters);
+    }
+    // An all-zero mask matches every frame, which restores the default
+    const filters = acceptAll ? [{ id: 0, mask: 0 }] : merged;
+    if (this.native) {
+      const pairs = new Uint32Array(filters.length * 2);
+      filters.forEach((f, i) => {
+        pairs[i * 2] = f.id;
+        pairs[i * 2 + 1] = f.mask;
+      });
+      this.addon!.setFilters(this.native, pairs);
+    } else {
+      this.channel!.setRxFilters(filters);
+    }
+  }
+
+  private scheduleFlush(): void {
+    this.flushScheduled = true;
+    const run = () => {
+      if (this.flushScheduled) this.flush();
+    };
+    if (this.maxLatencyMs > 0) {
+      setTimeout(run, this.maxLatencyMs);
+    } else {
+      setImmediate(run);
+    }
+  }
+
+  private flush(): void {
+    this.flushScheduled = false;
+    const batch = this.batch;
+    if (batch.count === 0) return;
+    batch.fillMissingTimestamps();
+
+    const metrics = this.metrics;
+    metrics.framesReceived += batch.count;
+    for (let i = 0; i < batch.count; i++) metrics.bytesReceived += batch.dlcs[i];
+
+    try {
+      for (const handler of this.batchHandlers) handler(batch);
+      for (const handler of this.messageHandlers) {
+        for (let i = 0; i < batch.count; i++) handler(batch.frame(i));
+      }
+    } finally {
+      batch.count = 0;
+    }
+  }
+}
+
+function isRetryable(err: unknown): boolean {
+  const code = (err as NodeJS.ErrnoException).code;
+  if (code !== undefined) return RETRYABLE.has(code);
+  // The socketcan package reports errno only in the message
+  return /no buffer space|temporarily unavailable|network is down/i.test((err as Error).message);
 }
@@ -0,0 +1,61 @@
+// Load capture files written by CaptureWriter (or candump -l) for replay
+import * as fs from 'fs';
+import { CAN_EFF_FLAG, CAN_EFF_MASK, FrameBatch } from '../can/socketcan';
+import { CAPTURE_HEADER_SIZE, CAPTURE_MAGIC, CAPTURE_RECORD_SIZE } from './writer';
+
+// Every frame of a capture file, packed in one batch. The format is taken
+// from the file: binary captures start with the OSSMCAP magic, anything
+// else is parsed as candump -l text.
+export function readCapture(filePath: string): FrameBatch {
+  const file = fs.readFileSync(filePath);
+  return file.toString('latin1', 0, CAPTURE_MAGIC.length) === CAPTURE_MAGIC
+    ? readBinary(file, filePath)
+    : readCandump(file.toString('latin1'), filePath);
+}
+
+function readBinary(file: Buffer, filePath: string): FrameBatch {
+  const recordSize = file.readUInt16LE(10);
+  if (recordSize < CAPTURE_RECORD_SIZE) {
+    throw new Error(`Invalid capture '${filePath}': record size ${recordSize}`);
+  }
+
+  const count = Math.floor((file.length - CAPTURE_HEADER_SIZE) / recordSize);
+  const batch = new FrameBatch(Math.max(1, count));
+  for (let i = 0; i < count; i++) {
+    const at = CAPTURE_HEADER_SIZE + i * recordSize;
+    const rawId = file.readUInt32LE(at + 8);
+    const dlc = Math.min(8, file[at + 12]);
+    batch.ids[i] = rawId & CAN_EFF_MASK;
+    batch.ext[i] = rawId & CAN_EFF_FLAG ? 1 : 0;
+    batch.dlcs[i] = dlc;
+    batch.data.set(file.subarray(at + 16, at + 16 + dlc), i * 8);
+    batch.timestamps[i] = file.readUInt32LE(at) * 1e6 + file.readUInt32LE(at + 4);
+  }
+  batch.count = count;
+  return batch;
+}
+
+// "(1436509052.249713) can0 18FEEE95#7800647E00000000"
+const CANDUMP_LINE = /^\((\d+)\.(\d+)\)\s+\S+\s+([0-9A-Fa-f]+)#([0-9A-Fa-f]*)/;
+
+function readCandump(text: string, filePath: string): FrameBatch {
+  const lines = text.split('\n');
+  const batch = new FrameBatch(Math.max(1, lines.length));
+
+  for (let n = 0; n < lines.length; n++) {
+    const line = lines[n].trim();
+    if (line === '') continue;
+    const match = CANDUMP_LINE.exec(line);
+    if (!match) throw new Error(`Invalid capture '${filePath}' line ${n + 1}: ${line}`);
+
+    const [, sec, usec, id, hex] = match;
+    const i = batch.count++;
+    const dlc = Math.min(8, hex.length >> 1);
+    batch.ids[i] = parseInt(id, 16) & CAN_EFF_MASK;
+    batch.ext[i] = id.length > 3 ? 1 : 0;
+    batch.dlcs[i] = dlc;
+    for (let b = 0; b < dlc; b++) batch.data[i * 8 + b] = parseInt(hex.substr(b * 2, 2), 16);
+    batch.timestamps[i] = Number(sec) * 1e6 + Number(usec.padEnd(6, '0').slice(0, 6));
+  }
+  return batch;
+}
@@ -0,0 +1,201 @@
+// Range queries over files written by SignalRecorder
+//
+// Only the trailer index is read up front. A query then reads, with
+// positioned reads, just the row groups overlapping the time range and
+// just the requested columns of each, so pulling one signal for one hour
+// out of a week-long file touches a few hundred KB.
+import * as fs from 'fs';
+import * as zlib from 'zlib';
+import {
+  GROUP_FIXED_SIZE, GROUP_MAGIC, INDEX_ENTRY_SIZE, SIGNAL_FILE_MAGIC, SIGNAL_HEADER_SIZE,
+  SIGNAL_INDEX_MAGIC, SignalMeta, TRAILER_SIZE, unzigzag
+} from './signal-recorder';
+
+export interface RowGroupInfo {
+  offset: number;
+  rows: number;
+  first: number;  // Timestamp range, us since the epoch
+  last: number;
+}
+
+export interface SignalQuery {
+  from?: number;       // Inclusive, us since the epoch
+  to?: number;         // Inclusive
+  signals?: string[];  // Default all
+}
+
+export interface SignalRows {
+  timestamps: Float64Array;
+  columns: Record<string, Float64Array>;  // NaN = not available
+}
+
+export class SignalFile {
+  readonly signals: SignalMeta[];
+  readonly startedAt: number;
+  readonly groups: RowGroupInfo[];
+  private readonly fd: number;
+
+  constructor(filePath: string) {
+    this.fd = fs.openSync(filePath, 'r');
+    try {
+      const header = this.read(0, SIGNAL_HEADER_SIZE);
+      if (header.toString('latin1', 0, 8) !== SIGNAL_FILE_MAGIC) {
+        throw new Error(`'${filePath}' is not a signal recording`);
+      }
+      const metaLength = header.readUInt32LE(12);
+      const meta = JSON.parse(this.read(SIGNAL_HEADER_SIZE, metaLength).toString());
+      this.signals = meta.signals;
+      this.startedAt = meta.startedAt;
+      this.groups = this.readIndex() ?? this.scanGroups(SIGNAL_HEADER_SIZE + metaLength);
+    } catch (err) {
+      fs.closeSync(this.fd);
+      throw err;
+    }
+  }
+
+  get rows(): number {
+    return this.groups.reduce((n, g) => n + g.rows, 0);
+  }
+
+  close(): void {
+    fs.closeSync(this.fd);
+  }
+
+  query(query: SignalQuery = {}): SignalRows {
+    const from = query.from ?? -Infinity;
+    const to = query.to ?? Infinity;
+    const wanted = (query.signals ?? this.signals.map(s => s.name)).map(name => {
+      const column = this.signals.findIndex(s => s.name === name);
+      if (column < 0) throw new Error(`Unknown signal '${name}'`);
+      return column;
+    });
+
+    const groups = this.groups.filter(g => g.last >= from && g.first <= to);
+    const capacity = groups.reduce((n, g) => n + g.rows, 0);
+    const timestamps = new Float64Array(capacity);
+    const columns = wanted.map(() => new Float64Array(capacity));
+    let count = 0;
+
+    for (const group of groups) {
+      const columnCount = this.signals.length + 1;
+      const lengths = this.read(group.offset + GROUP_FIXED_SIZE, columnCount * 4);
+      const offsets: number[] = [];
+      let at = group.offset + GROUP_FIXED_SIZE + columnCount * 4;
+      for (let c = 0; c < columnCount; c++) {
+        offsets.push(at);
+        at += lengths.readUInt32LE(c * 4);
+      }
+      const column = (c: number) => zlib.inflateRawSync(this.read(offsets[c], lengths.readUInt32LE(c * 4)));
+
+      // Rows of this group inside the range
+      const times = decodeTimes(column(0), group.rows, group.first);
+      let start = 0;
+      while (start < group.rows && times[start] < from) start++;
+      let end = group.rows;
+      while (end > start && times[end - 1] > to) end--;
+      if (end === start) continue;
+
+      timestamps.set(times.subarray(start, end), count);
+      wanted.forEach((signal, i) => {
+        const values = decodeSignal(column(signal + 1), group.rows, this.signals[signal].resolution);
+        columns[i].set(values.subarray(start, end), count);
+      });
+      count += end - start;
+    }
+
+    const result: SignalRows = { timestamps: timestamps.subarray(0, count), columns: {} };
+    wanted.forEach((signal, i) => {
+      result.columns[this.signals[signal].name] = columns[i].subarray(0, count);
+    });
+    return result;
+  }
+
+  private read(position: number, length: number): Buffer {
+    const buf = Buffer.allocUnsafe(length);
+    const n = fs.readSync(this.fd, buf, 0, length, position);
+    if (n < length) throw new Error('Truncated signal recording');
+    return buf;
+  }
+
+  private readIndex(): RowGroupInfo[] | null {
+    const size = fs.fstatSync(this.fd).size;
+    if (size < TRAILER_SIZE) return null;
+    const trailer = this.read(size - TRAILER_SIZE, TRAILER_SIZE);
+    if (trailer.toString('latin1', 8) !== SIGNAL_INDEX_MAGIC) return null;
+
+    const count = trailer.readUInt32LE(0);
+    const index = this.read(size - TRAILER_SIZE - trailer.readUInt32LE(4), count * INDEX_ENTRY_SIZE);
+    const groups: RowGroupInfo[] = [];
+    for (let g = 0; g < count; g++) {
+      const at = g * INDEX_ENTRY_SIZE;
+      groups.push({
+        offset: index.readDoubleLE(at),
+        rows: index.readUInt32LE(at + 8),
+        first: index.readDoubleLE(at + 12),
+        last: index.readDoubleLE(at + 20),
+      });
+    }
+    return groups;
+  }
+
+  // No index (the recorder did not close cleanly): walk the group headers
+  private scanGroups(start: number): RowGroupInfo[] {
+    const size = fs.fstatSync(this.fd).size;
+    const columnCount = this.signals.length + 1;
+    const headSize = GROUP_FIXED_SIZE + columnCount * 4;
+    const groups: RowGroupInfo[] = [];
+
+    for (let offset = start; offset + headSize <= size;) {
+      const head = this.read(offset, headSize);
+      if (head.readUInt32LE(0) !== GROUP_MAGIC) break;
+      let length = headSize;
+      for (let c = 0; c < columnCount; c++) length += head.readUInt32LE(GROUP_FIXED_SIZE + c * 4);
+      if (offset + length > size) break;  // Partly written
+      groups.push({ offset, rows: head.readUInt32LE(4), first: head.readDoubleLE(8), last: head.readDoubleLE(16) });
+      offset += length;
+    }
+    return groups;
+  }
+}
+
+// Unsigned LEB128 at `at`; returns [value, next offset]
+function readVarint(buf: Buffer, at: number): [number, number] {
+  let value = 0;
+  let scale = 1;
+  for (;;) {
+    const b = buf[at++];
+    value += (b & 0x7F) * scale;
+    if (b < 0x80) return [value, at];
+    scale *= 0x80;
+  }
+}
+
+function decodeTimes(buf: Buffer, rows: number, first: number): Float64Array {
+  const times = new Float64Array(rows);
+  let at = 0;
+  let t = first;
+  for (let r = 0; r < rows; r++) {
+    const [v, next] = readVarint(buf, at);
+    at = next;
+    t += unzigzag(v);
+    times[r] = t;
+  }
+  return times;
+}
+
+function decodeSignal(buf: Buffer, rows: number, resolution: number): Float64Array {
+  const values = new Float64Array(rows);
+  let at = 0;
+  let q = 0;
+  for (let r = 0; r < rows; r++) {
+    const [v, next] = readVarint(buf, at);
+    at = next;
+    if (v === 0) {
+      values[r] = NaN;
+      continue;
+    }
+    q += unzigzag(v - 1);
+    values[r] = q * resolution;
+  }
+  return values;
+}
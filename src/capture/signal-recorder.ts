@@ -0,0 +1,245 @@
+// Columnar recorder for decoded signals, for long test drives
+//
+// Rows of (timestamp, every signal) are buffered into a fixed-size row
+// group; when it fills, each column is encoded and compressed on its own
+// and the group is appended to the file. Memory use is therefore bounded
+// by the group size, and a reader can pull single columns of single
+// groups with positioned reads (see signal-reader.ts).
+//
+// Values are stored as integer multiples of the signal's decoder
+// resolution, delta-coded against the previous row, zigzag + varint
+// encoded and deflated. Typical rows cost well under a byte per signal.
+//
+// File layout (little-endian):
+//   header    "OSSMSIG\0", u16 version, u16 columns, u32 meta length
+//   meta      JSON { signals: [{ name, resolution }], startedAt }
+//   groups    u32 GROUP_MAGIC, u32 rows, f64 first ts, f64 last ts,
+//             u32 byte length per column (time first, then each signal),
+//             column blobs (deflate-raw)
+//   index     per group: f64 offset, u32 rows, f64 first ts, f64 last ts
+//   trailer   u32 group count, u32 index length, "OSSMIDX\0"
+//
+// Time column: us since the epoch, zigzag varint delta from the group's
+// first timestamp (first row 0). Signal columns: 0 for "not available",
+// otherwise zigzag(delta from the previous available value) + 1, starting
+// from 0 in every group so groups decode independently. A file without
+// the trailer (recorder killed) is still readable by scanning groups.
+import * as fs from 'fs';
+import * as zlib from 'zlib';
+import { PGN_DESCRIPTORS, SIGNAL_COUNT, SIGNAL_NAMES, SignalSource } from '../protocol/decoder';
+
+export const SIGNAL_FILE_MAGIC = 'OSSMSIG\0';
+export const SIGNAL_INDEX_MAGIC = 'OSSMIDX\0';
+export const SIGNAL_FILE_VERSION = 1;
+export const SIGNAL_HEADER_SIZE = 16;
+export const GROUP_MAGIC = 0x50524752;  // "RGRP"
+export const GROUP_FIXED_SIZE = 24;     // Magic, rows, first and last timestamp
+export const INDEX_ENTRY_SIZE = 28;
+export const TRAILER_SIZE = 16;
+
+export interface SignalMeta {
+  name: string;
+  resolution: number;  // Value of one stored unit
+}
+
+export interface RecorderOptions {
+  intervalMs?: number;  // Sample every intervalMs from start() (default 100); 0 = only on sample()
+  groupRows?: number;   // Rows per row group (default 8192)
+}
+
+export interface RecorderStats {
+  rows: number;
+  groups: number;
+  bytes: number;  // Written to disk so far
+}
+
+// Finest decoder step per signal, so stored integers are exact
+function signalResolutions(): number[] {
+  const resolution = new Array<number>(SIGNAL_COUNT).fill(0);
+  for (const desc of PGN_DESCRIPTORS) {
+    for (const f of desc.fields) {
+      if (resolution[f.signal] === 0 || f.scale < resolution[f.signal]) resolution[f.signal] = f.scale;
+    }
+  }
+  return resolution.map(r => r || 1);
+}
+
+export class SignalRecorder {
+  private readonly source: SignalSource;
+  private readonly intervalMs: number;
+  private readonly groupRows: number;
+  private readonly resolution: Float64Array;
+  private readonly times: Float64Array;
+  private readonly values: Float64Array;  // Row-major: row * SIGNAL_COUNT + signal
+  private readonly scratch: Buffer;       // Encode buffer for one column
+  private readonly index: number[] = [];  // Flattened [offset, rows, first, last] per group
+  private rows = 0;                       // Rows in the open group
+  private fd: number;
+  private fileBytes: number;
+  private timer: NodeJS.Timeout | null = null;
+  private writes: Promise<void> = Promise.resolve();
+  private writeError: Error | null = null;
+  private readonly stats: RecorderStats = { rows: 0, groups: 0, bytes: 0 };
+
+  constructor(filePath: string, source: SignalSource, options: RecorderOptions = {}) {
+    this.source = source;
+    this.intervalMs = Math.max(0, options.intervalMs ?? 100);
+    this.groupRows = Math.max(16, options.groupRows ?? 8192);
+    const resolutions = signalResolutions();
+    this.resolution = Float64Array.from(resolutions);
+    this.times = new Float64Array(this.groupRows);
+    this.values = new Float64Array(this.groupRows * SIGNAL_COUNT);
+    this.scratch = Buffer.allocUnsafe(this.groupRows * 10);  // Max varint length
+
+    const meta: { signals: SignalMeta[]; startedAt: number } = {
+      signals: SIGNAL_NAMES.map((name, i) => ({ name, resolution: resolutions[i] })),
+      startedAt: Date.now(),
+    };
+    const metaJson = Buffer.from(JSON.stringify(meta));
+    const header = Buffer.alloc(SIGNAL_HEADER_SIZE);
+    header.write(SIGNAL_FILE_MAGIC, 0, 'latin1');
+    header.writeUInt16LE(SIGNAL_FILE_VERSION, 8);
+    header.writeUInt16LE(SIGNAL_COUNT, 10);
+    header.writeUInt32LE(metaJson.length, 12);
+
+    this.fd = fs.openSync(filePath, 'w');
+    fs.writeSync(this.fd, header);
+    fs.writeSync(this.fd, metaJson);
+    this.fileBytes = header.length + metaJson.length;
+    this.stats.bytes = this.fileBytes;
+  }
+
+  // Sample at the fixed interval until close()
+  start(): void {
+    if (this.timer || this.intervalMs === 0) return;
+    this.timer = setInterval(() => this.sample(), this.intervalMs);
+  }
+
+  // Append one row with the source's current values. For on-change
+  // recording, call this from onSensorData with the frame timestamp.
+  sample(timestamp: number = Date.now() * 1000): void {
+    if (this.writeError) return;
+    this.source.sync();
+    const row = this.rows++;
+    this.times[row] = Math.round(timestamp);
+    this.values.set(this.source.values, row * SIGNAL_COUNT);
+    this.stats.rows++;
+    if (this.rows === this.groupRows) this.flushGroup();
+  }
+
+  getStats(): RecorderStats {
+    return { ...this.stats };
+  }
+
+  // Write the open group and the index, then close the file
+  async close(): Promise<void> {
+    if (this.timer) {
+      clearInterval(this.timer);
+      this.timer = null;
+    }
+    if (this.rows > 0) this.flushGroup();
+    await this.writes;
+
+    if (!this.writeError) {
+      const groups = this.index.length / 4;
+      const tail = Buffer.alloc(groups * INDEX_ENTRY_SIZE + TRAILER_SIZE);
+      for (let g = 0; g < groups; g++) {
+        const at = g * INDEX_ENTRY_SIZE;
+        tail.writeDoubleLE(this.index[g * 4], at);
+        tail.writeUInt32LE(this.index[g * 4 + 1], at + 8);
+        tail.writeDoubleLE(this.index[g * 4 + 2], at + 12);
+        tail.writeDoubleLE(this.index[g * 4 + 3], at + 20);
+      }
+      const at = groups * INDEX_ENTRY_SIZE;
+      tail.writeUInt32LE(groups, at);
+      tail.writeUInt32LE(groups * INDEX_ENTRY_SIZE, at + 4);
+      tail.write(SIGNAL_INDEX_MAGIC, at + 8, 'latin1');
+      try {
+        fs.writeSync(this.fd, tail, 0, tail.length, this.fileBytes);
+        this.stats.bytes += tail.length;
+      } catch (err) {
+        this.writeError = err as Error;
+      }
+    }
+    fs.closeSync(this.fd);
+    if (this.writeError) throw this.writeError;
+  }
+
+  // Encode and compress the open group, then queue it for writing
+  private flushGroup(): void {
+    const rows = this.rows;
+    const columns: Buffer[] = [zlib.deflateRawSync(this.scratch.subarray(0, this.encodeTimes(rows)))];
+    for (let s = 0; s < SIGNAL_COUNT; s++) {
+      columns.push(zlib.deflateRawSync(this.scratch.subarray(0, this.encodeSignal(s, rows))));
+    }
+
+    const head = Buffer.alloc(GROUP_FIXED_SIZE + columns.length * 4);
+    head.writeUInt32LE(GROUP_MAGIC, 0);
+    head.writeUInt32LE(rows, 4);
+    head.writeDoubleLE(this.times[0], 8);
+    head.writeDoubleLE(this.times[rows - 1], 16);
+    columns.forEach((c, i) => head.writeUInt32LE(c.length, GROUP_FIXED_SIZE + i * 4));
+
+    const offset = this.fileBytes;
+    const group = Buffer.concat([head, ...columns]);
+    this.fileBytes += group.length;
+    this.index.push(offset, rows, this.times[0], this.times[rows - 1]);
+    this.stats.groups++;
+    this.rows = 0;
+
+    this.writes = this.writes.then(() => new Promise<void>(resolve => {
+      fs.write(this.fd, group, 0, group.length, offset, err => {
+        if (err) this.writeError = err;
+        else this.stats.bytes += group.length;
+        resolve();
+      });
+    }));
+  }
+
+  private encodeTimes(rows: number): number {
+    const out = this.scratch;
+    let at = 0;
+    let previous = this.times[0];
+    for (let r = 0; r < rows; r++) {
+      at = writeVarint(out, at, zigzag(this.times[r] - previous));
+      previous = this.times[r];
+    }
+    return at;
+  }
+
+  private encodeSignal(signal: number, rows: number): number {
+    const out = this.scratch;
+    const resolution = this.resolution[signal];
+    let at = 0;
+    let previous = 0;
+    for (let r = 0; r < rows; r++) {
+      const v = this.values[r * SIGNAL_COUNT + signal];
+      if (Number.isNaN(v)) {
+        out[at++] = 0;
+        continue;
+      }
+      const q = Math.round(v / resolution);
+      at = writeVarint(out, at, zigzag(q - previous) + 1);
+      previous = q;
+    }
+    return at;
+  }
+}
+
+export function zigzag(v: number): number {
+  return v >= 0 ? v * 2 : -v * 2 - 1;
+}
+
+export function unzigzag(v: number): number {
+  return v % 2 === 0 ? v / 2 : -(v + 1) / 2;
+}
+
+// Unsigned LEB128, valid up to 2^53 (no 32-bit bitwise ops)
+function writeVarint(out: Buffer, at: number, v: number): number {
+  while (v >= 0x80) {
+    out[at++] = (v % 0x80) | 0x80;
+    v = Math.floor(v / 0x80);
+  }
+  out[at++] = v;
+  return at;
+}
@@ -0,0 +1,260 @@
+// Buffered, append-only CAN frame capture writer
+//
+// Frames are encoded straight into preallocated chunks of a small ring and
+// each full chunk is handed to one async fs.write, so the receive path
+// never formats strings or waits on the disk. If the disk falls behind
+// and every chunk is busy, frames are counted as dropped, not buffered
+// without bound.
+import * as fs from 'fs';
+import * as path from 'path';
+import { CAN_EFF_FLAG, FrameBatch } from '../can/socketcan';
+
+export type CaptureFormat = 'bin' | 'candump';
+
+export interface CaptureOptions {
+  format?: CaptureFormat;    // Default 'bin'
+  interfaceName?: string;    // Interface column for candump logs
+  rotateBytes?: number;      // Start a new file past this size (0 = never)
+  chunkSize?: number;        // Bytes per ring chunk (default 256 KiB)
+  chunks?: number;           // Ring length (default 4)
+  flushIntervalMs?: number;  // Max time data sits in a partial chunk (default 500)
+}
+
+// Binary capture layout (little-endian):
+//   header  "OSSMCAP\0", u16 version, u16 record size, u32 reserved
+//   record  u32 ts_sec, u32 ts_usec, u32 can_id (bit 31 = extended),
+//           u8 dlc, 3 reserved, 8 data bytes
+export const CAPTURE_MAGIC = 'OSSMCAP\0';
+export const CAPTURE_VERSION = 1;
+export const CAPTURE_HEADER_SIZE = 16;
+export const CAPTURE_RECORD_SIZE = 24;
+
+// Worst-case candump line: "(ssssssssss.uuuuuu) <ifname> XXXXXXXX#" + 16 hex + "\n"
+const CANDUMP_MAX_FIXED = 47;
+
+const HEX = Buffer.from('0123456789ABCDEF');
+
+export interface CaptureStats {
+  frames: number;
+  bytes: number;
+  dropped: number;
+  files: number;
+}
+
+export class CaptureWriter {
+  private readonly basePath: string;
+  private readonly format: CaptureFormat;
+  private readonly ifname: Buffer;
+  private readonly rotateBytes: number;
+  private readonly ring: Buffer[];
+  private readonly busy: boolean[];
+  private readonly flushIntervalMs: number;
+  private active = 0;      // Chunk being filled
+  private used = 0;        // Bytes used in the active chunk
+  private fd: number;
+  private fileBytes = 0;
+  private fileStart = 0;   // Size of the current file when opened
+  private fileIndex = 0;
+  private writes: Promise<void> = Promise.resolve();
+  private flushTimer: NodeJS.Timeout | null = null;
+  private writeError: Error | null = null;
+  private readonly stats: CaptureStats = { frames: 0, bytes: 0, dropped: 0, files: 0 };
+
+  constructor(filePath: string, options: CaptureOptions = {}) {
+    this.basePath = filePath;
+    this.format = options.format ?? 'bin';
+    this.ifname = Buffer.from(options.interfaceName ?? 'can0');
+    this.rotateBytes = options.rotateBytes ?? 0;
+    this.flushIntervalMs = options.flushIntervalMs ?? 500;
+
+    const chunkSize = Math.max(4096, options.chunkSize ?? 256 * 1024);
+    const chunks = Math.max(2, options.chunks ?? 4);
+    this.ring = Array.from({ length: chunks }, () => Buffer.allocUnsafe(chunkSize));
+    this.busy = new Array(chunks).fill(false);
+
+    this.fd = this.openFile();
+  }
+
+  // Append every frame in a batch
+  writeBatch(batch: FrameBatch): void {
+    if (this.writeError) return;
+
+    // Kernel timestamps are normally present; fall back to one clock read per batch
+    let fallbackTs = 0;
+    const recordMax = this.format === 'bin' ? CAPTURE_RECORD_SIZE : CANDUMP_MAX_FIXED + this.ifname.length;
+
+    for (let i = 0; i < batch.count; i++) {
+      if (this.used + recordMax > this.ring[this.active].length && !this.rotateChunk()) {
+        this.stats.dropped += batch.count - i;
+        return;
+      }
+
+      let ts = Math.floor(batch.timestamps[i]);
+      if (ts === 0) ts = fallbackTs || (fallbackTs = Date.now() * 1000);
+
+      const chunk = this.ring[this.active];
+      this.used = this.format === 'bin'
+        ? this.encodeBinary(chunk, this.used, batch, i, ts)
+        : this.encodeCandump(chunk, this.used, batch, i, ts);
+      this.stats.frames++;
+    }
+
+    if (this.used > 0 && this.flushTimer === null) this.armFlush();
+  }
+
+  getStats(): CaptureStats {
+    return { ...this.stats };
+  }
+
+  // Flush buffered data and close the file
+  async close(): Promise<void> {
+    if (this.flushTimer) {
+      clearTimeout(this.flushTimer);
+      this.flushTimer = null;
+    }
+    if (this.used > 0) this.queueWrite(this.active, this.used);
+    this.used = 0;
+    await this.writes;
+    fs.closeSync(this.fd);
+    if (this.writeError) throw this.writeError;
+  }
+
+  private encodeBinary(out: Buffer, at: number, batch: FrameBatch, i: number, ts: number): number {
+    const sec = Math.floor(ts / 1e6);
+    const dlc = batch.dlcs[i];
+    out.writeUInt32LE(sec, at);
+    out.writeUInt32LE(ts - sec * 1e6, at + 4);
+    out.writeUInt32LE((batch.ids[i] | (batch.ext[i] ? CAN_EFF_FLAG : 0)) >>> 0, at + 8);
+    out[at + 12] = dlc;
+    out[at + 13] = 0;
+    out[at + 14] = 0;
+    out[at + 15] = 0;
+    out.fill(0, at + 16, at + 24);
+    const base = i * 8;
+    for (let b = 0; b < dlc; b++) out[at + 16 + b] = batch.data[base + b];
+    return at + CAPTURE_RECORD_SIZE;
+  }
+
+  // candump -l format: "(1436509052.249713) can0 18FEEE95#7800647E00000000"
+  private encodeCandump(out: Buffer, at: number, batch: FrameBatch, i: number, ts: number): number {
+    const sec = Math.floor(ts / 1e6);
+    const usec = ts - sec * 1e6;
+
+    out[at++] = 0x28;  // (
+    at = writeDecimal(out, at, sec, 0);
+    out[at++] = 0x2E;  // .
+    at = writeDecimal(out, at, usec, 6);
+    out[at++] = 0x29;  // )
+    out[at++] = 0x20;
+    at += this.ifname.copy(out, at);
+    out[at++] = 0x20;
+
+    const id = batch.ids[i];
+    for (let shift = batch.ext[i] ? 28 : 8; shift >= 0; shift -= 4) {
+      out[at++] = HEX[(id >>> shift) & 0xF];
+    }
+    out[at++] = 0x23;  // #
+
+    const base = i * 8;
+    const dlc = batch.dlcs[i];
+    for (let b = 0; b < dlc; b++) {
+      const v = batch.data[base + b];
+      out[at++] = HEX[v >> 4];
+      out[at++] = HEX[v & 0xF];
+    }
+    out[at++] = 0x0A;
+    return at;
+  }
+
+  // Push out a partially filled chunk so data never sits in memory for long
+  private armFlush(): void {
+    this.flushTimer = setTimeout(() => {
+      this.flushTimer = null;
+      if (this.used > 0 && !this.rotateChunk()) this.armFlush();
+    }, this.flushIntervalMs);
+  }
+
+  // Hand the active chunk to the disk and move to the next free one.
+  // Returns false (leaving the active chunk as is) if the next chunk is
+  // still waiting on a write.
+  private rotateChunk(): boolean {
+    const next = (this.active + 1) % this.ring.length;
+    if (this.busy[next]) return false;
+
+    if (this.used > 0) this.queueWrite(this.active, this.used);
+    this.active = next;
+    this.used = 0;
+    return true;
+  }
+
+  private queueWrite(index: number, length: number): void {
+    this.busy[index] = true;
+    this.writes = this.writes.then(async () => {
+      try {
+        if (this.rotateBytes > 0 && this.fileBytes > this.fileStart && this.fileBytes + length > this.rotateBytes) {
+          fs.closeSync(this.fd);
+          this.fd = this.openFile();
+        }
+        await writeAll(this.fd, this.ring[index], length);
+        this.fileBytes += length;
+        this.stats.bytes += length;
+      } catch (err) {
+        this.writeError = err as Error;
+      } finally {
+        this.busy[index] = false;
+      }
+    });
+  }
+
+  // capture.bin, capture.1.bin, capture.2.bin, ...
+  private openFile(): number {
+    const ext = path.extname(this.basePath);
+    const name = this.fileIndex === 0
+      ? this.basePath
+      : `${this.basePath.slice(0, this.basePath.length - ext.length)}.${this.fileIndex}${ext}`;
+    this.fileIndex++;
+
+    const fd = fs.openSync(name, 'a');
+    this.fileBytes = fs.fstatSync(fd).size;
+    this.stats.files++;
+
+    if (this.format === 'bin' && this.fileBytes === 0) {
+      const header = Buffer.alloc(CAPTURE_HEADER_SIZE);
+      header.write(CAPTURE_MAGIC, 0, 'latin1');
+      header.writeUInt16LE(CAPTURE_VERSION, 8);
+      header.writeUInt16LE(CAPTURE_RECORD_SIZE, 10);
+      fs.writeSync(fd, header);
+      this.fileBytes = CAPTURE_HEADER_SIZE;
+    }
+    this.fileStart = this.fileBytes;
+    return fd;
+  }
+}
+
+// Write a non-negative integer as ASCII, zero-padded to `width` digits
+function writeDecimal(out: Buffer, at: number, value: number, width: number): number {
+  let digits = 1;
+  for (let v = value; v >= 10; v = Math.floor(v / 10)) digits++;
+  if (digits < width) digits = width;
+
+  for (let i = digits - 1; i >= 0; i--) {
+    out[at + i] = 0x30 + (value % 10);
+    value = Math.floor(value / 10);
+  }
+  return at + digits;
+}
+
+function writeAll(fd: number, buf: Buffer, length: number): Promise<void> {
+  return new Promise((resolve, reject) => {
+    let offset = 0;
+    const next = () => {
+      fs.write(fd, buf, offset, length - offset, null, (err, written) => {
+        if (err) return reject(err);
+        offset += written;
+        if (offset < length) next();
+        else resolve();
+      });
+    };
+    next();
+  });
+}
@@ -0,0 +1,181 @@
+// One-shot device commands for scripts and orchestrators
+//
+//   ossm-config query                       ossm-config tc K
+//   ossm-config enable <spn> [input]        ossm-config save
+//   ossm-config disable <spn>               ossm-config reset
+//   ossm-config ntc <input> <preset>        ossm-config pressure <input> <preset>
+//
+// Each target produces one JSON object on its own stdout line, printed as
+// soon as that device finishes; several -t targets run as in `apply`.
+// Exit status: 0 all succeeded, 1 any device failed, 2 bad usage.
+//
+// A target with a running daemon (`ossm-config daemon`) is served through
+// it instead of opening the bus again.
+import { DeviceCache } from '../config/cache';
+import { DeviceModel } from '../config/model';
+import { ConfigCommand, describeCommand, parseProfile, planCommands, toProfile } from '../config/profile';
+import { DaemonClient } from '../daemon/client';
+import { defaultSocketPath } from '../daemon/rpc';
+import { OssmDevice } from '../protocol/j1939';
+import { DeviceProgress, Station, StationOptions, Target, targetName } from '../provision/station';
+
+export const EXIT = {
+  OK: 0,
+  FAILED: 1,
+  USAGE: 2,
+} as const;
+
+const USAGE: Record<string, string> = {
+  query: 'query',
+  enable: 'enable <spn> [input]',
+  disable: 'disable <spn>',
+  ntc: 'ntc <input> <preset>',
+  pressure: 'pressure <input> <preset>',
+  tc: 'tc <type>',
+  save: 'save',
+  reset: 'reset',
+};
+
+export const DEVICE_COMMANDS = Object.keys(USAGE);
+
+type Result = Record<string, unknown>;
+type Action = (model: DeviceModel, device: OssmDevice) => Promise<Result>;
+
+export interface DeviceCommandOptions extends StationOptions {
+  cache: boolean;
+  daemon: boolean;  // Use a daemon already serving the target
+  socket?: string;  // Its socket, for a single target (default per target)
+}
+
+export async function runDeviceCommand(
+  name: string,
+  args: string[],
+  targets: Target[],
+  options: DeviceCommandOptions
+): Promise<number> {
+  let action: Action;
+  try {
+    action = parseDeviceCommand(name, args);
+  } catch (err) {
+    console.error((err as Error).message);
+    return EXIT.USAGE;
+  }
+
+  const { cache, daemon, socket, ...stationOptions } = options;
+  const results = new Map<Target, Result>();
+  const report = (p: DeviceProgress) => {
+    if (p.state !== 'done' && p.state !== 'failed') return;
+    const line = p.state === 'done'
+      ? { target: targetName(p.target), command: name, ok: true, ...results.get(p.target), elapsedMs: p.elapsedMs }
+      : { target: targetName(p.target), command: name, ok: false, error: p.error, elapsedMs: p.elapsedMs };
+    console.log(JSON.stringify(line));
+  };
+
+  const served = new Map<Target, DaemonClient>();
+  if (daemon) {
+    await Promise.all(targets.map(async target => {
+      const client = await DaemonClient.find(socket && targets.length === 1 ? socket : defaultSocketPath(target));
+      if (client) served.set(target, client);
+    }));
+  }
+  const direct = targets.filter(target => !served.has(target));
+  const station = direct.length > 0 ? new Station(direct, stationOptions) : null;
+
+  try {
+    station?.open();
+    const progress = await Promise.all([
+      station?.run(async (protocol, _progress, target) => {
+        const deviceCache = cache ? new DeviceCache(target.interface, target.address) : undefined;
+        results.set(target, await action(new DeviceModel(protocol, deviceCache), protocol));
+      }, report) ?? [],
+      // The daemon keeps its own model and cache
+      ...[...served].map(async ([target, client]) => {
+        const started = Date.now();
+        const p: DeviceProgress = { target, state: 'done', step: 'done', done: 0, total: 0, elapsedMs: 0 };
+        try {
+          results.set(target, await action(new DeviceModel(client), client));
+        } catch (err) {
+          p.state = p.step = 'failed';
+          p.error = (err as Error).message;
+        }
+        p.elapsedMs = Date.now() - started;
+        report(p);
+        return [p];
+      }),
+    ]);
+    return progress.flat().every(p => p.state === 'done') ? EXIT.OK : EXIT.FAILED;
+  } finally {
+    station?.close();
+    for (const client of served.values()) client.close();
+  }
+}
+
+// Validate arguments up front, before any bus traffic
+function parseDeviceCommand(name: string, args: string[]): Action {
+  const usage = USAGE[name];
+  const expect = (min: number, max: number) => {
+    if (args.length < min || args.length > max) throw new Error(`Usage: ossm-config ${usage}`);
+  };
+
+  switch (name) {
+    case 'query':
+      expect(0, 0);
+      return query;
+    case 'save':
+      expect(0, 0);
+      return async model => {
+        if (!(await model.save())) throw new Error('Module rejected SAVE');
+        return {};
+      };
+    case 'reset':
+      expect(0, 0);
+      return async model => {
+        if (!(await model.reset())) throw new Error('Module rejected RESET');
+        return {};
+      };
+    case 'enable':
+      expect(1, 2);
+      return setting({ spns: [{ spn: value(args[0]), input: value(args[1] ?? '0') }] });
+    case 'disable':
+      expect(1, 1);
+      return setting({ spns: [{ spn: value(args[0]), enable: false }] });
+    case 'ntc':
+      expect(2, 2);
+      return setting({ ntcPresets: { [args[0]]: value(args[1]) } });
+    case 'pressure':
+      expect(2, 2);
+      return setting({ pressurePresets: { [args[0]]: value(args[1]) } });
+    case 'tc':
+      expect(1, 1);
+      return setting({ thermocoupleType: value(args[0]) });
+    default:
+      throw new Error(`Unknown command '${name}' (see --help)`);
+  }
+}
+
+// The config in profile form, so it can be fed straight back to `apply`
+async function query(model: DeviceModel, device: OssmDevice): Promise<Result> {
+  const config = await model.refresh();
+  if (!config) return { raw: (await device.query()).toString('hex') };
+  return { config: toProfile(config) };
+}
+
+// A single setting, validated with the profile parser
+function setting(fragment: Record<string, unknown>): Action {
+  let command: ConfigCommand;
+  try {
+    [command] = planCommands(parseProfile(fragment));
+  } catch (err) {
+    throw new Error((err as Error).message.replace(/^Invalid profile: /, ''));
+  }
+
+  return async model => {
+    if (!(await model.run(command))) throw new Error(`Module rejected: ${describeCommand(command)}`);
+    return { setting: command };
+  };
+}
+
+// Numbers as numbers, anything else (a preset or type name) as given
+function value(arg: string): number | string {
+  return /^\d+$/.test(arg) ? Number(arg) : arg;
+}
@@ -0,0 +1,117 @@
+// On-disk cache of the last known configuration of each device
+//
+// One JSON file per interface and source address under
+// $XDG_CACHE_HOME/ossm-config (~/.cache/ossm-config by default). The
+// device's J1939 NAME is stored alongside and an entry is only used for
+// the module with that NAME, so one that did not answer with its NAME
+// gets no cached state. Only settings the module has saved are recorded.
+// The cache only saves traffic and waiting; a failure to read or write it
+// never fails an operation.
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+import { formatName } from '../protocol/address-claim';
+import { ConfigCommand, ConfigState, applyCommand, emptyConfigState } from './profile';
+
+const CACHE_VERSION = 1;
+
+export interface CachedConfig {
+  name: bigint;         // NAME of the device the state was read from
+  updatedAt: number;    // ms since the epoch
+  state: ConfigState;
+}
+
+interface CacheFile {
+  version: number;
+  name: string;
+  updatedAt: number;
+  tcType?: number;
+  ntcPresets: [number, number][];
+  pressurePresets: [number, number][];
+  spns: [number, boolean, number][];  // SPN, enabled, input
+}
+
+export function defaultCacheDir(): string {
+  return path.join(process.env.XDG_CACHE_HOME || path.join(os.homedir(), '.cache'), 'ossm-config');
+}
+
+export class DeviceCache {
+  readonly path: string;
+
+  constructor(interfaceName: string, address: number, dir: string = defaultCacheDir()) {
+    const file = `${interfaceName.replace(/[^\w.-]/g, '_')}-${address.toString(16).padStart(2, '0')}.json`;
+    this.path = path.join(dir, file);
+  }
+
+  // The entry recorded for the device with `name`, or null if there is
+  // none, it is unreadable, or either NAME is unknown
+  load(name: bigint | null): CachedConfig | null {
+    if (name === null) return null;
+    let file: CacheFile;
+    try {
+      file = JSON.parse(fs.readFileSync(this.path, 'utf8'));
+    } catch {
+      return null;
+    }
+    if (file?.version !== CACHE_VERSION) return null;
+
+    if (typeof file.name !== 'string' || BigInt(`0x${file.name}`) !== name) return null;
+
+    const state = emptyConfigState();
+    if (file.tcType !== undefined) state.tcType = file.tcType;
+    for (const [input, preset] of file.ntcPresets ?? []) state.ntcPresets.set(input, preset);
+    for (const [input, preset] of file.pressurePresets ?? []) state.pressurePresets.set(input, preset);
+    for (const [spn, enable, input] of file.spns ?? []) state.spns.set(spn, { enable, input });
+    return { name, updatedAt: file.updatedAt, state };
+  }
+
+  // Replace the entry; written to a temporary file and renamed into place.
+  // Without a NAME the entry could not be trusted, so it is removed instead.
+  save(state: ConfigState, name: bigint | null): void {
+    if (name === null) {
+      this.clear();
+      return;
+    }
+    const file: CacheFile = {
+      version: CACHE_VERSION,
+      name: formatName(name),
+      updatedAt: Date.now(),
+      tcType: state.tcType,
+      ntcPresets: [...state.ntcPresets],
+      pressurePresets: [...state.pressurePresets],
+      spns: [...state.spns].map(([spn, s]) => [spn, s.enable, s.input]),
+    };
+    try {
+      fs.mkdirSync(path.dirname(this.path), { recursive: true });
+      const tmp = `${this.path}.${process.pid}.tmp`;
+      fs.writeFileSync(tmp, JSON.stringify(file) + '\n');
+      fs.renameSync(tmp, this.path);
+    } catch {
+      // Best effort
+    }
+  }
+
+  // Fold settings the device has saved into its entry
+  record(commands: ConfigCommand[], name: bigint | null): void {
+    const state = this.load(name)?.state ?? emptyConfigState();
+    for (const command of commands) applyCommand(state, command);
+    this.save(state, name);
+  }
+
+  clear(): void {
+    try {
+      fs.unlinkSync(this.path);
+    } catch {
+      // Already gone
+    }
+  }
+}
+
+export function sameConfig(a: ConfigState, b: ConfigState): boolean {
+  const sameMap = <V>(x: Map<number, V>, y: Map<number, V>, eq: (p: V, q: V) => boolean) =>
+    x.size === y.size && [...x].every(([k, v]) => y.has(k) && eq(v, y.get(k)!));
+  return a.tcType === b.tcType &&
+    sameMap(a.ntcPresets, b.ntcPresets, (p, q) => p === q) &&
+    sameMap(a.pressurePresets, b.pressurePresets, (p, q) => p === q) &&
+    sameMap(a.spns, b.spns, (p, q) => p.enable === q.enable && p.input === q.input);
+}
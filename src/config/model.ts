@@ -0,0 +1,166 @@
+// Local model of one device's configuration
+//
+// Filled from a full readback (the sectioned QUERY, multi-frame over the
+// transport protocol) or, until one arrives, from the on-disk cache. Every
+// setting sent through run() is folded in as soon as the module accepts
+// it, so the model stays current without further queries; the cache only
+// takes settings once a SAVE through save() succeeds. Reads are Map
+// lookups; UI and scripts never need the bus to know what is set.
+import type { CommandOptions, OssmDevice } from '../protocol/j1939';
+import type { DeviceCache } from './cache';
+import { ConfigCommand, ConfigState, SpnSetting, applyCommand, emptyConfigState, planCommands, runCommand } from './profile';
+import { readDeviceConfig } from './readback';
+import { ConfigTransaction } from './transaction';
+
+export type ModelSource = 'device' | 'cache';
+
+export class DeviceModel {
+  readonly device: OssmDevice;
+  private readonly cache: DeviceCache | undefined;
+  private current: ConfigState | null = null;
+  private origin: ModelSource | null = null;
+  private cachedAt = 0;
+  private refreshing: Promise<ConfigState | null> | null = null;
+  private unsaved: ConfigCommand[] = [];  // Accepted since the last SAVE
+  private readonly handlers: ((state: ConfigState | null) => void)[] = [];
+
+  constructor(device: OssmDevice, cache?: DeviceCache) {
+    this.device = device;
+    this.cache = cache;
+  }
+
+  // Last known configuration, or null if unknown
+  get state(): ConfigState | null {
+    return this.current;
+  }
+
+  // Where the state came from (settings accepted since are included)
+  get source(): ModelSource | null {
+    return this.origin;
+  }
+
+  // When a cached state was recorded (ms since the epoch, 0 = not cached)
+  get cachedSince(): number {
+    return this.origin === 'cache' ? this.cachedAt : 0;
+  }
+
+  get tcType(): number | undefined {
+    return this.current?.tcType;
+  }
+
+  spn(spn: number): SpnSetting | undefined {
+    return this.current?.spns.get(spn);
+  }
+
+  ntcPreset(input: number): number | undefined {
+    return this.current?.ntcPresets.get(input);
+  }
+
+  pressurePreset(input: number): number | undefined {
+    return this.current?.pressurePresets.get(input);
+  }
+
+  // True if the known state already has this setting
+  isSet(command: ConfigCommand): boolean {
+    if (!this.current) return false;
+    const wanted = emptyConfigState();
+    applyCommand(wanted, command);
+    return planCommands(wanted, this.current).length === 0;
+  }
+
+  // Take the cached state, if any, while no readback has arrived. Only an
+  // entry recorded for this module's NAME is used, so it asks for that first.
+  async loadCached(): Promise<boolean> {
+    if (this.origin === 'device') return true;
+    if (!this.cache) return false;
+    const cached = this.cache.load(await this.device.identify());
+    if (!cached || this.origin === 'device') return this.origin === 'device';
+    this.cachedAt = cached.updatedAt;
+    this.set(cached.state, 'cache');
+    return true;
+  }
+
+  // Read the whole configuration from the device and update the cache.
+  // Concurrent callers share one readback. Resolves null when the firmware
+  // has no sectioned readback; the cached state is then kept, unless it
+  // belongs to a different module at this address.
+  refresh(): Promise<ConfigState | null> {
+    this.refreshing ??= Promise.all([this.device.identify(), readDeviceConfig(this.device)])
+      .then(([name, config]) => {
+        if (config) {
+          this.cache?.save(config, name);
+          this.set(config, 'device');
+        } else if (this.origin === 'cache' && this.cache?.load(name) === null) {
+          this.set(null, null);
+        }
+        return config;
+      })
+      .finally(() => {
+        this.refreshing = null;
+      });
+    return this.refreshing;
+  }
+
+  // Send one setting; on success it is applied to the model
+  async run(command: ConfigCommand): Promise<boolean> {
+    const ok = await runCommand(this.device, command);
+    if (ok) this.record([command]);
+    return ok;
+  }
+
+  // Stage several settings to send and save together (see transaction.ts)
+  begin(): ConfigTransaction {
+    return new ConfigTransaction(this);
+  }
+
+  // Fold settings the module accepted outside run() into the model; they
+  // reach the cache with the next successful save()
+  record(commands: ConfigCommand[]): void {
+    if (this.current) {
+      for (const command of commands) applyCommand(this.current, command);
+    }
+    this.unsaved.push(...commands);
+    this.notify();
+  }
+
+  // SAVE, then record what it stored in the cache
+  async save(options?: CommandOptions): Promise<boolean> {
+    const count = this.unsaved.length;  // Settings accepted before the SAVE went out
+    const ok = await this.device.save(options);
+    if (ok && count > 0) {
+      const saved = this.unsaved.splice(0, count);
+      if (this.cache) this.cache.record(saved, await this.device.identify());
+    }
+    return ok;
+  }
+
+  // Defaults are not known until the next readback
+  async reset(): Promise<boolean> {
+    const ok = await this.device.reset();
+    if (ok) {
+      this.unsaved = [];
+      this.cache?.clear();
+      this.set(null, null);
+    }
+    return ok;
+  }
+
+  // Called whenever the state changes. Returns an unsubscribe function.
+  onChange(handler: (state: ConfigState | null) => void): () => void {
+    this.handlers.push(handler);
+    return () => {
+      const i = this.handlers.indexOf(handler);
+      if (i >= 0) this.handlers.splice(i, 1);
+    };
+  }
+
+  private set(state: ConfigState | null, source: ModelSource | null): void {
+    this.current = state;
+    this.origin = source;
+    this.notify();
+  }
+
+  private notify(): void {
+    for (const handler of this.handlers) handler(this.current);
+  }
+}
@@ -0,0 +1,26 @@
+// Sensor preset and thermocouple type tables shared by the menu and profiles
+
+export const NTC_PRESETS = ['AEM', 'Bosch', 'GM'];
+
+// Bar presets are numbered from 0, PSI presets from PSI_PRESET_BASE
+export const PRESSURE_PRESETS_BAR = [
+  '1 Bar', '1.5 Bar', '2 Bar', '2.5 Bar', '3 Bar', '4 Bar', '5 Bar',
+  '7 Bar', '10 Bar', '50 Bar', '100 Bar', '150 Bar', '200 Bar',
+  '1000 Bar', '2000 Bar', '3000 Bar'
+];
+export const PRESSURE_PRESETS_PSI = [
+  '15 PSI', '30 PSI', '50 PSI', '100 PSI', '150 PSI', '200 PSI',
+  '250 PSI', '300 PSI', '350 PSI', '400 PSI', '500 PSI'
+];
+export const PSI_PRESET_BASE = 20;
+
+export const TC_TYPES = ['B', 'E', 'J', 'K', 'N', 'R', 'S', 'T'];
+
+// Input ranges on the OSSM board
+export const TEMP_INPUTS = 8;
+export const PRESSURE_INPUTS = 7;
+
+export function pressurePresetName(preset: number): string | undefined {
+  if (preset >= PSI_PRESET_BASE) return PRESSURE_PRESETS_PSI[preset - PSI_PRESET_BASE];
+  return PRESSURE_PRESETS_BAR[preset];
+}
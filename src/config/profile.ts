@@ -0,0 +1,230 @@
+// Declarative configuration profiles for non-interactive provisioning
+import * as fs from 'fs';
+import { OssmDevice } from '../protocol/j1939';
+import {
+  NTC_PRESETS, PRESSURE_INPUTS, PRESSURE_PRESETS_BAR, PRESSURE_PRESETS_PSI,
+  PSI_PRESET_BASE, TC_TYPES, TEMP_INPUTS, pressurePresetName
+} from './presets';
+
+export interface SpnSetting {
+  enable: boolean;
+  input: number;
+}
+
+// Normalised configuration - at most one entry per setting
+export interface ConfigState {
+  spns: Map<number, SpnSetting>;
+  ntcPresets: Map<number, number>;       // Temperature input -> preset
+  pressurePresets: Map<number, number>;  // Pressure input -> preset
+  tcType?: number;
+}
+
+export type ConfigCommand =
+  | { kind: 'spn'; spn: number; enable: boolean; input: number }
+  | { kind: 'ntc'; input: number; preset: number }
+  | { kind: 'pressure'; input: number; preset: number }
+  | { kind: 'tc'; tcType: number };
+
+export interface CommandResult {
+  command: ConfigCommand;
+  ok: boolean;
+  error?: string;
+}
+
+export function emptyConfigState(): ConfigState {
+  return { spns: new Map(), ntcPresets: new Map(), pressurePresets: new Map() };
+}
+
+// The state after `command` has been accepted
+export function applyCommand(state: ConfigState, command: ConfigCommand): void {
+  switch (command.kind) {
+    case 'spn':
+      state.spns.set(command.spn, { enable: command.enable, input: command.enable ? command.input : 0 });
+      break;
+    case 'ntc':
+      state.ntcPresets.set(command.input, command.preset);
+      break;
+    case 'pressure':
+      state.pressurePresets.set(command.input, command.preset);
+      break;
+    case 'tc':
+      state.tcType = command.tcType;
+      break;
+  }
+}
+
+// Profile file layout:
+// {
+//   "thermocoupleType": "K",                      // Name or index into TC_TYPES
+//   "ntcPresets": { "1": "AEM", "2": 1 },         // Input -> name or index
+//   "pressurePresets": { "1": "100 PSI" },        // Input -> name or preset number
+//   "spns": [ { "spn": 110, "input": 1 }, { "spn": 175, "enable": false } ]
+// }
+export function loadProfile(path: string): ConfigState {
+  let json: unknown;
+  try {
+    json = JSON.parse(fs.readFileSync(path, 'utf8'));
+  } catch (err) {
+    throw new Error(`Cannot read profile '${path}': ${(err as Error).message}`);
+  }
+  return parseProfile(json);
+}
+
+export function parseProfile(json: unknown): ConfigState {
+  if (typeof json !== 'object' || json === null || Array.isArray(json)) {
+    throw new Error('Invalid profile: expected a JSON object');
+  }
+  const profile = json as Record<string, unknown>;
+  const state = emptyConfigState();
+
+  if (profile.thermocoupleType !== undefined) {
+    state.tcType = lookup(profile.thermocoupleType, TC_TYPES, 'thermocouple type');
+  }
+
+  for (const [key, value] of entries(profile.ntcPresets, 'ntcPresets')) {
+    const input = inputNumber(key, TEMP_INPUTS, 'ntcPresets');
+    state.ntcPresets.set(input, lookup(value, NTC_PRESETS, `NTC preset for input ${input}`));
+  }
+
+  for (const [key, value] of entries(profile.pressurePresets, 'pressurePresets')) {
+    const input = inputNumber(key, PRESSURE_INPUTS, 'pressurePresets');
+    state.pressurePresets.set(input, pressurePreset(value, input));
+  }
+
+  if (profile.spns !== undefined) {
+    if (!Array.isArray(profile.spns)) throw new Error('Invalid profile: spns must be an array');
+    for (const entry of profile.spns as Record<string, unknown>[]) {
+      const spn = Number(entry?.spn);
+      if (!Number.isInteger(spn) || spn < 1 || spn > 0xFFFF) {
+        throw new Error(`Invalid profile: bad SPN ${JSON.stringify(entry?.spn)}`);
+      }
+      const enable = entry.enable === undefined ? true : entry.enable === true;
+      const input = enable ? Number(entry.input ?? 0) : 0;
+      if (!Number.isInteger(input) || input < 0 || input > TEMP_INPUTS) {
+        throw new Error(`Invalid profile: bad input for SPN ${spn}`);
+      }
+      state.spns.set(spn, { enable, input });
+    }
+  }
+
+  return state;
+}
+
+// The profile file form of `state`, using preset and type names where known
+export function toProfile(state: ConfigState): Record<string, unknown> {
+  const profile: Record<string, unknown> = {};
+  if (state.tcType !== undefined) profile.thermocoupleType = TC_TYPES[state.tcType] ?? state.tcType;
+  profile.ntcPresets = Object.fromEntries(
+    [...state.ntcPresets].sort((a, b) => a[0] - b[0]).map(([input, preset]) => [input, NTC_PRESETS[preset] ?? preset])
+  );
+  profile.pressurePresets = Object.fromEntries(
+    [...state.pressurePresets].sort((a, b) => a[0] - b[0]).map(([input, preset]) => [input, pressurePresetName(preset) ?? preset])
+  );
+  profile.spns = [...state.spns].sort((a, b) => a[0] - b[0]).map(([spn, s]) =>
+    s.enable ? { spn, input: s.input } : { spn, enable: false }
+  );
+  return profile;
+}
+
+// Commands needed to move `current` to `target`. Settings already known to
+// match are skipped; unknown settings are always sent.
+export function planCommands(target: ConfigState, current?: ConfigState): ConfigCommand[] {
+  const commands: ConfigCommand[] = [];
+
+  if (target.tcType !== undefined && target.tcType !== current?.tcType) {
+    commands.push({ kind: 'tc', tcType: target.tcType });
+  }
+  for (const [input, preset] of target.ntcPresets) {
+    if (current?.ntcPresets.get(input) !== preset) commands.push({ kind: 'ntc', input, preset });
+  }
+  for (const [input, preset] of target.pressurePresets) {
+    if (current?.pressurePresets.get(input) !== preset) commands.push({ kind: 'pressure', input, preset });
+  }
+  for (const [spn, setting] of target.spns) {
+    const known = current?.spns.get(spn);
+    if (!known || known.enable !== setting.enable || (setting.enable && known.input !== setting.input)) {
+      commands.push({ kind: 'spn', spn, enable: setting.enable, input: setting.input });
+    }
+  }
+
+  return commands;
+}
+
+export function runCommand(protocol: OssmDevice, cmd: ConfigCommand): Promise<boolean> {
+  switch (cmd.kind) {
+    case 'spn': return protocol.enableSpn(cmd.spn, cmd.enable, cmd.input);
+    case 'ntc': return protocol.setNtcPreset(cmd.input, cmd.preset);
+    case 'pressure': return protocol.setPressurePreset(cmd.input, cmd.preset);
+    case 'tc': return protocol.setThermocoupleType(cmd.tcType);
+  }
+}
+
+// Issue every command at once and let the protocol's queue pipeline them
+export function applyCommands(
+  protocol: OssmDevice,
+  commands: ConfigCommand[],
+  onResult: (result: CommandResult) => void = () => {}
+): Promise<CommandResult[]> {
+  return Promise.all(commands.map(command =>
+    runCommand(protocol, command).then(
+      ok => ({ command, ok }),
+      err => ({ command, ok: false, error: (err as Error).message })
+    ).then(result => {
+      onResult(result);
+      return result;
+    })
+  ));
+}
+
+export function describeCommand(cmd: ConfigCommand): string {
+  switch (cmd.kind) {
+    case 'spn':
+      return cmd.enable ? `SPN ${cmd.spn} enabled on input ${cmd.input}` : `SPN ${cmd.spn} disabled`;
+    case 'ntc':
+      return `Temp input ${cmd.input} NTC preset ${NTC_PRESETS[cmd.preset]}`;
+    case 'pressure':
+      return `Pressure input ${cmd.input} preset ${pressurePresetName(cmd.preset) ?? cmd.preset}`;
+    case 'tc':
+      return `Thermocouple type ${TC_TYPES[cmd.tcType]}`;
+  }
+}
+
+function entries(value: unknown, field: string): [string, unknown][] {
+  if (value === undefined) return [];
+  if (typeof value !== 'object' || value === null || Array.isArray(value)) {
+    throw new Error(`Invalid profile: ${field} must be an object keyed by input number`);
+  }
+  return Object.entries(value);
+}
+
+function inputNumber(key: string, max: number, field: string): number {
+  const input = Number(key);
+  if (!Number.isInteger(input) || input < 1 || input > max) {
+    throw new Error(`Invalid profile: ${field} input must be 1-${max}, got '${key}'`);
+  }
+  return input;
+}
+
+// Accept either an index or a case-insensitive name from `names`
+function lookup(value: unknown, names: string[], what: string): number {
+  if (typeof value === 'number' && Number.isInteger(value) && value >= 0 && value < names.length) {
+    return value;
+  }
+  if (typeof value === 'string') {
+    const index = names.findIndex(n => n.toLowerCase() === value.trim().toLowerCase());
+    if (index >= 0) return index;
+  }
+  throw new Error(`Invalid profile: unknown ${what} ${JSON.stringify(value)}`);
+}
+
+function pressurePreset(value: unknown, input: number): number {
+  if (typeof value === 'number' && pressurePresetName(value) !== undefined && value >= 0) return value;
+  if (typeof value === 'string') {
+    const name = value.trim().toLowerCase();
+    const bar = PRESSURE_PRESETS_BAR.findIndex(n => n.toLowerCase() === name);
+    if (bar >= 0) return bar;
+    const psi = PRESSURE_PRESETS_PSI.findIndex(n => n.toLowerCase() === name);
+    if (psi >= 0) return psi + PSI_PRESET_BASE;
+  }
+  throw new Error(`Invalid profile: unknown pressure preset ${JSON.stringify(value)} for input ${input}`);
+}
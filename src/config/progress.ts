@@ -0,0 +1,5 @@
+// Step-by-step progress of a long device operation (apply, flash, ...)
+export interface ProgressReporter {
+  step(name: string, total?: number): void;
+  advance(count?: number): void;
+}
@@ -0,0 +1,74 @@
+// Full configuration readback over sectioned QUERY responses
+//
+// FIRMWARE CONTRACT PENDING: the section layouts below are this tool's
+// proposal and no released OSSM firmware sends them yet. Until one does,
+// every reply that does not match them exactly means "no readback", and
+// callers fall back to the cache or to sending every setting.
+//
+// A QUERY carrying a section number makes the module return that whole
+// section as one response, sent with the J1939 transport protocol when it
+// does not fit a single frame. Firmware without sectioned queries ignores
+// the section byte and answers with its usual one-frame QUERY reply, which
+// is shorter than any section, so it can never be mistaken for one.
+import { OssmDevice, QUERY_SECTION } from '../protocol/j1939';
+import { ConfigState } from './profile';
+import { PRESSURE_INPUTS, TEMP_INPUTS } from './presets';
+
+// Config section:
+//   [0] status  [1] section (0)  [2] layout version  [3] TC type
+//   [4..11]  NTC preset for temp inputs 1-8 (0xFF = not set)
+//   [12..18] pressure preset for pressure inputs 1-7 (0xFF = not set)
+const CONFIG_LAYOUT_VERSION = 1;
+const CONFIG_SECTION_SIZE = 4 + TEMP_INPUTS + PRESSURE_INPUTS;
+
+// SPN table section:
+//   [0] status  [1] section (1)  [2] entry count
+//   then per entry: SPN (u16, big-endian), enabled (0/1), input
+const SPN_ENTRY_SIZE = 4;
+
+const NOT_SET = 0xFF;
+
+// Decode the config section into `state`; false if the reply is not one
+export function decodeConfigSection(data: Buffer, state: ConfigState): boolean {
+  if (data.length < CONFIG_SECTION_SIZE || data[0] !== 0) return false;
+  if (data[1] !== QUERY_SECTION.CONFIG || data[2] !== CONFIG_LAYOUT_VERSION) return false;
+
+  if (data[3] !== NOT_SET) state.tcType = data[3];
+  for (let i = 0; i < TEMP_INPUTS; i++) {
+    if (data[4 + i] !== NOT_SET) state.ntcPresets.set(i + 1, data[4 + i]);
+  }
+  for (let i = 0; i < PRESSURE_INPUTS; i++) {
+    const at = 4 + TEMP_INPUTS + i;
+    if (data[at] !== NOT_SET) state.pressurePresets.set(i + 1, data[at]);
+  }
+  return true;
+}
+
+// Decode the SPN table into `state`; false if the reply is not one
+export function decodeSpnTable(data: Buffer, state: ConfigState): boolean {
+  if (data.length < 3 || data[0] !== 0 || data[1] !== QUERY_SECTION.SPN_TABLE) return false;
+  const count = data[2];
+  if (data.length < 3 + count * SPN_ENTRY_SIZE) return false;
+
+  for (let i = 0; i < count; i++) {
+    const at = 3 + i * SPN_ENTRY_SIZE;
+    const spn = data.readUInt16BE(at);
+    const enable = data[at + 2] === 1;
+    state.spns.set(spn, { enable, input: enable ? data[at + 3] : 0 });
+  }
+  return true;
+}
+
+// Read the module's full configuration in two transfers. Returns null when
+// the firmware does not support sectioned queries. The SPN table is only
+// asked for once the config section proves the firmware has them, so a
+// legacy module gets a single plain QUERY.
+export async function readDeviceConfig(protocol: OssmDevice): Promise<ConfigState | null> {
+  const state: ConfigState = { spns: new Map(), ntcPresets: new Map(), pressurePresets: new Map() };
+
+  const config = await protocol.querySection(QUERY_SECTION.CONFIG);
+  if (!decodeConfigSection(config, state)) return null;
+  const spnTable = await protocol.querySection(QUERY_SECTION.SPN_TABLE);
+  if (!decodeSpnTable(spnTable, state)) return null;
+  return state;
+}
@@ -0,0 +1,234 @@
+// Staged configuration changes with a single EEPROM save
+//
+//   const tx = model.begin();
+//   tx.setNtcPreset(1, 3).enableSpn(175, true, 1);
+//   await tx.commit();
+//
+// commit() reads the current configuration, sends only the staged settings
+// that differ in one pipelined burst, reads back to check every one took,
+// and only then issues one SAVE. If a setting is rejected or does not
+// verify, the settings already sent are put back to their prior values
+// (or the module is reset, on request) and nothing is saved. Either way
+// the EEPROM still holds the last saved configuration. `apply` commits a
+// whole profile this way; the menu commits each setting with save: false
+// and leaves saving to its own menu entry.
+import type { DeviceModel } from './model';
+import type { ProgressReporter } from './progress';
+import {
+  CommandResult, ConfigCommand, ConfigState, applyCommand, applyCommands, describeCommand,
+  emptyConfigState, planCommands
+} from './profile';
+import { readDeviceConfig } from './readback';
+
+export type RollbackMode =
+  | 'restore'  // Re-send the prior value of every setting sent (default)
+  | 'reset'    // CMD.RESET to factory defaults
+  | 'none';
+
+export interface CommitOptions {
+  verify?: boolean;         // Read back before saving (default true; skipped without readback support)
+  rollback?: RollbackMode;
+  save?: boolean;           // SAVE once verified (default true); false leaves the changes unsaved
+  resend?: boolean;         // Send every staged setting, even those known to be in place
+  progress?: ProgressReporter;
+}
+
+export interface CommitResult {
+  results: CommandResult[];  // One per setting sent; settings already in place are not sent
+  verified: boolean;         // Checked by readback before the save
+}
+
+// A commit that failed; nothing was saved
+export class TransactionError extends Error {
+  readonly results: CommandResult[];
+  readonly rolledBack: boolean;
+
+  constructor(message: string, results: CommandResult[], rolledBack: boolean) {
+    super(message);
+    this.name = 'TransactionError';
+    this.results = results;
+    this.rolledBack = rolledBack;
+  }
+}
+
+export class ConfigTransaction {
+  private readonly model: DeviceModel;
+  private readonly staged = emptyConfigState();  // Later changes to a setting replace earlier ones
+  private state: 'open' | 'committing' | 'closed' = 'open';
+
+  constructor(model: DeviceModel) {
+    this.model = model;
+  }
+
+  get size(): number {
+    return planCommands(this.staged).length;
+  }
+
+  stage(command: ConfigCommand): this {
+    if (this.state !== 'open') throw new Error('Transaction is already committed');
+    applyCommand(this.staged, command);
+    return this;
+  }
+
+  // Every setting of a profile (see loadProfile)
+  stageProfile(profile: ConfigState): this {
+    for (const command of planCommands(profile)) this.stage(command);
+    return this;
+  }
+
+  enableSpn(spn: number, enable: boolean, input: number = 0): this {
+    return this.stage({ kind: 'spn', spn, enable, input });
+  }
+
+  setNtcPreset(input: number, preset: number): this {
+    return this.stage({ kind: 'ntc', input, preset });
+  }
+
+  setPressurePreset(input: number, preset: number): this {
+    return this.stage({ kind: 'pressure', input, preset });
+  }
+
+  setThermocoupleType(tcType: number): this {
+    return this.stage({ kind: 'tc', tcType });
+  }
+
+  // Drop the staged changes without sending anything
+  discard(): void {
+    this.state = 'closed';
+  }
+
+  async commit(options: CommitOptions = {}): Promise<CommitResult> {
+    if (this.state !== 'open') throw new Error('Transaction is already committed');
+    this.state = 'committing';
+    try {
+      return await this.run(options);
+    } finally {
+      this.state = 'closed';
+    }
+  }
+
+  private async run(options: CommitOptions): Promise<CommitResult> {
+    const { progress } = options;
+    const model = this.model;
+
+    progress?.step('reading');
+    await model.loadCached();
+    await model.refresh();
+    const prior = model.state ? copyConfig(model.state) : null;
+    const priorComplete = model.source === 'device';  // A readback lists every configured SPN
+
+    const commands = planCommands(this.staged, options.resend ? undefined : prior ?? undefined);
+    if (commands.length === 0) return { results: [], verified: false };
+
+    progress?.step('applying', commands.length);
+    const results = await applyCommands(model.device, commands, () => progress?.advance());
+    const failed = results.filter(r => !r.ok);
+
+    let problem: string | null = null;
+    let verified = false;
+    if (failed.length > 0) {
+      const first = failed[0];
+      problem = `${failed.length} of ${results.length} settings failed ` +
+        `(first: ${describeCommand(first.command)}${first.error ? `: ${first.error}` : ''})`;
+    } else if (options.verify ?? true) {
+      progress?.step('verifying');
+      const readback = await readDeviceConfig(model.device);
+      if (readback) {
+        const mismatched = planCommands(this.staged, readback);
+        if (mismatched.length > 0) {
+          problem = `${mismatched.length} setting${mismatched.length === 1 ? '' : 's'} did not take ` +
+            `(first: ${describeCommand(mismatched[0])})`;
+        }
+        verified = true;
+      }
+    }
+
+    if (problem !== null) {
+      // A rejected or timed-out setting may still have been applied, so all are undone
+      const rolledBack = await this.rollBack(options.rollback ?? 'restore', prior, priorComplete, commands, progress);
+      model.refresh().catch(() => {});
+      throw new TransactionError(
+        `${problem}, not saved${rolledBack ? ', rolled back' : ', unsaved changes remain until the module restarts'}`,
+        results,
+        rolledBack
+      );
+    }
+
+    model.record(commands);  // Cached once a save succeeds
+    if (options.save ?? true) {
+      progress?.step('saving');
+      if (!(await model.save())) throw new TransactionError('Failed to save configuration', results, false);
+    }
+    return { results, verified };
+  }
+
+  // Undo what was sent, as far as the prior state is known. True only if
+  // every sent setting was put back.
+  private async rollBack(
+    mode: RollbackMode,
+    prior: ConfigState | null,
+    priorComplete: boolean,
+    sent: ConfigCommand[],
+    progress?: ProgressReporter
+  ): Promise<boolean> {
+    if (mode === 'none') return false;
+    progress?.step('rolling back');
+    try {
+      if (mode === 'reset') return await this.model.reset();
+      if (!prior) return false;
+      const { restore, complete } = restoreCommands(prior, priorComplete, sent);
+      const results = await applyCommands(this.model.device, restore);
+      return complete && results.every(r => r.ok);
+    } catch {
+      return false;
+    }
+  }
+}
+
+// Commands putting each sent setting back to its prior value, where that
+// is known. An SPN missing from a complete (read back) prior state was
+// disabled; missing from a cached one, it is unknown.
+function restoreCommands(
+  prior: ConfigState,
+  priorComplete: boolean,
+  sent: ConfigCommand[]
+): { restore: ConfigCommand[]; complete: boolean } {
+  const restore: ConfigCommand[] = [];
+  let complete = true;
+  for (const command of sent) {
+    switch (command.kind) {
+      case 'spn': {
+        const setting = prior.spns.get(command.spn) ?? (priorComplete ? { enable: false, input: 0 } : undefined);
+        if (setting) restore.push({ kind: 'spn', spn: command.spn, ...setting });
+        else complete = false;
+        break;
+      }
+      case 'ntc': {
+        const preset = prior.ntcPresets.get(command.input);
+        if (preset !== undefined) restore.push({ kind: 'ntc', input: command.input, preset });
+        else complete = false;
+        break;
+      }
+      case 'pressure': {
+        const preset = prior.pressurePresets.get(command.input);
+        if (preset !== undefined) restore.push({ kind: 'pressure', input: command.input, preset });
+        else complete = false;
+        break;
+      }
+      case 'tc':
+        if (prior.tcType !== undefined) restore.push({ kind: 'tc', tcType: prior.tcType });
+        else complete = false;
+        break;
+    }
+  }
+  return { restore, complete };
+}
+
+function copyConfig(state: ConfigState): ConfigState {
+  return {
+    spns: new Map([...state.spns].map(([spn, s]) => [spn, { ...s }])),
+    ntcPresets: new Map(state.ntcPresets),
+    pressurePresets: new Map(state.pressurePresets),
+    tcType: state.tcType,
+  };
+}
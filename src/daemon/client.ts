@@ -0,0 +1,176 @@
+// Client handle on a running daemon
+//
+// Implements the same OssmDevice API as J1939Protocol, so the menu and the
+// one-shot commands work unchanged when a daemon owns the bus. Live signals
+// are streamed on first use of getSignalStore().
+import * as net from 'net';
+import { MetricsSnapshot } from '../metrics/metrics';
+import { SIGNAL, SIGNAL_COUNT, SignalName, SignalSource } from '../protocol/decoder';
+import { CommandOptions, OssmDevice } from '../protocol/j1939';
+import { DaemonMethod, LineReader, ServerMessage, SignalsEvent, trustedSocketDir } from './rpc';
+
+interface PendingCall {
+  resolve: (value: unknown) => void;
+  reject: (err: Error) => void;
+}
+
+const CONNECT_TIMEOUT_MS = 500;
+
+// Signals as last streamed by the daemon
+export class DaemonSignals implements SignalSource {
+  readonly values = new Float64Array(SIGNAL_COUNT).fill(NaN);
+  readonly updated = new Float64Array(SIGNAL_COUNT);
+  lastUpdate = 0;
+  private version = 0;
+  private slots: number[] = [];  // Daemon's signal index -> ours (-1 = unknown here)
+
+  setNames(names: string[]): void {
+    this.slots = names.map(name => (Object.hasOwn(SIGNAL, name) ? SIGNAL[name as SignalName] : -1));
+  }
+
+  apply(event: SignalsEvent): void {
+    const slots = this.slots;
+    for (let i = 0; i < slots.length; i++) {
+      const slot = slots[i];
+      if (slot < 0) continue;
+      this.values[slot] = event.values[i] ?? NaN;
+      this.updated[slot] = event.updated[i] ?? 0;
+    }
+    this.lastUpdate = event.lastUpdate;
+    this.version++;
+  }
+
+  sync(): number {
+    return this.version;
+  }
+}
+
+export class DaemonClient implements OssmDevice {
+  private readonly socket: net.Socket;
+  private readonly signals = new DaemonSignals();
+  private readonly pending = new Map<number, PendingCall>();
+  private nextId = 1;
+  private subscribed = false;
+  private closedError: Error | null = null;
+
+  // Resolves once the daemon has said hello; rejects if none is listening
+  static connect(socketPath: string, timeoutMs: number = CONNECT_TIMEOUT_MS): Promise<DaemonClient> {
+    return new Promise((resolve, reject) => {
+      if (!trustedSocketDir(socketPath)) {
+        reject(new Error(`Not connecting to ${socketPath}: its directory belongs to another user`));
+        return;
+      }
+      const socket = net.connect(socketPath);
+      const timer = setTimeout(() => {
+        socket.destroy();
+        reject(new Error(`No daemon answered on ${socketPath}`));
+      }, timeoutMs);
+      socket.once('error', err => {
+        clearTimeout(timer);
+        reject(err);
+      });
+      const client = new DaemonClient(socket, () => {
+        clearTimeout(timer);
+        resolve(client);
+      });
+    });
+  }
+
+  // A client if a daemon is listening on `socketPath`, otherwise null
+  static async find(socketPath: string): Promise<DaemonClient | null> {
+    try {
+      return await DaemonClient.connect(socketPath);
+    } catch {
+      return null;
+    }
+  }
+
+  private constructor(socket: net.Socket, onHello: () => void) {
+    this.socket = socket;
+    const lines = new LineReader();
+    socket.setEncoding('utf8');
+    socket.on('data', (chunk: string) => lines.push(chunk, line => {
+      const message = JSON.parse(line) as ServerMessage;
+      if ('id' in message) {
+        const call = this.pending.get(message.id);
+        if (!call) return;
+        this.pending.delete(message.id);
+        if ('error' in message) call.reject(new Error(message.error));
+        else call.resolve(message.result);
+      } else if (message.event === 'signals') {
+        this.signals.apply(message);
+      } else if (message.event === 'hello') {
+        this.signals.setNames(message.signals);
+        onHello();
+      }
+    }));
+    socket.on('close', () => {
+      this.closedError = new Error('Daemon connection closed');
+      for (const call of this.pending.values()) call.reject(this.closedError);
+      this.pending.clear();
+    });
+    socket.on('error', () => {});  // Surfaced through 'close'
+  }
+
+  close(): void {
+    this.socket.end();
+  }
+
+  getSignalStore(): SignalSource {
+    if (!this.subscribed) {
+      this.subscribed = true;
+      this.call('subscribe', [{ hz: 0 }]).catch(() => {});
+    }
+    return this.signals;
+  }
+
+  enableSpn(spn: number, enable: boolean, input: number = 0, options?: CommandOptions): Promise<boolean> {
+    return this.call('enableSpn', [spn, enable, input, options]) as Promise<boolean>;
+  }
+
+  setNtcPreset(input: number, preset: number, options?: CommandOptions): Promise<boolean> {
+    return this.call('setNtcPreset', [input, preset, options]) as Promise<boolean>;
+  }
+
+  setPressurePreset(input: number, preset: number, options?: CommandOptions): Promise<boolean> {
+    return this.call('setPressurePreset', [input, preset, options]) as Promise<boolean>;
+  }
+
+  setThermocoupleType(tcType: number, options?: CommandOptions): Promise<boolean> {
+    return this.call('setThermocoupleType', [tcType, options]) as Promise<boolean>;
+  }
+
+  async query(options?: CommandOptions): Promise<Buffer> {
+    return Buffer.from(await this.call('query', [options]) as string, 'hex');
+  }
+
+  async querySection(section: number, options?: CommandOptions): Promise<Buffer> {
+    return Buffer.from(await this.call('querySection', [section, options]) as string, 'hex');
+  }
+
+  save(options?: CommandOptions): Promise<boolean> {
+    return this.call('save', [options]) as Promise<boolean>;
+  }
+
+  reset(options?: CommandOptions): Promise<boolean> {
+    return this.call('reset', [options]) as Promise<boolean>;
+  }
+
+  getMetrics(): Promise<MetricsSnapshot> {
+    return this.call('getMetrics', []) as Promise<MetricsSnapshot>;
+  }
+
+  async identify(timeoutMs?: number): Promise<bigint | null> {
+    const name = await this.call('identify', [timeoutMs]) as string | null;
+    return name === null ? null : BigInt(name);
+  }
+
+  private call(method: DaemonMethod, params: unknown[]): Promise<unknown> {
+    if (this.closedError) return Promise.reject(this.closedError);
+    const id = this.nextId++;
+    return new Promise((resolve, reject) => {
+      this.pending.set(id, { resolve, reject });
+      this.socket.write(JSON.stringify({ id, method, params }) + '\n');
+    });
+  }
+}
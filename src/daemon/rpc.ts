@@ -0,0 +1,113 @@
+// Wire format between the daemon and its clients
+//
+// One JSON object per line over a Unix stream socket. Requests carry an id
+// that is echoed on the reply; events have no id and arrive whenever the
+// daemon has something to report:
+//
+//   -> {"id":1,"method":"setNtcPreset","params":[1,3]}
+//   <- {"id":1,"result":true}
+//   -> {"id":2,"method":"subscribe","params":[{"hz":10}]}
+//   <- {"event":"signals","version":812,"lastUpdate":1718000000123456,"values":[...],"updated":[...]}
+//
+// Buffers travel as hex strings and the NAME from identify as "0x..." so
+// replies stay plain JSON. Signal arrays are indexed as in the hello event.
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+import type { DeviceMethod } from '../ingest/rpc';
+import type { Target } from '../provision/station';
+import type { AlarmEvent } from '../rules/engine';
+
+export const DAEMON_PROTOCOL_VERSION = 1;
+
+export type DaemonMethod =
+  | DeviceMethod
+  | 'signals'      // Current values as { name: value }
+  | 'dbc'          // DBC signal values as { "Message.Signal": value } (with --dbc)
+  | 'config'       // Known configuration in profile form, or null
+  | 'refresh'      // Read the configuration from the module now
+  | 'subscribe'    // Start signal events ({ hz } caps the rate; 0 = every batch)
+  | 'unsubscribe'
+  | 'rules'        // Derived values and alarm states (with --rules)
+  | 'acknowledge'; // Acknowledge an alarm by name
+
+export interface Request {
+  id: number;
+  method: DaemonMethod;
+  params?: unknown[];
+}
+
+export type Reply =
+  | { id: number; result: unknown }
+  | { id: number; error: string };
+
+export interface SignalsEvent {
+  event: 'signals';
+  version: number;
+  lastUpdate: number;          // us since the epoch
+  values: (number | null)[];   // null = not seen
+  updated: number[];           // Last sample time per signal (us, 0 = never)
+}
+
+export type DaemonEvent =
+  | { event: 'hello'; protocol: number; target: string; signals: string[] }
+  | SignalsEvent
+  | { event: 'config'; config: Record<string, unknown> | null; source: string | null }
+  | ({ event: 'alarm' } & AlarmEvent);
+
+export type ServerMessage = Reply | DaemonEvent;
+
+// Where the daemon for a target listens unless told otherwise:
+// $XDG_RUNTIME_DIR, or else a directory of our own under the temp dir
+export function defaultSocketPath(target: Target): string {
+  const dir = process.env.XDG_RUNTIME_DIR || fallbackSocketDir();
+  return path.join(dir, `ossm-config-${target.interface}-${target.address.toString(16)}.sock`);
+}
+
+function fallbackSocketDir(): string {
+  return path.join(os.tmpdir(), `ossm-config-${process.getuid?.() ?? os.userInfo().username}`);
+}
+
+// Create the temp-dir fallback owner-only, or refuse one that another user
+// made first (their daemon could then impersonate ours). Other directories
+// are left as they are.
+export function prepareSocketDir(socketPath: string): void {
+  const dir = path.dirname(socketPath);
+  if (dir !== fallbackSocketDir()) return;
+  fs.mkdirSync(dir, { mode: 0o700, recursive: true });
+  if (!trustedSocketDir(socketPath)) throw new Error(`${dir} is not private to this user; pass --socket <path>`);
+}
+
+// False for a temp-dir fallback that is not ours alone
+export function trustedSocketDir(socketPath: string): boolean {
+  const dir = path.dirname(socketPath);
+  if (dir !== fallbackSocketDir()) return true;
+  try {
+    const stat = fs.lstatSync(dir);
+    const mine = process.getuid === undefined || stat.uid === process.getuid();
+    return stat.isDirectory() && mine && (stat.mode & 0o077) === 0;
+  } catch {
+    return true;  // Nothing there to trust or distrust yet
+  }
+}
+
+// Splits a byte stream into lines, keeping any partial line for the next chunk
+export class LineReader {
+  private pending = '';
+
+  push(chunk: string, onLine: (line: string) => void): void {
+    let text = this.pending + chunk;
+    let end: number;
+    while ((end = text.indexOf('\n')) >= 0) {
+      const line = text.slice(0, end);
+      text = text.slice(end + 1);
+      if (line.trim()) onLine(line);
+    }
+    this.pending = text;
+  }
+
+  // Bytes buffered without a newline yet
+  get buffered(): number {
+    return this.pending.length;
+  }
+}
@@ -0,0 +1,451 @@
+// Long-running owner of one device's bus connection
+//
+// Keeps CanBus, J1939Protocol and the DeviceModel alive between uses, so
+// decoded signals and the known configuration are always warm. Clients
+// reach it over a Unix socket (JSON lines, see rpc.ts) or, optionally,
+// HTTP: GET /signals, /dbc, /config, /rules, /metrics and /events (server-sent
+// events), and POST /call/<method> with a JSON array of parameters.
+// Commands from every client share the protocol's one pipelined queue.
+//
+// The socket is created owner-only. HTTP requests must name the daemon's
+// own host (so a DNS-rebound page cannot reach it), and calls must be
+// application/json with no foreign Origin, which a plain cross-site form
+// or fetch cannot send without a preflight the daemon never answers.
+//
+// Signal events are encoded once per received batch and written to each
+// subscriber that is due. A subscriber whose socket is backed up skips
+// events instead of buffering them; the next one carries the latest values.
+// With a rule engine, alarm transitions go to every client as they happen.
+import * as fs from 'fs';
+import * as http from 'http';
+import * as net from 'net';
+import { DeviceModel } from '../config/model';
+import { ConfigCommand, toProfile } from '../config/profile';
+import { Labels, formatPrometheus } from '../metrics/prometheus';
+import { SIGNAL_NAMES } from '../protocol/decoder';
+import { CommandOptions, J1939Protocol } from '../protocol/j1939';
+import { Target, targetName } from '../provision/station';
+import type { AlarmStatus, RuleEngine } from '../rules/engine';
+import {
+  DAEMON_PROTOCOL_VERSION, DaemonEvent, DaemonMethod, LineReader, Reply, Request, prepareSocketDir
+} from './rpc';
+
+export interface DaemonOptions {
+  socketPath: string;
+  httpPort?: number;
+  httpHost?: string;  // Default loopback only; the API can reset the module
+  rules?: RuleEngine;
+}
+
+// A socket or SSE stream receiving signal events
+interface Subscriber {
+  intervalMs: number;   // 0 = every batch
+  lastSent: number;
+  timer: NodeJS.Timeout | null;  // Trailing send for a throttled update
+  write(line: string): void;
+  congested(): boolean;
+}
+
+const MAX_LINE = 64 * 1024;          // Longest request accepted
+const HIGH_WATER = 256 * 1024;       // Skip events past this much unsent output
+const MAX_BODY = 64 * 1024;
+const LOOPBACK_HOSTS = ['127.0.0.1', 'localhost', '[::1]'];
+const WILDCARD_HOSTS = ['0.0.0.0', '::'];
+
+export class DaemonServer {
+  private readonly protocol: J1939Protocol;
+  private readonly model: DeviceModel;
+  private readonly target: Target;
+  private readonly options: DaemonOptions;
+  private readonly sockets = new Set<net.Socket>();
+  private readonly subscribers = new Set<Subscriber>();
+  private readonly streams = new Set<http.ServerResponse>();
+  private readonly cleanup: (() => void)[] = [];
+  private ipc: net.Server | null = null;
+  private http: http.Server | null = null;
+  private publishQueued = false;
+  private signalLine = '';
+  private signalVersion = -1;
+
+  constructor(protocol: J1939Protocol, model: DeviceModel, target: Target, options: DaemonOptions) {
+    this.protocol = protocol;
+    this.model = model;
+    this.target = target;
+    this.options = options;
+  }
+
+  get clients(): number {
+    return this.sockets.size + this.streams.size;
+  }
+
+  async listen(): Promise<void> {
+    prepareSocketDir(this.options.socketPath);
+    await removeStaleSocket(this.options.socketPath);
+    this.ipc = net.createServer(socket => this.accept(socket));
+    // Owner-only from the moment it exists, not after a chmod
+    const umask = process.umask(0o177);
+    try {
+      await new Promise<void>((resolve, reject) => {
+        this.ipc!.once('error', reject);
+        this.ipc!.listen(this.options.socketPath, () => resolve());
+      });
+    } finally {
+      process.umask(umask);
+    }
+
+    if (this.options.httpPort !== undefined) {
+      this.http = http.createServer((req, res) => this.handleHttp(req, res));
+      await new Promise<void>((resolve, reject) => {
+        this.http!.once('error', reject);
+        this.http!.listen(this.options.httpPort, this.options.httpHost ?? '127.0.0.1', () => resolve());
+      });
+    }
+
+    // Every frame of a batch is decoded synchronously, so a microtask runs
+    // once after the whole batch
+    this.cleanup.push(this.protocol.onSensorData(() => {
+      if (this.publishQueued || this.subscribers.size === 0) return;
+      this.publishQueued = true;
+      queueMicrotask(() => {
+        this.publishQueued = false;
+        this.publish();
+      });
+    }));
+    this.cleanup.push(this.model.onChange(() => this.broadcast(this.configEvent())));
+
+    const rules = this.options.rules;
+    if (rules) {
+      this.cleanup.push(rules.onAlarm(event => this.broadcast({ event: 'alarm', ...event })));
+      this.cleanup.push(rules.attach(this.protocol));
+    }
+  }
+
+  async close(): Promise<void> {
+    for (const off of this.cleanup.splice(0)) off();
+    for (const sub of this.subscribers) if (sub.timer) clearTimeout(sub.timer);
+    this.subscribers.clear();
+    for (const socket of this.sockets) socket.destroy();
+    for (const res of this.streams) res.end();
+    await Promise.all([this.ipc, this.http].map(server => server && new Promise(resolve => server.close(resolve))));
+    fs.rmSync(this.options.socketPath, { force: true });
+  }
+
+  private accept(socket: net.Socket): void {
+    this.sockets.add(socket);
+    socket.setEncoding('utf8');
+    const lines = new LineReader();
+    let sub: Subscriber | null = null;
+
+    const send = (message: Reply | DaemonEvent) => {
+      if (!socket.destroyed) socket.write(JSON.stringify(message) + '\n');
+    };
+    const unsubscribe = () => {
+      if (!sub) return;
+      if (sub.timer) clearTimeout(sub.timer);
+      this.subscribers.delete(sub);
+      sub = null;
+    };
+
+    socket.on('data', (chunk: string) => {
+      lines.push(chunk, line => {
+        let request: Request;
+        try {
+          request = JSON.parse(line);
+        } catch {
+          send({ id: 0, error: 'Malformed request' });
+          return;
+        }
+        if (request.method === 'subscribe') {
+          unsubscribe();
+          sub = this.subscribe(rateOf(request.params?.[0]), data => socket.write(data),
+            () => socket.writableLength > HIGH_WATER);
+          send({ id: request.id, result: true });
+          return;
+        }
+        if (request.method === 'unsubscribe') {
+          unsubscribe();
+          send({ id: request.id, result: true });
+          return;
+        }
+        this.call(request.method, request.params ?? []).then(
+          result => send({ id: request.id, result }),
+          err => send({ id: request.id, error: (err as Error).message })
+        );
+      });
+      if (lines.buffered > MAX_LINE) socket.destroy();
+    });
+    socket.on('error', () => {});
+    socket.on('close', () => {
+      unsubscribe();
+      this.sockets.delete(socket);
+    });
+
+    send({ event: 'hello', protocol: DAEMON_PROTOCOL_VERSION, target: targetName(this.target), signals: SIGNAL_NAMES });
+    send(this.configEvent());
+  }
+
+  private async call(method: DaemonMethod, params: unknown[]): Promise<unknown> {
+    const protocol = this.protocol;
+    switch (method) {
+      case 'enableSpn':
+        return this.setting({ kind: 'spn', spn: num(params, 0), enable: params[1] === true, input: num(params, 2, 0) }, params[3]);
+      case 'setNtcPreset':
+        return this.setting({ kind: 'ntc', input: num(params, 0), preset: num(params, 1) }, params[2]);
+      case 'setPressurePreset':
+        return this.setting({ kind: 'pressure', input: num(params, 0), preset: num(params, 1) }, params[2]);
+      case 'setThermocoupleType':
+        return this.setting({ kind: 'tc', tcType: num(params, 0) }, params[1]);
+      case 'query':
+        return (await protocol.query(options(params[0]))).toString('hex');
+      case 'querySection':
+        return (await protocol.querySection(num(params, 0), options(params[1]))).toString('hex');
+      case 'save':
+        return this.model.save(options(params[0]));
+      case 'reset':
+        return this.model.reset();
+      case 'identify': {
+        const name = await protocol.identify(params[0] == null ? undefined : num(params, 0));
+        return name === null ? null : `0x${name.toString(16)}`;
+      }
+      case 'getMetrics':
+        return protocol.getMetrics();
+      case 'signals':
+        return protocol.getSignalStore().snapshot();
+      case 'dbc':
+        return protocol.getDbc()?.snapshot() ?? null;
+      case 'config':
+        return this.configEvent().config;
+      case 'refresh': {
+        const config = await this.model.refresh();
+        return config ? toProfile(config) : null;
+      }
+      case 'rules':
+        return this.rulesState();
+      case 'acknowledge':
+        if (typeof params[0] !== 'string') throw new Error('Parameter 1 must be an alarm name');
+        return this.rules().acknowledge(params[0]);
+      default:
+        throw new Error(`Unknown method '${method}'`);
+    }
+  }
+
+  // Settings go to the module directly (so command options apply) and are
+  // folded into the model once accepted
+  private async setting(command: ConfigCommand, opts: unknown): Promise<boolean> {
+    const protocol = this.protocol;
+    const o = options(opts);
+    let ok: boolean;
+    switch (command.kind) {
+      case 'spn': ok = await protocol.enableSpn(command.spn, command.enable, command.input, o); break;
+      case 'ntc': ok = await protocol.setNtcPreset(command.input, command.preset, o); break;
+      case 'pressure': ok = await protocol.setPressurePreset(command.input, command.preset, o); break;
+      case 'tc': ok = await protocol.setThermocoupleType(command.tcType, o); break;
+    }
+    if (ok) this.model.record([command]);
+    return ok;
+  }
+
+  private subscribe(intervalMs: number, write: (line: string) => void, congested: () => boolean): Subscriber {
+    const sub: Subscriber = { intervalMs, lastSent: 0, timer: null, write, congested };
+    this.subscribers.add(sub);
+    this.deliver(sub, Date.now());  // Current values straight away
+    return sub;
+  }
+
+  private publish(): void {
+    const now = Date.now();
+    for (const sub of this.subscribers) this.deliver(sub, now);
+  }
+
+  private deliver(sub: Subscriber, now: number): void {
+    if (sub.timer) return;  // A trailing send is already due
+    const wait = sub.lastSent + sub.intervalMs - now;
+    if (wait > 0) {
+      sub.timer = setTimeout(() => {
+        sub.timer = null;
+        if (this.subscribers.has(sub)) this.deliver(sub, Date.now());
+      }, wait);
+      return;
+    }
+    if (sub.congested()) return;
+    sub.lastSent = now;
+    sub.write(this.signalsLine());
+  }
+
+  // The current signals event, encoded once per store version
+  private signalsLine(): string {
+    const store = this.protocol.getSignalStore();
+    if (store.version !== this.signalVersion) {
+      // JSON turns NaN (not seen) into null
+      this.signalLine = JSON.stringify({
+        event: 'signals',
+        version: store.version,
+        lastUpdate: store.lastUpdate,
+        values: Array.from(store.values),
+        updated: Array.from(store.updated),
+      }) + '\n';
+      this.signalVersion = store.version;
+    }
+    return this.signalLine;
+  }
+  private rules(): RuleEngine {
+    if (!this.options.rules) throw new Error('The daemon was started without --rules');
+    return this.options.rules;
+  }
+
+  private rulesState(): { derived: Record<string, number>; alarms: AlarmStatus[] } {
+    const rules = this.rules();
+    return { derived: rules.snapshot(), alarms: rules.alarms() };
+  }
+
+  private configEvent(): Extract<DaemonEvent, { event: 'config' }> {
+    const state = this.model.state;
+    return { event: 'config', config: state ? toProfile(state) : null, source: this.model.source };
+  }
+
+  // Loopback names on our port, or the address given to listen on. Any
+  // name is accepted when listening on every interface.
+  private allowedHost(host: string | undefined): boolean {
+    if (host === undefined) return false;
+    const bound = this.options.httpHost ?? '127.0.0.1';
+    if (WILDCARD_HOSTS.includes(bound)) return true;
+    const names = [...LOOPBACK_HOSTS, bound.includes(':') ? `[${bound}]` : bound];
+    return names.some(name => host === `${name}:${this.options.httpPort}`);
+  }
+
+  private broadcast(event: DaemonEvent): void {
+    const line = JSON.stringify(event) + '\n';
+    for (const socket of this.sockets) if (!socket.destroyed) socket.write(line);
+    for (const res of this.streams) res.write(`event: ${event.event}\ndata: ${line}\n`);
+  }
+
+  private handleHttp(req: http.IncomingMessage, res: http.ServerResponse): void {
+    const url = new URL(req.url ?? '/', 'http://localhost');
+    const json = (status: number, body: unknown) => {
+      res.writeHead(status, { 'Content-Type': 'application/json' }).end(JSON.stringify(body) + '\n');
+    };
+
+    if (!this.allowedHost(req.headers.host)) {
+      json(403, { error: 'Unexpected Host header' });
+      return;
+    }
+
+    if (req.method === 'POST' && url.pathname.startsWith('/call/')) {
+      const origin = req.headers.origin;
+      if (origin !== undefined && origin !== `http://${req.headers.host}`) {
+        json(403, { error: 'Cross-origin calls are not allowed' });
+        return;
+      }
+      if (req.headers['content-type']?.split(';')[0].trim().toLowerCase() !== 'application/json') {
+        json(415, { error: 'Calls must be sent as application/json' });
+        return;
+      }
+      const method = url.pathname.slice('/call/'.length) as DaemonMethod;
+      if (method === 'subscribe' || method === 'unsubscribe') {
+        json(404, { error: 'Use GET /events to stream signals' });
+        return;
+      }
+      readBody(req).then(body => {
+        const params = body.trim() ? JSON.parse(body) : [];
+        if (!Array.isArray(params)) throw new Error('Body must be a JSON array of parameters');
+        return this.call(method, params);
+      }).then(result => json(200, { result }), err => json(400, { error: (err as Error).message }));
+      return;
+    }
+
+    if (req.method !== 'GET') {
+      res.writeHead(405).end();
+      return;
+    }
+    switch (url.pathname) {
+      case '/signals':
+        json(200, this.protocol.getSignalStore().snapshot());
+        break;
+      case '/dbc': {
+        const dbc = this.protocol.getDbc();
+        if (dbc) json(200, dbc.snapshot());
+        else res.writeHead(404).end();
+        break;
+      }
+      case '/config':
+        json(200, this.configEvent());
+        break;
+      case '/rules':
+        if (this.options.rules) json(200, this.rulesState());
+        else res.writeHead(404).end();
+        break;
+      case '/metrics': {
+        const labels: Labels = { interface: this.target.interface, address: `0x${this.target.address.toString(16)}` };
+        res.writeHead(200, { 'Content-Type': 'text/plain; version=0.0.4' })
+          .end(formatPrometheus(this.protocol.getMetrics(), labels));
+        break;
+      }
+      case '/events':
+        this.stream(rateOf({ hz: url.searchParams.get('hz') }), res);
+        break;
+      default:
+        res.writeHead(404).end();
+    }
+  }
+
+  // Server-sent events: signals at the requested rate, config on change
+  private stream(intervalMs: number, res: http.ServerResponse): void {
+    res.writeHead(200, { 'Content-Type': 'text/event-stream', 'Cache-Control': 'no-cache', Connection: 'keep-alive' });
+    this.streams.add(res);
+    res.write(`event: config\ndata: ${JSON.stringify(this.configEvent())}\n\n`);
+    const sub = this.subscribe(intervalMs, line => res.write(`event: signals\ndata: ${line}\n`),
+      () => res.writableLength > HIGH_WATER);
+    res.on('close', () => {
+      if (sub.timer) clearTimeout(sub.timer);
+      this.subscribers.delete(sub);
+      this.streams.delete(res);
+    });
+  }
+}
+
+// A socket file left by a daemon that died; refuse if one is still running
+async function removeStaleSocket(socketPath: string): Promise<void> {
+  if (!fs.existsSync(socketPath)) return;
+  const alive = await new Promise<boolean>(resolve => {
+    const probe = net.connect(socketPath);
+    probe.once('connect', () => {
+      probe.destroy();
+      resolve(true);
+    });
+    probe.once('error', () => resolve(false));
+  });
+  if (alive) throw new Error(`A daemon is already listening on ${socketPath}`);
+  fs.rmSync(socketPath, { force: true });
+}
+
+// { hz } as a minimum interval in ms (0 = every batch)
+function rateOf(value: unknown): number {
+  const hz = Number((value as { hz?: unknown } | undefined)?.hz ?? 0);
+  return hz > 0 ? 1000 / hz : 0;
+}
+
+function num(params: unknown[], i: number, fallback?: number): number {
+  const value = params[i] ?? fallback;
+  if (typeof value !== 'number' || !Number.isInteger(value)) throw new Error(`Parameter ${i + 1} must be an integer`);
+  return value;
+}
+
+function options(value: unknown): CommandOptions | undefined {
+  return value !== null && typeof value === 'object' ? value as CommandOptions : undefined;
+}
+
+function readBody(req: http.IncomingMessage): Promise<string> {
+  return new Promise((resolve, reject) => {
+    let body = '';
+    req.setEncoding('utf8');
+    req.on('data', chunk => {
+      body += chunk;
+      if (body.length > MAX_BODY) {
+        reject(new Error('Request body too large'));
+        req.destroy();
+      }
+    });
+    req.on('end', () => resolve(body));
+    req.on('error', reject);
+  });
+}
@@ -1,36 +1,545 @@
 #!/usr/bin/env node
 // OSSM Config - Configuration tool for Open Source Sensor Module
+//
+// Only what the chosen command needs is loaded: the menu, worker client,
+// capture writer and metrics server are imported on demand, so scripted
+// runs never pay for readline or the UI.
+import './compile-cache';
 import { CanBus } from './can/socketcan';
-import { J1939Protocol } from './protocol/j1939';
-import { Menu } from './ui/menu';
+import { J1939Protocol, OSSM_SOURCE_ADDRESS } from './protocol/j1939';
+import type { CaptureFormat } from './capture/writer';
+import { DEVICE_COMMANDS, runDeviceCommand } from './cli/commands';
+import { DeviceCache } from './config/cache';
+import { loadProfile } from './config/profile';
+import type { MetricsSnapshot } from './metrics/metrics';
+import type { DbcDecoder } from './protocol/dbc';
+import { decodeName, formatName } from './protocol/address-claim';
+import { DeviceProgress, Station, Target, parseTarget, targetName } from './provision/station';
 
-function parseArgs(): { interface: string } {
+interface Options {
+  interface: string;
+  command: string | null;  // null = interactive menu
+  args: string[];
+  targets: Target[];       // Empty = the default OSSM on `interface`
+  pipelineDepth?: number;
+  worker: boolean;         // Run CAN ingest on a worker thread (menu only)
+  cache: boolean;          // Use the on-disk config cache
+  metricsPort?: number;    // Serve Prometheus metrics (menu only)
+  log?: { path: string; format: CaptureFormat; rotateMb: number };
+  record?: { path: string; hz: number; onChange: boolean };
+  dbc?: string;            // DBC file of extra messages to decode (scan, daemon, menu)
+  dbcAnySource: boolean;   // Match DBC messages from every source address
+  daemon: boolean;         // Go through a running daemon when there is one
+  socket?: string;         // Daemon socket (default per target)
+  httpPort?: number;       // Daemon HTTP API
+  rules?: string;          // Derived signals and alarms (watch, daemon)
+  bitrate?: number;        // For the bus load figure
+}
+
+function parseArgs(): Options {
   const args = process.argv.slice(2);
   let canInterface = 'can0';
+  let pipelineDepth: number | undefined;
+  const targets: Target[] = [];
+  const positional: string[] = [];
+  let logPath: string | undefined;
+  let logFormat: CaptureFormat = 'bin';
+  let rotateMb = 0;
+  let worker = true;
+  let cache = true;
+  let metricsPort: number | undefined;
+  let recordPath: string | undefined;
+  let recordHz = 10;
+  let recordOnChange = false;
+  let dbc: string | undefined;
+  let dbcAnySource = false;
+  let daemon = true;
+  let socket: string | undefined;
+  let httpPort: number | undefined;
+  let rules: string | undefined;
+  let bitrate: number | undefined;
 
   for (let i = 0; i < args.length; i++) {
     if ((args[i] === '-i' || args[i] === '--interface') && args[i + 1]) {
       canInterface = args[i + 1];
       i++;
+    } else if ((args[i] === '-t' || args[i] === '--target') && args[i + 1]) {
+      try {
+        targets.push(parseTarget(args[i + 1]));
+      } catch (err) {
+        console.error((err as Error).message);
+        process.exit(2);
+      }
+      i++;
+    } else if (args[i] === '--pipeline' && args[i + 1]) {
+      pipelineDepth = parseInt(args[i + 1], 10);
+      if (isNaN(pipelineDepth) || pipelineDepth < 1) {
+        console.error('--pipeline must be a positive number');
+        process.exit(2);
+      }
+      i++;
+    } else if (args[i] === '--log' && args[i + 1]) {
+      logPath = args[i + 1];
+      i++;
+    } else if (args[i] === '--log-format' && args[i + 1]) {
+      if (args[i + 1] !== 'bin' && args[i + 1] !== 'candump') {
+        console.error('--log-format must be bin or candump');
+        process.exit(2);
+      }
+      logFormat = args[i + 1] as CaptureFormat;
+      i++;
+    } else if (args[i] === '--log-rotate' && args[i + 1]) {
+      rotateMb = parseFloat(args[i + 1]);
+      if (isNaN(rotateMb) || rotateMb <= 0) {
+        console.error('--log-rotate must be a size in MB');
+        process.exit(2);
+      }
+      i++;
+    } else if (args[i] === '--metrics-port' && args[i + 1]) {
+      metricsPort = parseInt(args[i + 1], 10);
+      if (isNaN(metricsPort) || metricsPort < 1 || metricsPort > 65535) {
+        console.error('--metrics-port must be a TCP port number');
+        process.exit(2);
+      }
+      i++;
+    } else if (args[i] === '--record' && args[i + 1]) {
+      recordPath = args[i + 1];
+      i++;
+    } else if (args[i] === '--record-hz' && args[i + 1]) {
+      recordHz = Number(args[i + 1]);
+      if (!(recordHz > 0 && recordHz <= 1000)) {
+        console.error('--record-hz must be a rate between 0 and 1000');
+        process.exit(2);
+      }
+      i++;
+    } else if (args[i] === '--record-on-change') {
+      recordOnChange = true;
+    } else if (args[i] === '--dbc' && args[i + 1]) {
+      dbc = args[i + 1];
+      i++;
+    } else if (args[i] === '--dbc-any-source') {
+      dbcAnySource = true;
+    } else if (args[i] === '--rules' && args[i + 1]) {
+      rules = args[i + 1];
+      i++;
+    } else if (args[i] === '--socket' && args[i + 1]) {
+      socket = args[i + 1];
+      i++;
+    } else if (args[i] === '--http-port' && args[i + 1]) {
+      httpPort = parseInt(args[i + 1], 10);
+      if (isNaN(httpPort) || httpPort < 1 || httpPort > 65535) {
+        console.error('--http-port must be a TCP port number');
+        process.exit(2);
+      }
+      i++;
+    } else if (args[i] === '--bitrate' && args[i + 1]) {
+      bitrate = parseInt(args[i + 1], 10);
+      if (isNaN(bitrate) || bitrate < 10000 || bitrate > 1000000) {
+        console.error('--bitrate must be a CAN bitrate in bit/s (e.g. 500000)');
+        process.exit(2);
+      }
+      i++;
+    } else if (args[i] === '--no-daemon') {
+      daemon = false;
+    } else if (args[i] === '--no-worker') {
+      worker = false;
+    } else if (args[i] === '--no-cache') {
+      cache = false;
     } else if (args[i] === '-h' || args[i] === '--help') {
       console.log('OSSM Config - Configuration tool for Open Source Sensor Module\n');
-      console.log('Usage: ossm-config [options]\n');
+      console.log('Usage: ossm-config [options] [command]\n');
+      console.log('Commands:');
+      console.log('  apply <profile.json>    Apply a configuration profile and save to EEPROM');
+      console.log('  scan                    List the J1939 nodes on the bus (address claim)');
+      console.log('  query                   Print the configuration as JSON');
+      console.log('  enable <spn> [input]    Enable an SPN (input 0 = BME280)');
+      console.log('  disable <spn>           Disable an SPN');
+      console.log('  ntc <input> <preset>    Set an NTC preset (name or number)');
+      console.log('  pressure <input> <preset>  Set a pressure preset (name or number)');
+      console.log('  tc <type>               Set the thermocouple type');
+      console.log('  save | reset            Save to EEPROM / reset to defaults');
+      console.log('  daemon                  Keep the bus open and serve clients until Ctrl-C');
+      console.log('  flash <image.bin>       Update the firmware over CAN (needs the OSSM bootloader)');
+      console.log('  watch                   Print stale PGNs (and --rules alarms) as JSON lines until Ctrl-C');
+      console.log('  (none)                  Interactive menu\n');
       console.log('Options:');
       console.log('  -i, --interface <name>  CAN interface name (default: can0)');
+      console.log('  -t, --target <if[:sa]>  Device to provision, repeatable (e.g. can1:0x96)');
+      console.log('  --pipeline <n>          Max commands in flight (default: 4)');
+      console.log('  --log <file>            Capture raw frames to <file> until Ctrl-C (no menu)');
+      console.log('  --log-format <fmt>      bin (default) or candump');
+      console.log('  --log-rotate <MB>       Start a new capture file past this size');
+      console.log('  --record <file>         Record decoded signals to <file> until Ctrl-C (no menu)');
+      console.log('  --record-hz <n>         Recording rate (default: 10)');
+      console.log('  --record-on-change      Record a row per change of any sensor value instead');
+      console.log('  --dbc <file>            Also decode the messages of a DBC file (scan, daemon, menu)');
+      console.log('  --dbc-any-source        Match DBC messages from any source address');
+      console.log('  --rules <file>          Derived signals and alarms to evaluate (watch, daemon)');
+      console.log('  --socket <path>         Daemon socket (default: $XDG_RUNTIME_DIR, per target)');
+      console.log('  --http-port <port>      Daemon HTTP API on http://127.0.0.1:<port>');
+      console.log('  --bitrate <bit/s>       Bus bitrate, for the bus load figure (default: 250000)');
+      console.log('  --no-daemon             Open the bus even if a daemon is serving the target');
+      console.log('  --no-worker             Handle CAN traffic on the UI thread');
+      console.log('  --no-cache              Ignore the cached device configuration');
+      console.log('  --metrics-port <port>   Serve Prometheus metrics on http://<host>:<port>/metrics');
       console.log('  -h, --help              Show this help message');
       process.exit(0);
+    } else {
+      positional.push(args[i]);
     }
   }
 
-  return { interface: canInterface };
+  return {
+    interface: canInterface,
+    command: positional[0] ?? null,
+    args: positional.slice(1),
+    targets,
+    pipelineDepth,
+    worker,
+    cache,
+    metricsPort,
+    log: logPath ? { path: logPath, format: logFormat, rotateMb } : undefined,
+    record: recordPath ? { path: recordPath, hz: recordHz, onChange: recordOnChange } : undefined,
+    dbc,
+    dbcAnySource,
+    daemon,
+    socket,
+    httpPort,
+    rules,
+    bitrate
+  };
 }
 
+// Non-interactive: push a profile to every target, one pipelined burst and
+// a single save per device
+async function runApply(config: Options): Promise<number> {
+  const profilePath = config.args[0];
+  if (!profilePath) {
+    console.error('Usage: ossm-config apply <profile.json> [-t <if[:sa]> ...]');
+    return 2;
+  }
+  const profile = loadProfile(profilePath);
+  const { DeviceModel } = await import('./config/model');
+
+  const station = new Station(defaultTargets(config), { pipelineDepth: config.pipelineDepth });
+  station.open();
+
+  const report = (p: DeviceProgress) => {
+    const name = targetName(p.target);
+    if (p.state === 'failed') console.error(`[${name}] FAILED: ${p.error}`);
+    else if (p.state === 'done') console.log(`[${name}] OK in ${p.elapsedMs} ms`);
+    else console.log(`[${name}] ${p.step}${p.total ? ` ${p.total} settings` : ''}`);
+  };
+
+  try {
+    const results = await station.run(async (protocol, progress, target) => {
+      const tx = new DeviceModel(protocol, deviceCache(config, target)).begin();
+      await tx.stageProfile(profile).commit({ progress });
+    }, report);
+    const failed = results.filter(r => r.state !== 'done').length;
+    if (results.length > 1) console.log(`${results.length - failed} of ${results.length} devices configured`);
+    return failed > 0 ? 1 : 0;
+  } finally {
+    station.close();
+  }
+}
+
+// Firmware update on every target; interfaces are flashed in parallel
+async function runFlash(config: Options): Promise<number> {
+  const imagePath = config.args[0];
+  if (!imagePath) {
+    console.error('Usage: ossm-config flash <image.bin> [-t <if[:sa]> ...]');
+    return 2;
+  }
+  const { flashFirmware } = await import('./provision/firmware');
+
+  const station = new Station(defaultTargets(config), { pipelineDepth: config.pipelineDepth });
+  station.open();
+
+  const report = (p: DeviceProgress) => {
+    const name = targetName(p.target);
+    if (p.state === 'failed') console.error(`[${name}] FAILED: ${p.error}`);
+    else if (p.state === 'done') console.log(`[${name}] OK in ${p.elapsedMs} ms`);
+    else console.log(`[${name}] ${p.step}${p.total ? ` ${p.total} blocks` : ''}`);
+  };
+
+  try {
+    const results = await station.run(async (protocol, progress, target) => {
+      const result = await flashFirmware(protocol, imagePath, { progress });
+      const rate = result.bytes / Math.max(1, result.elapsedMs);
+      console.log(
+        `[${targetName(target)}] ${result.bytes} bytes, CRC-32 ${result.crc.toString(16).padStart(8, '0')}, ` +
+        `${rate.toFixed(1)} kB/s`
+      );
+    }, report, { probe: false, exclusive: false });  // Bootloaders may not answer QUERY; every step is addressed
+    const failed = results.filter(r => r.state !== 'done').length;
+    if (results.length > 1) console.log(`${results.length - failed} of ${results.length} devices flashed`);
+    return failed > 0 ? 1 : 0;
+  } finally {
+    station.close();
+  }
+}
+
+// Request address claims and list every node that answers, with the
+// sensor values it broadcast while we listened (and any --dbc signals)
+async function runScan(config: Options): Promise<number> {
+  const dbc = await loadDbc(config);
+  const can = new CanBus(config.interface);
+  can.connect();
+  const protocol = new J1939Protocol(can, { discover: true, dbc });
+
+  await new Promise(resolve => setTimeout(resolve, SCAN_MS));
+  const nodes = protocol.getNodes().filter(node => node.name !== null);
+  protocol.close();
+  can.disconnect();
+
+  if (nodes.length === 0) console.log(`No nodes answered on ${config.interface}`);
+  for (const node of nodes) {
+    const fields = decodeName(node.name!);
+    const signals = Object.keys(node.signals.snapshot()).length;
+    console.log(
+      `0x${node.address.toString(16).padStart(2, '0')}  NAME ${formatName(node.name!)}` +
+      `  manufacturer ${fields.manufacturerCode}  function ${fields.function}` +
+      (signals ? `  ${signals} signals` : '')
+    );
+  }
+
+  let decoded = 0;
+  dbc?.slots.forEach((slot, i) => {
+    const value = dbc.values[i];
+    if (Number.isNaN(value)) return;
+    decoded++;
+    console.log(`${slot.name} = ${value}${slot.unit ? ` ${slot.unit}` : ''}`);
+  });
+  return nodes.length > 0 || decoded > 0 ? 0 : 1;
+}
+
+const SCAN_MS = 1000;
+
+// Headless capture: every frame on the bus, straight to disk
+async function runCapture(config: Options): Promise<number> {
+  const log = config.log!;
+  const { CaptureWriter } = await import('./capture/writer');
+  const can = new CanBus(config.interface, { batchSize: 256, maxLatencyMs: 20 });
+  const writer = new CaptureWriter(log.path, {
+    format: log.format,
+    interfaceName: config.interface,
+    rotateBytes: log.rotateMb * 1024 * 1024
+  });
+
+  can.onBatch(batch => writer.writeBatch(batch));
+  can.connect();
+  console.error(`Capturing ${config.interface} to ${log.path} (${log.format}), Ctrl-C to stop`);
+
+  await new Promise<void>(resolve => process.once('SIGINT', () => resolve()));
+  can.disconnect();
+  await writer.close();
+
+  const stats = writer.getStats();
+  console.error(
+    `\n${stats.frames} frames, ${stats.bytes} bytes in ${stats.files} file(s)` +
+    (stats.dropped ? `, ${stats.dropped} dropped` : '')
+  );
+  return stats.dropped ? 1 : 0;
+}
+
+// Headless signal recording: decoded values of the target, sampled at a
+// fixed rate or on every sensor frame, into a columnar file
+async function runRecord(config: Options): Promise<number> {
+  const record = config.record!;
+  const target = defaultTargets(config)[0];
+  const { SignalRecorder } = await import('./capture/signal-recorder');
+  const can = new CanBus(target.interface, { bitrate: config.bitrate });
+  can.connect();
+  const protocol = new J1939Protocol(can, { address: target.address });
+  const store = protocol.getSignalStore();
+  const recorder = new SignalRecorder(record.path, store, { intervalMs: record.onChange ? 0 : 1000 / record.hz });
+
+  if (record.onChange) protocol.onSensorData(() => recorder.sample(store.lastUpdate));
+  else recorder.start();
+  console.error(
+    `Recording ${targetName(target)} to ${record.path} ` +
+    `(${record.onChange ? 'on change' : `${record.hz} Hz`}), Ctrl-C to stop`
+  );
+
+  await new Promise<void>(resolve => process.once('SIGINT', () => resolve()));
+  protocol.close();
+  can.disconnect();
+  await recorder.close();
+
+  const stats = recorder.getStats();
+  console.error(`\n${stats.rows} rows, ${stats.bytes} bytes in ${stats.groups} row group(s)`);
+  return 0;
+}
+
+// Headless monitor: PGNs of the target that stop (or resume) arriving
+// and, with --rules, alarm transitions, each printed as one JSON line
+async function runWatch(config: Options): Promise<number> {
+  const target = defaultTargets(config)[0];
+  const rules = config.rules ? (await import('./rules/engine')).RuleEngine.load(config.rules) : undefined;
+  const can = new CanBus(target.interface, { bitrate: config.bitrate });
+  can.connect();
+  const protocol = new J1939Protocol(can, { address: target.address });
+
+  let raised = 0;
+  let detach = () => {};
+  if (rules) {
+    rules.onAlarm(event => {
+      if (event.kind === 'raised') raised++;
+      console.log(JSON.stringify({ ...event, derived: rules.snapshot() }));
+    });
+    detach = rules.attach(protocol);
+  }
+  const stopStale = protocol.onStale(health => {
+    if (health.address !== target.address) return;
+    console.log(JSON.stringify({ kind: health.stale ? 'stale' : 'resumed', ...health }));
+  });
+  console.error(`Watching ${targetName(target)}${rules ? ` with ${config.rules}` : ''}, Ctrl-C to stop`);
+
+  await new Promise<void>(resolve => process.once('SIGINT', () => resolve()));
+  const { bus, pgns } = protocol.getMetrics();
+  detach();
+  stopStale();
+  protocol.close();
+  can.disconnect();
+
+  const stale = pgns.filter(h => h.stale).length;
+  const missed = pgns.reduce((sum, h) => sum + h.missed, 0);
+  console.error(
+    `\n${pgns.length} PGN(s), ${stale} stale, ${missed} missed frame(s)` +
+    (bus.busLoad ? `, bus load ${bus.busLoad.toFixed(1)}%` : '')
+  );
+  if (rules) {
+    const active = rules.alarms().filter(a => a.state === 'active' || a.state === 'latched');
+    console.error(`${raised} alarm(s) raised, ${active.length} still active`);
+  }
+  return 0;
+}
+
+// Long-running: one bus connection and warm decoded state, shared by
+// every client of the socket and HTTP API
+async function runDaemon(config: Options): Promise<number> {
+  if (config.targets.length > 1) {
+    console.error('A daemon serves a single target');
+    return 2;
+  }
+  const target = defaultTargets(config)[0];
+  const [{ DaemonServer }, { DeviceModel }, { defaultSocketPath }] = await Promise.all([
+    import('./daemon/server'), import('./config/model'), import('./daemon/rpc')
+  ]);
+  const dbc = await loadDbc(config);
+  const rules = config.rules ? (await import('./rules/engine')).RuleEngine.load(config.rules) : undefined;
+  const socketPath = config.socket ?? defaultSocketPath(target);
+
+  const can = new CanBus(target.interface, { bitrate: config.bitrate });
+  can.connect();
+  const protocol = new J1939Protocol(can, { address: target.address, pipelineDepth: config.pipelineDepth, dbc });
+  const model = new DeviceModel(protocol, deviceCache(config, target));
+  const server = new DaemonServer(protocol, model, target, { socketPath, httpPort: config.httpPort, rules });
+  try {
+    await server.listen();
+  } catch (err) {
+    protocol.close();
+    can.disconnect();
+    throw err;
+  }
+  if (config.metricsPort) await startMetrics(config.metricsPort, () => protocol.getMetrics(), target);
+
+  model.loadCached().catch(() => false);
+  model.refresh().catch(() => {});
+  console.error(
+    `Serving ${targetName(target)} on ${socketPath}` +
+    (config.httpPort ? ` and http://127.0.0.1:${config.httpPort}` : '') + ', Ctrl-C to stop'
+  );
+
+  await new Promise<void>(resolve => {
+    process.once('SIGINT', () => resolve());
+    process.once('SIGTERM', () => resolve());
+  });
+  await server.close();
+  protocol.close();
+  can.disconnect();
+  return 0;
+}
+
+const HEADLESS_COMMANDS = ['apply', 'scan', 'daemon', 'flash', 'watch'];
+
 async function main(): Promise<void> {
   const config = parseArgs();
 
-  console.log(`OSSM Config - Connecting to ${config.interface}...`);
+  const command = config.command;
+  const oneShot = command !== null && DEVICE_COMMANDS.includes(command);
+  const headless = command !== null && HEADLESS_COMMANDS.includes(command);
+  if (command !== null && !headless && !oneShot) {
+    console.error(`Unknown command '${config.command}' (see --help)`);
+    process.exit(2);
+  }
 
-  const can = new CanBus(config.interface);
+  if (config.log && config.record) {
+    console.error('--log and --record cannot be combined');
+    process.exit(2);
+  }
+
+  // One-shot commands and the menu go through a serving daemon; these
+  // open the bus themselves, so they stop rather than compete with it
+  const opensBus = config.record !== undefined || (headless && command !== 'daemon');
+  if (opensBus && !config.log) {
+    const served = await servedTarget(config);
+    if (served) {
+      console.error(
+        `A daemon is serving ${targetName(served)}; stop it or use its API (or pass --no-daemon to open the bus anyway)`
+      );
+      process.exit(1);
+    }
+  }
+
+  if (config.log || config.record) {
+    let code = 1;
+    try {
+      code = config.log ? await runCapture(config) : await runRecord(config);
+    } catch (err) {
+      console.error((err as Error).message);
+    }
+    process.exit(code);
+  }
+
+  if (headless || oneShot) {
+    let code = 1;
+    try {
+      if (command === 'apply') code = await runApply(config);
+      else if (command === 'scan') code = await runScan(config);
+      else if (command === 'daemon') code = await runDaemon(config);
+      else if (command === 'flash') code = await runFlash(config);
+      else if (command === 'watch') code = await runWatch(config);
+      else code = await runDeviceCommand(command, config.args, defaultTargets(config), {
+        pipelineDepth: config.pipelineDepth,
+        cache: config.cache,
+        daemon: config.daemon,
+        socket: config.socket
+      });
+    } catch (err) {
+      console.error((err as Error).message);
+    }
+    process.exit(code);
+  }
+
+  if (config.targets.length > 1) {
+    console.error('The interactive menu takes a single target');
+    process.exit(2);
+  }
+  const target = config.targets[0] ?? { interface: config.interface, address: OSSM_SOURCE_ADDRESS };
+
+  console.log(`OSSM Config - Connecting to ${target.interface}...`);
+
+  if (config.daemon && await runMenuWithDaemon(target, config)) return;
+
+  // The worker mirrors OSSM signals only, so DBC decoding stays on this thread
+  if (config.worker && !config.dbc) {
+    await runMenuWithWorker(target, config);
+    return;
+  }
+
+  const can = new CanBus(target.interface, { bitrate: config.bitrate });
 
   try {
     can.connect();
@@ -39,8 +548,16 @@ async function main(): Promise<void> {
     process.exit(1);
   }
 
-  const protocol = new J1939Protocol(can);
-  const menu = new Menu(protocol, config.interface);
+  const dbc = await loadDbc(config);
+  const protocol = new J1939Protocol(can, {
+    address: target.address,
+    pipelineDepth: config.pipelineDepth,
+    dbc
+  });
+
+  const { Menu } = await import('./ui/menu');
+  const menu = new Menu(protocol, target.interface, deviceCache(config, target), dbc);
+  if (config.metricsPort) await startMetrics(config.metricsPort, () => protocol.getMetrics(), target);
 
   // Handle clean shutdown
   process.on('SIGINT', () => {
@@ -56,6 +573,108 @@ async function main(): Promise<void> {
   }
 }
 
+function defaultTargets(config: Options): Target[] {
+  return config.targets.length > 0
+    ? config.targets
+    : [{ interface: config.interface, address: OSSM_SOURCE_ADDRESS }];
+}
+
+// The first of the command's targets a daemon is serving, if any
+async function servedTarget(config: Options): Promise<Target | null> {
+  if (!config.daemon) return null;
+  const [{ DaemonClient }, { defaultSocketPath }] = await Promise.all([import('./daemon/client'), import('./daemon/rpc')]);
+  const targets = defaultTargets(config);
+  for (const target of targets) {
+    const client = await DaemonClient.find(config.socket && targets.length === 1 ? config.socket : defaultSocketPath(target));
+    if (!client) continue;
+    client.close();
+    return target;
+  }
+  return null;
+}
+
+// --dbc, reporting what the decoder leaves out
+async function loadDbc(config: Options): Promise<DbcDecoder | undefined> {
+  if (!config.dbc) return undefined;
+  const { DbcDecoder } = await import('./protocol/dbc');
+  const dbc = DbcDecoder.load(config.dbc, { anySource: config.dbcAnySource });
+  for (const skipped of dbc.skipped) console.error(`DBC: skipped ${skipped}`);
+  return dbc;
+}
+
+function deviceCache(config: Options, target: Target): DeviceCache | undefined {
+  return config.cache ? new DeviceCache(target.interface, target.address) : undefined;
+}
+
+async function startMetrics(
+  port: number,
+  source: () => MetricsSnapshot | Promise<MetricsSnapshot>,
+  target: Target
+): Promise<void> {
+  const { serveMetrics } = await import('./metrics/prometheus');
+  const labels = { interface: target.interface, address: `0x${target.address.toString(16)}` };
+  serveMetrics(port, source, labels).unref();
+}
+
+// Menu against a running daemon, if one serves the target. The daemon
+// keeps the cache, so the menu does not. False if there is no daemon.
+async function runMenuWithDaemon(target: Target, config: Options): Promise<boolean> {
+  const [{ DaemonClient }, { defaultSocketPath }] = await Promise.all([import('./daemon/client'), import('./daemon/rpc')]);
+  const device = await DaemonClient.find(config.socket ?? defaultSocketPath(target));
+  if (!device) return false;
+
+  const { Menu } = await import('./ui/menu');
+  console.log(`Using the daemon serving ${targetName(target)}`);
+  if (config.dbc) console.log('DBC signals are decoded by the daemon (see its /dbc API), not shown here');
+  const menu = new Menu(device, target.interface);
+
+  process.on('SIGINT', () => {
+    console.log('\nDisconnecting...');
+    device.close();
+    process.exit(0);
+  });
+
+  try {
+    await menu.run();
+  } finally {
+    device.close();
+  }
+  return true;
+}
+
+// Menu on this thread, CAN ingest and decoding on a worker so prompts and
+// terminal output never hold up frame handling
+async function runMenuWithWorker(target: Target, config: Options): Promise<void> {
+  const [{ IngestClient }, { Menu }] = await Promise.all([import('./ingest/client'), import('./ui/menu')]);
+  const device = new IngestClient({
+    interfaceName: target.interface,
+    address: target.address,
+    pipelineDepth: config.pipelineDepth,
+    bitrate: config.bitrate
+  });
+
+  try {
+    await device.start();
+  } catch (err) {
+    console.error((err as Error).message);
+    process.exit(1);
+  }
+
+  const menu = new Menu(device, target.interface, deviceCache(config, target));
+  if (config.metricsPort) await startMetrics(config.metricsPort, () => device.getMetrics(), target);
+
+  process.on('SIGINT', () => {
+    console.log('\nDisconnecting...');
+    device.close().finally(() => process.exit(0));
+  });
+
+  try {
+    await menu.run();
+  } finally {
+    await device.close();
+  }
+}
+
 main().catch(err => {
   console.error('Fatal error:', err.message);
   process.exit(1);
@@ -0,0 +1,153 @@
+// Main-thread handle on an ingest worker
+//
+// Implements the same OssmDevice API as J1939Protocol, forwarding commands
+// to the worker and reading live signals from the shared seqlock, so the
+// menu works unchanged whichever thread owns the bus.
+import * as path from 'path';
+import { Worker } from 'worker_threads';
+import { MetricsSnapshot } from '../metrics/metrics';
+import { CommandOptions, OssmDevice } from '../protocol/j1939';
+import { DeviceMethod, IngestWorkerData, ReplyMessage, RequestMessage } from './rpc';
+import { SharedSignalReader, createSharedSignals } from './shared-signals';
+
+export interface IngestOptions {
+  interfaceName: string;
+  address: number;
+  pipelineDepth?: number;
+  bitrate?: number;  // For the bus load figure
+}
+
+interface PendingCall {
+  resolve: (value: unknown) => void;
+  reject: (err: Error) => void;
+}
+
+// Same extension as this file, so the worker also loads under tsx
+const WORKER_PATH = path.join(__dirname, `worker${path.extname(__filename)}`);
+
+export class IngestClient implements OssmDevice {
+  private readonly worker: Worker;
+  private readonly signals: SharedSignalReader;
+  private readonly pending = new Map<number, PendingCall>();
+  private readonly ready: Promise<void>;
+  private nextId = 1;
+  private exitError: Error | null = null;
+
+  constructor(options: IngestOptions) {
+    const shared = createSharedSignals();
+    this.signals = new SharedSignalReader(shared);
+
+    const workerData: IngestWorkerData = { ...options, signals: shared };
+    this.worker = new Worker(WORKER_PATH, { workerData });
+
+    this.ready = new Promise((resolve, reject) => {
+      this.worker.on('message', (message: ReplyMessage) => {
+        switch (message.kind) {
+          case 'ready':
+            resolve();
+            break;
+          case 'fatal':
+            reject(new Error(message.error));
+            break;
+          case 'result':
+          case 'error':
+            this.settle(message);
+            break;
+        }
+      });
+      this.worker.on('error', reject);
+      this.worker.on('exit', code => {
+        this.exitError = new Error(`Ingest worker exited (code ${code})`);
+        reject(this.exitError);
+        for (const call of this.pending.values()) call.reject(this.exitError);
+        this.pending.clear();
+      });
+    });
+    this.ready.catch(() => {});  // Surfaced through start()
+  }
+
+  // Resolves once the worker has opened the bus; rejects if it could not
+  start(): Promise<void> {
+    return this.ready;
+  }
+
+  async close(): Promise<void> {
+    if (this.exitError) return;
+    const exited = new Promise<void>(resolve => this.worker.once('exit', () => resolve()));
+    this.post({ kind: 'close' });
+    const timer = setTimeout(() => this.worker.terminate(), 1000);
+    await exited;
+    clearTimeout(timer);
+  }
+
+  getSignalStore(): SharedSignalReader {
+    return this.signals;
+  }
+
+  enableSpn(spn: number, enable: boolean, input: number = 0, options?: CommandOptions): Promise<boolean> {
+    return this.call('enableSpn', [spn, enable, input, options]) as Promise<boolean>;
+  }
+
+  setNtcPreset(input: number, preset: number, options?: CommandOptions): Promise<boolean> {
+    return this.call('setNtcPreset', [input, preset, options]) as Promise<boolean>;
+  }
+
+  setPressurePreset(input: number, preset: number, options?: CommandOptions): Promise<boolean> {
+    return this.call('setPressurePreset', [input, preset, options]) as Promise<boolean>;
+  }
+
+  setThermocoupleType(tcType: number, options?: CommandOptions): Promise<boolean> {
+    return this.call('setThermocoupleType', [tcType, options]) as Promise<boolean>;
+  }
+
+  async query(options?: CommandOptions): Promise<Buffer> {
+    return toBuffer(await this.call('query', [options]));
+  }
+
+  async querySection(section: number, options?: CommandOptions): Promise<Buffer> {
+    return toBuffer(await this.call('querySection', [section, options]));
+  }
+
+  save(options?: CommandOptions): Promise<boolean> {
+    return this.call('save', [options]) as Promise<boolean>;
+  }
+
+  reset(options?: CommandOptions): Promise<boolean> {
+    return this.call('reset', [options]) as Promise<boolean>;
+  }
+
+  getMetrics(): Promise<MetricsSnapshot> {
+    return this.call('getMetrics', []) as Promise<MetricsSnapshot>;
+  }
+
+  identify(timeoutMs?: number): Promise<bigint | null> {
+    return this.call('identify', [timeoutMs]) as Promise<bigint | null>;
+  }
+
+  private call(method: DeviceMethod, args: unknown[]): Promise<unknown> {
+    if (this.exitError) return Promise.reject(this.exitError);
+    const id = this.nextId++;
+    return new Promise((resolve, reject) => {
+      this.pending.set(id, { resolve, reject });
+      this.post({ kind: 'call', id, method, args });
+    });
+  }
+
+  private settle(message: Extract<ReplyMessage, { id: number }>): void {
+    const call = this.pending.get(message.id);
+    if (!call) return;
+    this.pending.delete(message.id);
+    if (message.kind === 'result') call.resolve(message.value);
+    else call.reject(new Error(message.error));
+  }
+
+  private post(message: RequestMessage): void {
+    this.worker.postMessage(message);
+  }
+}
+
+// Structured clone turns a Buffer into a plain Uint8Array
+function toBuffer(value: unknown): Buffer {
+  const bytes = value as Uint8Array;
+  return Buffer.from(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+}
@@ -0,0 +1,24 @@
+// Messages between the ingest worker and its client
+import { OssmDevice } from '../protocol/j1939';
+
+export type DeviceMethod = Exclude<keyof OssmDevice, 'getSignalStore'>;
+
+export interface IngestWorkerData {
+  interfaceName: string;
+  address: number;
+  pipelineDepth?: number;
+  bitrate?: number;
+  signals: SharedArrayBuffer;
+}
+
+// Client -> worker
+export type RequestMessage =
+  | { kind: 'call'; id: number; method: DeviceMethod; args: unknown[] }
+  | { kind: 'close' };
+
+// Worker -> client
+export type ReplyMessage =
+  | { kind: 'ready' }
+  | { kind: 'fatal'; error: string }
+  | { kind: 'result'; id: number; value: unknown }
+  | { kind: 'error'; id: number; error: string };
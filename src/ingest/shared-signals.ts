@@ -0,0 +1,89 @@
+// Decoded signals shared between the ingest worker and the UI thread
+//
+// One writer (the worker) and any number of readers share a seqlock over a
+// SharedArrayBuffer: the writer makes the sequence odd, copies the store
+// in, and makes it even again; a reader copies out and retries if the
+// sequence moved underneath it. Neither side ever blocks. Readers see the
+// latest values, not every intermediate update - exactly what a display
+// polling at a fixed rate wants. The worker publishes after every received
+// batch, changed or not, so sample times of steady values stay current.
+import { SIGNAL_COUNT, SignalSource, SignalStore } from '../protocol/decoder';
+
+// Layout: i32 sequence, i32 store version, then f64 values[N], updated[N], lastUpdate
+const HEADER_BYTES = 8;
+const SEQ = 0;
+const VERSION = 1;
+const FLOATS = SIGNAL_COUNT * 2 + 1;
+
+const MAX_READ_ATTEMPTS = 64;
+
+export function createSharedSignals(): SharedArrayBuffer {
+  const buffer = new SharedArrayBuffer(HEADER_BYTES + FLOATS * 8);
+  new Float64Array(buffer, HEADER_BYTES, SIGNAL_COUNT).fill(NaN);
+  return buffer;
+}
+
+export class SharedSignalWriter {
+  private readonly header: Int32Array;
+  private readonly values: Float64Array;
+  private readonly updated: Float64Array;
+  private readonly floats: Float64Array;
+
+  constructor(buffer: SharedArrayBuffer) {
+    this.header = new Int32Array(buffer, 0, 2);
+    this.floats = new Float64Array(buffer, HEADER_BYTES, FLOATS);
+    this.values = this.floats.subarray(0, SIGNAL_COUNT);
+    this.updated = this.floats.subarray(SIGNAL_COUNT, SIGNAL_COUNT * 2);
+  }
+
+  publish(store: SignalStore): void {
+    const header = this.header;
+    Atomics.add(header, SEQ, 1);  // Odd: write in progress
+    this.values.set(store.values);
+    this.updated.set(store.updated);
+    this.floats[SIGNAL_COUNT * 2] = store.lastUpdate;
+    Atomics.store(header, VERSION, store.version);
+    Atomics.add(header, SEQ, 1);  // Even: consistent
+  }
+}
+
+// Local mirror of the worker's store, refreshed on sync()
+export class SharedSignalReader implements SignalSource {
+  readonly values = new Float64Array(SIGNAL_COUNT).fill(NaN);
+  readonly updated = new Float64Array(SIGNAL_COUNT);
+  lastUpdate = 0;
+  private version = 0;
+  private seq = 0;  // Sequence of the copy held
+  private readonly header: Int32Array;
+  private readonly shared: Float64Array;
+
+  constructor(buffer: SharedArrayBuffer) {
+    this.header = new Int32Array(buffer, 0, 2);
+    this.shared = new Float64Array(buffer, HEADER_BYTES, FLOATS);
+  }
+
+  sync(): number {
+    const header = this.header;
+    const shared = this.shared;
+
+    for (let attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+      const seq = Atomics.load(header, SEQ);
+      if (seq & 1) continue;  // Writer mid-update
+      if (seq === this.seq) return this.version;  // Nothing published since
+      const version = Atomics.load(header, VERSION);
+
+      this.values.set(shared.subarray(0, SIGNAL_COUNT));
+      this.updated.set(shared.subarray(SIGNAL_COUNT, SIGNAL_COUNT * 2));
+      const lastUpdate = shared[SIGNAL_COUNT * 2];
+      if (Atomics.load(header, SEQ) !== seq) continue;  // Torn read, try again
+
+      this.lastUpdate = lastUpdate;
+      this.version = version;
+      this.seq = seq;
+      return version;
+    }
+
+    // Writer kept us out; keep the previous consistent copy
+    return this.version;
+  }
+}
@@ -0,0 +1,71 @@
+// Ingest worker: owns the CAN socket and J1939 decoding
+//
+// Runs CanBus + J1939Protocol on its own event loop so frame handling is
+// never delayed by terminal output or prompts on the main thread. Decoded
+// signals are published through SharedSignalWriter at most once per
+// received batch; commands arrive as RPC messages.
+import { parentPort, workerData } from 'worker_threads';
+import { CanBus } from '../can/socketcan';
+import { J1939Protocol } from '../protocol/j1939';
+import { DeviceMethod, IngestWorkerData, ReplyMessage, RequestMessage } from './rpc';
+import { SharedSignalWriter } from './shared-signals';
+
+const METHODS: ReadonlySet<DeviceMethod> = new Set<DeviceMethod>([
+  'enableSpn', 'setNtcPreset', 'setPressurePreset', 'setThermocoupleType',
+  'query', 'querySection', 'save', 'reset', 'getMetrics', 'identify',
+]);
+
+function start(port: NonNullable<typeof parentPort>, data: IngestWorkerData): void {
+  const post = (message: ReplyMessage) => port.postMessage(message);
+
+  const can = new CanBus(data.interfaceName, { bitrate: data.bitrate });
+  try {
+    can.connect();
+  } catch (err) {
+    post({ kind: 'fatal', error: (err as Error).message });
+    port.close();
+    return;
+  }
+
+  const protocol = new J1939Protocol(can, { address: data.address, pipelineDepth: data.pipelineDepth });
+  const store = protocol.getSignalStore();
+  const writer = new SharedSignalWriter(data.signals);
+
+  // Every frame of a batch is decoded synchronously, so a microtask runs
+  // once after the whole batch. Unchanged batches are published too, so
+  // sample times (and staleness) stay current on the UI side.
+  let publishQueued = false;
+  can.onBatch(() => {
+    if (publishQueued) return;
+    publishQueued = true;
+    queueMicrotask(() => {
+      publishQueued = false;
+      writer.publish(store);
+    });
+  });
+
+  port.on('message', (message: RequestMessage) => {
+    if (message.kind === 'close') {
+      protocol.close();
+      can.disconnect();
+      port.close();
+      return;
+    }
+
+    const { id, method, args } = message;
+    if (!METHODS.has(method)) {
+      post({ kind: 'error', id, error: `Unknown method '${method}'` });
+      return;
+    }
+    const fn = protocol[method] as (...a: unknown[]) => unknown;
+    Promise.resolve().then(() => fn.apply(protocol, args)).then(
+      // Copy Buffers out so only their bytes are cloned, not a shared pool slab
+      value => post({ kind: 'result', id, value: value instanceof Uint8Array ? new Uint8Array(value) : value }),
+      err => post({ kind: 'error', id, error: (err as Error).message })
+    );
+  });
+
+  post({ kind: 'ready' });
+}
+
+if (parentPort) start(parentPort, workerData as IngestWorkerData);
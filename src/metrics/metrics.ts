@@ -0,0 +1,100 @@
+// Low-overhead counters and latency histograms
+//
+// Everything is a plain number or a fixed bucket array updated in place on
+// the hot path; snapshot() copies them into plain objects that survive
+// structured clone (worker RPC) and JSON.
+import type { PgnHealth } from '../protocol/watchdog';
+
+// Log2 buckets over microseconds: bucket 0 is < 1 us, bucket i covers
+// [2^(i-1), 2^i) us, the last one is open-ended (over ~18 minutes)
+export const HISTOGRAM_BUCKETS = 32;
+
+export interface HistogramSnapshot {
+  buckets: number[];
+  count: number;
+  sumUs: number;
+  maxUs: number;
+}
+
+export class Histogram {
+  private readonly buckets = new Uint32Array(HISTOGRAM_BUCKETS);
+  private count = 0;
+  private sumUs = 0;
+  private maxUs = 0;
+
+  record(us: number): void {
+    const i = us < 1 ? 0
+      : us >= 0x80000000 ? HISTOGRAM_BUCKETS - 1
+      : Math.min(HISTOGRAM_BUCKETS - 1, 32 - Math.clz32(us));
+    this.buckets[i]++;
+    this.count++;
+    this.sumUs += us;
+    if (us > this.maxUs) this.maxUs = us;
+  }
+
+  snapshot(): HistogramSnapshot {
+    return { buckets: Array.from(this.buckets), count: this.count, sumUs: this.sumUs, maxUs: this.maxUs };
+  }
+}
+
+// Upper bound (us) of the bucket holding quantile q; 0 when empty
+export function histogramQuantile(h: HistogramSnapshot, q: number): number {
+  if (h.count === 0) return 0;
+  const rank = Math.max(1, Math.ceil(h.count * q));
+  let seen = 0;
+  for (let i = 0; i < h.buckets.length; i++) {
+    seen += h.buckets[i];
+    if (seen >= rank) return Math.min(bucketUpperUs(i), h.maxUs);
+  }
+  return h.maxUs;
+}
+
+export function bucketUpperUs(i: number): number {
+  return i === HISTOGRAM_BUCKETS - 1 ? Infinity : 2 ** i;
+}
+
+export interface BusMetrics {
+  framesReceived: number;
+  bytesReceived: number;
+  framesSent: number;
+  bytesSent: number;
+  sendErrors: number;
+  txQueued: number;   // Frames waiting for room in the kernel queue
+  txDropped: number;  // Queued frames dropped as stale, withdrawn or on disconnect
+  txStalls: number;   // Times nothing went out for long enough to count as stalled
+  busLoad: number;    // % of the bitrate in use, whole bus (0 = unknown)
+}
+
+export function emptyBusMetrics(): BusMetrics {
+  return {
+    framesReceived: 0, bytesReceived: 0, framesSent: 0, bytesSent: 0, sendErrors: 0,
+    txQueued: 0, txDropped: 0, txStalls: 0, busLoad: 0
+  };
+}
+
+export interface ProtocolMetrics {
+  framesProcessed: number;     // Frames reaching the protocol
+  droppedBySource: number;     // From a source address we do not accept
+  unknownPgn: number;          // Accepted source, PGN we do not handle
+  framesDecoded: number;       // Sensor frames run through the decoder
+  dbcDecoded: number;          // Frames matched by a loaded DBC
+  decodeBatch: HistogramSnapshot;  // Time to process one received batch
+}
+
+export interface CommandMetrics {
+  sent: number;          // Transmissions, including retries
+  responses: number;
+  timeouts: number;
+  retries: number;
+  failed: number;        // Rejected after all retries, or never transmitted
+  pending: number;       // Queued or in flight right now
+  timeoutMs: number;     // Current adaptive response timeout
+  roundTrip: HistogramSnapshot;
+}
+
+export interface MetricsSnapshot {
+  bus: BusMetrics;
+  protocol: ProtocolMetrics;
+  commands: CommandMetrics;
+  pgns: PgnHealth[];  // Broadcast health of the target's PGNs
+}
@@ -0,0 +1,98 @@
+// Prometheus text exposition for MetricsSnapshot
+import * as http from 'http';
+import { HistogramSnapshot, MetricsSnapshot, bucketUpperUs } from './metrics';
+
+export type Labels = Record<string, string>;
+
+export function formatPrometheus(snapshot: MetricsSnapshot, labels: Labels = {}): string {
+  const out: string[] = [];
+  const lbl = labelString(labels);
+
+  const counter = (name: string, help: string, value: number) => {
+    out.push(`# HELP ${name} ${help}`, `# TYPE ${name} counter`, `${name}${lbl} ${value}`);
+  };
+  const gauge = (name: string, help: string, value: number) => {
+    out.push(`# HELP ${name} ${help}`, `# TYPE ${name} gauge`, `${name}${lbl} ${value}`);
+  };
+
+  // One series per tracked PGN
+  const perPgn = (name: string, type: string, help: string, value: (h: MetricsSnapshot['pgns'][number]) => number) => {
+    if (snapshot.pgns.length === 0) return;
+    out.push(`# HELP ${name} ${help}`, `# TYPE ${name} ${type}`);
+    for (const h of snapshot.pgns) out.push(`${name}${labelString({ ...labels, pgn: String(h.pgn) })} ${value(h)}`);
+  };
+
+  const { bus, protocol, commands } = snapshot;
+  counter('ossm_can_frames_received_total', 'CAN frames received', bus.framesReceived);
+  counter('ossm_can_bytes_received_total', 'CAN payload bytes received', bus.bytesReceived);
+  counter('ossm_can_frames_sent_total', 'CAN frames sent', bus.framesSent);
+  counter('ossm_can_bytes_sent_total', 'CAN payload bytes sent', bus.bytesSent);
+  counter('ossm_can_send_errors_total', 'CAN transmit failures', bus.sendErrors);
+  gauge('ossm_can_tx_queued', 'Frames waiting for room in the kernel transmit queue', bus.txQueued);
+  counter('ossm_can_tx_dropped_total', 'Queued frames dropped as stale, withdrawn or on disconnect', bus.txDropped);
+  counter('ossm_can_tx_stalls_total', 'Times transmission stalled for 500 ms or the link went down', bus.txStalls);
+  gauge('ossm_can_bus_load_ratio', 'Share of the bitrate in use on the whole bus', bus.busLoad / 100);
+
+  counter('ossm_j1939_frames_processed_total', 'Frames handled by the J1939 layer', protocol.framesProcessed);
+  counter('ossm_j1939_dropped_source_total', 'Frames dropped by the source address filter', protocol.droppedBySource);
+  counter('ossm_j1939_unknown_pgn_total', 'Frames with a PGN that is not decoded', protocol.unknownPgn);
+  counter('ossm_j1939_frames_decoded_total', 'Sensor frames decoded', protocol.framesDecoded);
+  counter('ossm_j1939_dbc_decoded_total', 'Frames decoded by the loaded DBC', protocol.dbcDecoded);
+  histogram(out, 'ossm_j1939_decode_batch_seconds', 'Time to process one received batch', protocol.decodeBatch, labels);
+  perPgn('ossm_j1939_pgn_stale', 'gauge', '1 if the PGN stopped arriving', h => (h.stale ? 1 : 0));
+  perPgn('ossm_j1939_pgn_frames_total', 'counter', 'Frames received per PGN', h => h.frames);
+  perPgn('ossm_j1939_pgn_missed_total', 'counter', 'Broadcast intervals that passed without the PGN', h => h.missed);
+  perPgn('ossm_j1939_pgn_jitter_seconds', 'gauge', 'Smoothed deviation from the broadcast interval', h => h.jitterUs / 1e6);
+
+  counter('ossm_commands_sent_total', 'Command transmissions, including retries', commands.sent);
+  counter('ossm_commands_responses_total', 'Command responses received', commands.responses);
+  counter('ossm_commands_timeouts_total', 'Command timeouts', commands.timeouts);
+  counter('ossm_commands_retries_total', 'Command retries', commands.retries);
+  counter('ossm_commands_failed_total', 'Commands that failed', commands.failed);
+  gauge('ossm_commands_pending', 'Commands queued or in flight', commands.pending);
+  gauge('ossm_command_timeout_seconds', 'Current adaptive response timeout', commands.timeoutMs / 1000);
+  histogram(out, 'ossm_command_round_trip_seconds', 'Command round-trip time', commands.roundTrip, labels);
+
+  return out.join('\n') + '\n';
+}
+
+function histogram(out: string[], name: string, help: string, h: HistogramSnapshot, labels: Labels): void {
+  out.push(`# HELP ${name} ${help}`, `# TYPE ${name} histogram`);
+  let cumulative = 0;
+  for (let i = 0; i < h.buckets.length; i++) {
+    cumulative += h.buckets[i];
+    const upper = bucketUpperUs(i);
+    // Skip empty leading/trailing buckets; +Inf always carries the total
+    if (upper !== Infinity && (cumulative === 0 || cumulative === h.count && h.buckets[i] === 0)) continue;
+    const le = upper === Infinity ? '+Inf' : String(upper / 1e6);
+    out.push(`${name}_bucket${labelString({ ...labels, le })} ${cumulative}`);
+  }
+  out.push(`${name}_sum${labelString(labels)} ${h.sumUs / 1e6}`, `${name}_count${labelString(labels)} ${h.count}`);
+}
+
+function labelString(labels: Labels): string {
+  const parts = Object.entries(labels).map(([k, v]) => `${k}="${v.replace(/["\\\n]/g, c => (c === '\n' ? '\\n' : `\\${c}`))}"`);
+  return parts.length ? `{${parts.join(',')}}` : '';
+}
+
+// Serve GET /metrics on `port`. Returns the server so callers can close it.
+export function serveMetrics(
+  port: number,
+  source: () => MetricsSnapshot | Promise<MetricsSnapshot>,
+  labels: Labels = {}
+): http.Server {
+  const server = http.createServer(async (req, res) => {
+    if (req.method !== 'GET' || (req.url !== '/metrics' && req.url !== '/')) {
+      res.writeHead(404).end();
+      return;
+    }
+    try {
+      const body = formatPrometheus(await source(), labels);
+      res.writeHead(200, { 'Content-Type': 'text/plain; version=0.0.4' }).end(body);
+    } catch (err) {
+      res.writeHead(500, { 'Content-Type': 'text/plain' }).end(`${(err as Error).message}\n`);
+    }
+  });
+  server.listen(port);
+  return server;
+}
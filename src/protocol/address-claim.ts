@@ -0,0 +1,55 @@
+// J1939-81 address claim: node discovery by NAME
+//
+// Every J1939 node announces its 64-bit NAME on PGN 60928 when it claims
+// a source address, and again whenever a Request for that PGN is sent to
+// the global address - so one request is enough to enumerate the bus.
+
+export const PGN_ADDRESS_CLAIM = 60928;  // 0xEE00 (PDU1)
+export const PGN_REQUEST = 59904;        // 0xEA00 (PDU1)
+
+export const GLOBAL_ADDRESS = 0xFF;
+export const NULL_ADDRESS = 0xFE;  // Source of a Cannot Claim Address message
+
+export interface NameFields {
+  identityNumber: number;     // 21 bits
+  manufacturerCode: number;   // 11 bits
+  ecuInstance: number;        // 3 bits
+  functionInstance: number;   // 5 bits
+  function: number;           // 8 bits
+  vehicleSystem: number;      // 7 bits
+  vehicleSystemInstance: number;  // 4 bits
+  industryGroup: number;      // 3 bits
+  arbitraryAddressCapable: boolean;
+}
+
+// NAME is sent little-endian in the 8 data bytes
+export function readName(data: Uint8Array, base: number = 0): bigint {
+  let name = 0n;
+  for (let i = 7; i >= 0; i--) name = (name << 8n) | BigInt(data[base + i]);
+  return name;
+}
+
+export function decodeName(name: bigint): NameFields {
+  const lo = Number(name & 0xFFFFFFFFn);
+  const hi = Number(name >> 32n);
+  return {
+    identityNumber: lo & 0x1FFFFF,
+    manufacturerCode: lo >>> 21,
+    ecuInstance: hi & 0x07,
+    functionInstance: (hi >>> 3) & 0x1F,
+    function: (hi >>> 8) & 0xFF,
+    vehicleSystem: (hi >>> 17) & 0x7F,
+    vehicleSystemInstance: (hi >>> 24) & 0x0F,
+    industryGroup: (hi >>> 28) & 0x07,
+    arbitraryAddressCapable: (hi >>> 31) === 1,
+  };
+}
+
+export function formatName(name: bigint): string {
+  return name.toString(16).toUpperCase().padStart(16, '0');
+}
+
+// Payload of a Request for Address Claimed
+export function addressClaimRequest(): Buffer {
+  return Buffer.from([PGN_ADDRESS_CLAIM & 0xFF, (PGN_ADDRESS_CLAIM >> 8) & 0xFF, PGN_ADDRESS_CLAIM >> 16]);
+}
@@ -0,0 +1,308 @@
+// Pipelined command queue for the OSSM command/response protocol
+//
+// OSSM response frames carry a status/data payload but no command ID, and
+// the firmware handles commands strictly in arrival order. Responses are
+// therefore matched to commands by transmit sequence: the oldest in-flight
+// command owns the next response. CAN retransmits at the link layer, so
+// sequence only slips when a node drops a frame; that surfaces as a
+// timeout, after which everything in flight is resent, each resend using
+// up one of that command's retries (pipelineDepth: 1 rules it out
+// entirely). Commands that are not idempotent (SAVE, RESET) are never
+// resent: the module may already have acted on them, so they fail.
+//
+// Unless a command gives its own timeoutMs, it waits an adaptive timeout
+// derived from measured round trips (SRTT + 4 * RTTVAR, as TCP does),
+// between minTimeoutMs and timeoutMs. Several timeouts in a row with no
+// reply in between mark the device unreachable, once the command that
+// timed out has no retries left: everything queued fails at once with
+// DeviceUnreachableError instead of timing out one by one.
+//
+// A command's timeout, and its round trip, start once its frame has been
+// sent, so time spent in a busy transmit queue or a TP transfer counts
+// against neither. A frame still waiting after the timeout is withdrawn by
+// the transport, and the command fails as never sent.
+import { CommandMetrics, Histogram } from '../metrics/metrics';
+
+export interface CommandOptions {
+  timeoutMs?: number;   // Fixed time to wait for this command's response (default adaptive)
+  retries?: number;     // Extra attempts after a timeout
+  rttSample?: boolean;  // Feed the round trip to the adaptive timeout (default: when not fixed)
+  idempotent?: boolean; // Safe to resend when its reply may have been lost (default true)
+}
+
+export interface CommandQueueOptions extends Omit<CommandOptions, 'rttSample' | 'idempotent'> {
+  pipelineDepth?: number;    // Max commands in flight at once
+  resyncMs?: number;         // Quiet period after a timeout before resuming
+  minTimeoutMs?: number;     // Floor for the adaptive timeout
+  unreachableAfter?: number; // Consecutive timeouts that mark the device unreachable
+}
+
+// How long a command's frame may wait to be sent, and a signal that
+// withdraws it if it is still waiting
+export interface TransmitOptions {
+  maxAgeMs: number;
+  signal: AbortSignal;
+}
+
+// Settles once the frame is sent; rejects if it never will be
+export type Transmit = (frame: Buffer, options: TransmitOptions) => Promise<void> | void;
+
+// Queued commands fail with this once the device stops answering
+export class DeviceUnreachableError extends Error {
+  constructor(message: string) {
+    super(message);
+    this.name = 'DeviceUnreachableError';
+  }
+}
+
+const DEFAULT_TIMEOUT_MS = 2000;
+const DEFAULT_MIN_TIMEOUT_MS = 100;
+const DEFAULT_PIPELINE_DEPTH = 4;
+const DEFAULT_RESYNC_MS = 50;
+const DEFAULT_UNREACHABLE_AFTER = 2;
+
+interface PendingCommand {
+  seq: number;
+  frame: Buffer;
+  timeoutMs: number | null;  // null = adaptive
+  rttSample: boolean;
+  idempotent: boolean;
+  retriesLeft: number;
+  attempts: number;
+  waitedMs: number;  // Total time spent waiting on timed-out attempts
+  sentAt: number;    // performance.now() the latest transmission completed
+  sending: AbortController | null;  // The latest transmission has not settled
+  timer: NodeJS.Timeout | null;
+  resolve: (data: Buffer) => void;
+  reject: (err: Error) => void;
+}
+
+export class CommandQueue {
+  private readonly transmit: Transmit;
+  private readonly pipelineDepth: number;
+  readonly timeoutMs: number;  // Adaptive ceiling, and the timeout before any sample
+  private readonly minTimeoutMs: number;
+  private readonly retries: number;
+  private readonly resyncMs: number;
+  private readonly unreachableAfter: number;
+  private srttMs = 0;     // Smoothed round trip (0 = no sample yet)
+  private rttvarMs = 0;
+  private rtoMs: number;  // Current adaptive timeout
+  private consecutiveTimeouts = 0;
+  private readonly waiting: PendingCommand[] = [];
+  private readonly inFlight: PendingCommand[] = [];  // In transmit order
+  private nextSeq = 0;
+  private resyncing = false;
+  private readonly counts = { sent: 0, responses: 0, timeouts: 0, retries: 0, failed: 0 };
+  private readonly roundTrip = new Histogram();
+
+  constructor(transmit: Transmit, options: CommandQueueOptions = {}) {
+    this.transmit = transmit;
+    this.pipelineDepth = Math.max(1, options.pipelineDepth ?? DEFAULT_PIPELINE_DEPTH);
+    this.timeoutMs = options.timeoutMs ?? DEFAULT_TIMEOUT_MS;
+    this.minTimeoutMs = Math.min(this.timeoutMs, options.minTimeoutMs ?? DEFAULT_MIN_TIMEOUT_MS);
+    this.retries = Math.max(0, options.retries ?? 0);
+    this.resyncMs = options.resyncMs ?? DEFAULT_RESYNC_MS;
+    this.unreachableAfter = Math.max(1, options.unreachableAfter ?? DEFAULT_UNREACHABLE_AFTER);
+    this.rtoMs = this.timeoutMs;
+  }
+
+  enqueue(frame: Buffer, options: CommandOptions = {}): Promise<Buffer> {
+    return new Promise((resolve, reject) => {
+      this.waiting.push({
+        seq: this.nextSeq++,
+        frame,
+        timeoutMs: options.timeoutMs ?? null,
+        rttSample: options.rttSample ?? options.timeoutMs === undefined,
+        idempotent: options.idempotent ?? true,
+        retriesLeft: Math.max(0, options.retries ?? this.retries),
+        attempts: 0,
+        waitedMs: 0,
+        sentAt: 0,
+        sending: null,
+        timer: null,
+        resolve,
+        reject,
+      });
+      this.pump();
+    });
+  }
+
+  // Hand a received response to the oldest in-flight command
+  handleResponse(data: Buffer): void {
+    if (this.resyncing) return;  // Possibly a late reply to a timed-out command
+    const cmd = this.inFlight.shift();
+    if (!cmd) return;
+
+    clearTimeout(cmd.timer!);
+    // Answered before the transport reported the frame sent: no round trip
+    const measured = cmd.sending === null;
+    this.settle(cmd);
+    this.counts.responses++;
+    this.consecutiveTimeouts = 0;
+    if (measured) {
+      const rttMs = performance.now() - cmd.sentAt;
+      this.roundTrip.record(rttMs * 1000);
+      // Karn: a retried command's reply may belong to any attempt
+      if (cmd.rttSample && cmd.attempts === 1) this.sampleRtt(rttMs);
+    }
+    cmd.resolve(data);
+    this.pump();
+  }
+
+  // Current adaptive timeout
+  get timeout(): number {
+    return this.rtoMs;
+  }
+
+  get pending(): number {
+    return this.waiting.length + this.inFlight.length;
+  }
+
+  getMetrics(): CommandMetrics {
+    return { ...this.counts, pending: this.pending, timeoutMs: this.rtoMs, roundTrip: this.roundTrip.snapshot() };
+  }
+
+  // Reject everything queued or in flight
+  cancelAll(err: Error): void {
+    for (const cmd of this.inFlight.splice(0)) {
+      clearTimeout(cmd.timer!);
+      this.settle(cmd);
+      cmd.reject(err);
+    }
+    for (const cmd of this.waiting.splice(0)) cmd.reject(err);
+  }
+
+  // Fail everything outstanding as unreachable, counting the failures
+  abort(err: DeviceUnreachableError): void {
+    this.counts.failed += this.pending;
+    this.cancelAll(err);
+  }
+
+  // RFC 6298 estimator
+  private sampleRtt(rttMs: number): void {
+    if (this.srttMs === 0) {
+      this.srttMs = rttMs;
+      this.rttvarMs = rttMs / 2;
+    } else {
+      this.rttvarMs = 0.75 * this.rttvarMs + 0.25 * Math.abs(this.srttMs - rttMs);
+      this.srttMs = 0.875 * this.srttMs + 0.125 * rttMs;
+    }
+    this.rtoMs = this.clampTimeout(this.srttMs + 4 * this.rttvarMs);
+  }
+
+  private clampTimeout(ms: number): number {
+    return Math.min(this.timeoutMs, Math.max(this.minTimeoutMs, Math.ceil(ms)));
+  }
+
+  private pump(): void {
+    while (!this.resyncing && this.inFlight.length < this.pipelineDepth && this.waiting.length > 0) {
+      const cmd = this.waiting.shift()!;
+      this.inFlight.push(cmd);
+      cmd.attempts++;
+      this.counts.sent++;
+
+      const sending = new AbortController();
+      try {
+        const maxAgeMs = cmd.timeoutMs ?? this.rtoMs;
+        const sent = this.transmit(cmd.frame, { maxAgeMs, signal: sending.signal });
+        if (sent) {
+          cmd.sending = sending;
+          sent.then(() => this.sent(cmd, sending), err => this.failInFlight(cmd, err as Error, sending));
+        } else {
+          this.arm(cmd);
+        }
+      } catch (err) {
+        this.failInFlight(cmd, err as Error);
+      }
+    }
+  }
+
+  // The frame went out: the wait for its response starts now
+  private sent(cmd: PendingCommand, sending: AbortController): void {
+    if (cmd.sending !== sending) return;
+    this.settle(cmd);
+    this.arm(cmd);
+  }
+
+  private arm(cmd: PendingCommand): void {
+    const timeoutMs = cmd.timeoutMs ?? this.rtoMs;
+    cmd.sentAt = performance.now();
+    cmd.timer = setTimeout(() => this.handleTimeout(cmd, timeoutMs), timeoutMs);
+  }
+
+  // Withdraw the latest transmission if it is still waiting
+  private settle(cmd: PendingCommand): void {
+    cmd.sending?.abort();
+    cmd.sending = null;
+  }
+
+  // The command never reached the bus, so it owns no response
+  private failInFlight(cmd: PendingCommand, err: Error, sending?: AbortController): void {
+    if (sending && cmd.sending !== sending) return;  // An earlier attempt's frame
+    const i = this.inFlight.indexOf(cmd);
+    if (i < 0) return;
+    this.inFlight.splice(i, 1);
+    this.settle(cmd);
+    clearTimeout(cmd.timer!);
+    this.counts.failed++;
+    cmd.reject(err);
+    this.pump();
+  }
+
+  private handleTimeout(timedOut: PendingCommand, waitedMs: number): void {
+    this.counts.timeouts++;
+    timedOut.waitedMs += waitedMs;
+    if (timedOut.timeoutMs === null) {
+      // Back off, as an adaptive timeout may simply have been too short
+      this.rtoMs = this.clampTimeout(this.rtoMs * 2);
+    }
+
+    // A command's own retries come first
+    const retrying = timedOut.idempotent && timedOut.retriesLeft > 0;
+    if (++this.consecutiveTimeouts >= this.unreachableAfter && !retrying) {
+      const total = this.consecutiveTimeouts;
+      this.consecutiveTimeouts = 0;
+      this.abort(new DeviceUnreachableError(
+        `OSSM not responding - check connection (${total} timeouts in a row, last after ${waitedMs} ms)`
+      ));
+      return;
+    }
+
+    // Sequence matching is no longer trustworthy: every command sent after
+    // the timed-out one may receive a shifted response. Pull all of them
+    // back, wait for stray replies to drain, then resend in original order.
+    const requeue: PendingCommand[] = [];
+    for (const cmd of this.inFlight.splice(0)) {
+      clearTimeout(cmd.timer!);
+      cmd.timer = null;
+      this.settle(cmd);
+      if (cmd.idempotent && cmd.retriesLeft > 0) {
+        cmd.retriesLeft--;
+        this.counts.retries++;
+        requeue.push(cmd);
+        continue;
+      }
+      this.counts.failed++;
+      const attempts = `${cmd.attempts} attempt${cmd.attempts === 1 ? '' : 's'}`;
+      if (cmd === timedOut) {
+        cmd.reject(new Error(
+          `No response from OSSM - check connection (${attempts}, ${Math.round(cmd.waitedMs)} ms)` +
+          (cmd.idempotent ? '' : '; not resent, it may have been carried out')
+        ));
+      } else {
+        cmd.reject(new Error(
+          `Reply lost behind a timed-out command (${attempts})` +
+          (cmd.idempotent ? '; no retries left' : '; not resent, it may have been carried out')
+        ));
+      }
+    }
+
+    this.waiting.unshift(...requeue.sort((a, b) => a.seq - b.seq));
+    this.resyncing = true;
+    setTimeout(() => {
+      this.resyncing = false;
+      this.pump();
+    }, this.resyncMs);
+  }
+}
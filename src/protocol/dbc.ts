@@ -0,0 +1,354 @@
+// DBC import: decode third-party J1939 messages alongside OSSM
+//
+// Parses the message (BO_) and signal (SG_) definitions of a DBC file and
+// compiles them into a table indexed directly by PGN, so one lookup per
+// frame finds the messages to decode whatever the bus carries. A message
+// matches frames of its PGN from the source address in its DBC CAN ID
+// (any address with anySource); PDU1 messages match any destination.
+//
+// Vector's VECTOR__INDEPENDENT_SIG_MSG pseudo-message (signals attached to
+// no message) is skipped, and so are signals that need extended
+// multiplexing (SG_MUL_VAL_); those are listed in `skipped`.
+//
+// Values follow J1939 conventions: an unsigned signal of whole bytes whose
+// raw value is in the top "error / not available" range (0xFB-0xFF in the
+// high byte), or a 2-bit status of 3, reads as NaN rather than a number.
+import * as fs from 'fs';
+import type { SignalSource } from './decoder';
+
+export interface DbcSignal {
+  name: string;
+  startBit: number;       // DBC numbering: LSB for Intel, MSB for Motorola
+  length: number;         // Bits, 1-52
+  littleEndian: boolean;  // @1 (Intel) or @0 (Motorola)
+  signed: boolean;
+  factor: number;
+  offset: number;
+  minimum: number;
+  maximum: number;
+  unit: string;
+  multiplexor: boolean;    // This signal selects the multiplexed ones
+  multiplex: number | null;  // Decoded only when the multiplexor has this value
+}
+
+export interface DbcMessage {
+  name: string;
+  canId: number;          // 29-bit identifier from the file
+  pgn: number;
+  sourceAddress: number;
+  dlc: number;
+  signals: DbcSignal[];
+  skipped: string[];      // Signals left out, with the reason
+}
+
+export interface DbcSlot {
+  name: string;           // "Message.Signal"
+  message: string;
+  signal: string;
+  unit: string;
+  sourceAddress: number;  // -1 = any
+}
+
+export interface DbcOptions {
+  anySource?: boolean;  // Match messages from every source address
+}
+
+const EXTENDED_FLAG = 0x80000000;  // Set on extended IDs in DBC files
+const INDEPENDENT_SIGNALS = 'VECTOR__INDEPENDENT_SIG_MSG';  // ID 0xC0000000, not a real message
+const MAX_SIGNAL_BITS = 52;        // Exact in a double
+
+// Direct-indexed tables: PDU2 by data page and PF/PS, PDU1 by data page and PF
+const PDU2_COUNT = 0x2000;
+const PDU1_COUNT = 0x200;
+
+const MESSAGE_LINE = /^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)/;
+const SIGNAL_LINE =
+  /^SG_\s+(\w+)\s*(M|m\d+M?)?\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*\(\s*([^,]+),\s*([^)]+)\)\s*\[\s*([^|]*)\|\s*([^\]]*)\]\s*"([^"]*)"/;
+
+// J1939 PGN of a 29-bit identifier: data page, PF and (PDU2 only) PS
+export function pgnOf(canId: number): number {
+  const pf = (canId >> 16) & 0xFF;
+  const pgn = (canId >> 8) & 0x3FFFF;
+  return pf >= 240 ? pgn : pgn & 0x3FF00;
+}
+
+export function parseDbc(text: string): DbcMessage[] {
+  const messages: DbcMessage[] = [];
+  const lines = text.split(/\r?\n/);
+  let current: DbcMessage | null = null;
+
+  for (let i = 0; i < lines.length; i++) {
+    const line = lines[i].trim();
+    if (line.startsWith('BO_ ')) {
+      const m = MESSAGE_LINE.exec(line);
+      if (!m) throw new Error(`DBC line ${i + 1}: malformed message definition`);
+      const id = Number(m[1]);
+      current = null;
+      // Standard IDs are not J1939
+      if (id < EXTENDED_FLAG || id - EXTENDED_FLAG > 0x1FFFFFFF || m[2] === INDEPENDENT_SIGNALS) continue;
+      const canId = id - EXTENDED_FLAG;
+      current = {
+        name: m[2], canId, pgn: pgnOf(canId), sourceAddress: canId & 0xFF, dlc: Number(m[3]), signals: [], skipped: [],
+      };
+      messages.push(current);
+    } else if (line.startsWith('SG_ ')) {
+      const m = SIGNAL_LINE.exec(line);
+      if (!m) throw new Error(`DBC line ${i + 1}: malformed signal definition`);
+      if (!current) continue;  // Belongs to a skipped message
+      if (m[2]?.endsWith('M') && m[2] !== 'M') {
+        current.skipped.push(`${m[1]}: extended multiplexing is not supported`);
+        continue;
+      }
+      const length = Number(m[4]);
+      if (length < 1 || length > MAX_SIGNAL_BITS) {
+        throw new Error(`DBC line ${i + 1}: ${m[1]} is ${length} bits (1-${MAX_SIGNAL_BITS} supported)`);
+      }
+      current.signals.push({
+        name: m[1],
+        startBit: Number(m[3]),
+        length,
+        littleEndian: m[5] === '1',
+        signed: m[6] === '-',
+        factor: Number(m[7]),
+        offset: Number(m[8]),
+        minimum: Number(m[9]),
+        maximum: Number(m[10]),
+        unit: m[11],
+        multiplexor: m[2] === 'M',
+        multiplex: m[2]?.startsWith('m') ? Number(m[2].slice(1)) : null,
+      });
+    } else if (line !== '') {
+      current = null;  // Any other section ends the message
+    }
+  }
+
+  // With a nested multiplexor, which one an m<n> signal follows is only
+  // given by SG_MUL_VAL_, so none of the message's multiplexed signals are safe
+  for (const message of messages) {
+    if (message.skipped.length === 0) continue;
+    for (const signal of message.signals.filter(s => s.multiplex !== null)) {
+      message.skipped.push(`${signal.name}: extended multiplexing is not supported`);
+    }
+    message.signals = message.signals.filter(s => s.multiplex === null);
+  }
+
+  return messages;
+}
+
+export function loadDbc(filePath: string): DbcMessage[] {
+  return parseDbc(fs.readFileSync(filePath, 'utf8'));
+}
+
+// A signal ready to extract: bit positions resolved once at load time
+class CompiledSignal {
+  readonly slot: number;
+  readonly startBit: number;
+  readonly length: number;
+  readonly littleEndian: boolean;
+  readonly signed: boolean;
+  readonly factor: number;
+  readonly offset: number;
+  readonly lastByte: number;     // Highest byte the signal reads
+  readonly invalidFrom: number;  // Raw values at or above this are not available
+  readonly multiplex: number;    // -1 = always decoded
+
+  constructor(slot: number, s: DbcSignal) {
+    this.slot = slot;
+    this.startBit = s.startBit;
+    this.length = s.length;
+    this.littleEndian = s.littleEndian;
+    this.signed = s.signed;
+    this.factor = s.factor;
+    this.offset = s.offset;
+    this.lastByte = s.littleEndian ? (s.startBit + s.length - 1) >> 3 : motorolaLastByte(s.startBit, s.length);
+    this.invalidFrom = s.signed ? Infinity
+      : s.length === 2 ? 3
+      : s.length % 8 === 0 ? 0xFB * 2 ** (s.length - 8)
+      : Infinity;
+    this.multiplex = s.multiplex ?? -1;
+  }
+
+  raw(data: Uint8Array, base: number): number {
+    let raw = 0;
+    if (this.littleEndian) {
+      let bit = this.startBit;
+      let remaining = this.length;
+      let weight = 1;
+      while (remaining > 0) {
+        const shift = bit & 7;
+        const take = Math.min(8 - shift, remaining);
+        raw += ((data[base + (bit >> 3)] >> shift) & ((1 << take) - 1)) * weight;
+        weight *= 2 ** take;
+        bit += take;
+        remaining -= take;
+      }
+    } else {
+      // Sawtooth order: MSB first, wrapping to bit 7 of the next byte
+      let bit = this.startBit;
+      for (let i = 0; i < this.length; i++) {
+        raw = raw * 2 + ((data[base + (bit >> 3)] >> (bit & 7)) & 1);
+        bit = (bit & 7) === 0 ? bit + 15 : bit - 1;
+      }
+    }
+    if (this.signed && raw >= 2 ** (this.length - 1)) raw -= 2 ** this.length;
+    return raw;
+  }
+}
+
+function motorolaLastByte(startBit: number, length: number): number {
+  let bit = startBit;
+  for (let i = 1; i < length; i++) bit = (bit & 7) === 0 ? bit + 15 : bit - 1;
+  return bit >> 3;
+}
+
+interface CompiledMessage {
+  sourceAddress: number;  // -1 = any
+  signals: CompiledSignal[];
+  multiplexor: CompiledSignal | null;
+}
+
+export class DbcDecoder implements SignalSource {
+  readonly messages: DbcMessage[];
+  readonly slots: DbcSlot[] = [];
+  readonly values: Float64Array;   // By slot, NaN = not seen / not available
+  readonly updated: Float64Array;  // Last sample time per slot (us, 0 = never)
+  version = 0;                     // Bumped whenever any value changes
+  private readonly pdu2: (CompiledMessage[] | null)[] = new Array(PDU2_COUNT).fill(null);
+  private readonly pdu1: (CompiledMessage[] | null)[] = new Array(PDU1_COUNT).fill(null);
+  private readonly bySlotName = new Map<string, number>();
+  private readonly anySource: boolean;
+
+  constructor(messages: DbcMessage[], options: DbcOptions = {}) {
+    this.messages = messages;
+    this.anySource = options.anySource ?? false;
+
+    for (const message of messages) {
+      const sourceAddress = this.anySource ? -1 : message.sourceAddress;
+      const compiled: CompiledMessage = { sourceAddress, signals: [], multiplexor: null };
+      for (const s of message.signals) {
+        const slot = this.slots.length;
+        const name = `${message.name}.${s.name}`;
+        this.slots.push({ name, message: message.name, signal: s.name, unit: s.unit, sourceAddress });
+        this.bySlotName.set(name, slot);
+        const signal = new CompiledSignal(slot, s);
+        compiled.signals.push(signal);
+        if (s.multiplexor) compiled.multiplexor = signal;
+      }
+
+      const index = this.indexOf(message.pgn);
+      const table = index < PDU2_COUNT ? this.pdu2 : this.pdu1;
+      const i = index < PDU2_COUNT ? index : index - PDU2_COUNT;
+      (table[i] ??= []).push(compiled);
+    }
+
+    // Bare signal names too, where unambiguous
+    const counts = new Map<string, number>();
+    for (const slot of this.slots) counts.set(slot.signal, (counts.get(slot.signal) ?? 0) + 1);
+    this.slots.forEach((slot, i) => {
+      if (counts.get(slot.signal) === 1 && !this.bySlotName.has(slot.signal)) this.bySlotName.set(slot.signal, i);
+    });
+
+    this.values = new Float64Array(this.slots.length).fill(NaN);
+    this.updated = new Float64Array(this.slots.length);
+  }
+
+  // "Message.Signal: reason" for each signal the file has but this decoder skips
+  get skipped(): string[] {
+    return this.messages.flatMap(m => m.skipped.map(reason => `${m.name}.${reason}`));
+  }
+
+  static load(filePath: string, options: DbcOptions = {}): DbcDecoder {
+    return new DbcDecoder(loadDbc(filePath), options);
+  }
+
+  // PGN and source address pairs to receive (sourceAddress -1 = any)
+  get acceptance(): { pgn: number; sourceAddress: number }[] {
+    const seen = new Set<string>();
+    const result: { pgn: number; sourceAddress: number }[] = [];
+    for (const message of this.messages) {
+      const sourceAddress = this.anySource ? -1 : message.sourceAddress;
+      const key = `${message.pgn}:${sourceAddress}`;
+      if (seen.has(key)) continue;
+      seen.add(key);
+      result.push({ pgn: message.pgn, sourceAddress });
+    }
+    return result;
+  }
+
+  // Decode one frame against every matching message. Returns true if any
+  // message matched (whether or not a value changed).
+  decode(canId: number, data: Uint8Array, base: number, len: number, timestamp: number): boolean {
+    const pf = (canId >> 16) & 0xFF;
+    const dp = (canId >> 24) & 0x01;
+    const entries = pf >= 240
+      ? this.pdu2[(dp << 12) | ((canId >> 8) & 0xFFF)]
+      : this.pdu1[(dp << 8) | pf];
+    if (entries === null) return false;
+
+    const sourceAddress = canId & 0xFF;
+    const values = this.values;
+    const updated = this.updated;
+    let matched = false;
+    let changed = false;
+
+    for (let m = 0; m < entries.length; m++) {
+      const message = entries[m];
+      if (message.sourceAddress !== -1 && message.sourceAddress !== sourceAddress) continue;
+      matched = true;
+      const mux = message.multiplexor !== null && message.multiplexor.lastByte < len
+        ? message.multiplexor.raw(data, base)
+        : -1;
+
+      const signals = message.signals;
+      for (let s = 0; s < signals.length; s++) {
+        const signal = signals[s];
+        if (signal.lastByte >= len) continue;
+        if (signal.multiplex !== -1 && signal.multiplex !== mux) continue;
+        const raw = signal.raw(data, base);
+        const value = raw >= signal.invalidFrom ? NaN : raw * signal.factor + signal.offset;
+        updated[signal.slot] = timestamp;
+        const previous = values[signal.slot];
+        if (previous !== value && !(Number.isNaN(value) && Number.isNaN(previous))) {
+          values[signal.slot] = value;
+          changed = true;
+        }
+      }
+    }
+
+    if (changed) this.version++;
+    return matched;
+  }
+
+  // Always current - decode() writes in place
+  sync(): number {
+    return this.version;
+  }
+
+  // Slot of "Message.Signal", or of a bare signal name that is unique
+  slot(name: string): number {
+    const slot = this.bySlotName.get(name);
+    if (slot === undefined) throw new Error(`Unknown DBC signal '${name}'`);
+    return slot;
+  }
+
+  get(name: string): number | undefined {
+    const v = this.values[this.slot(name)];
+    return Number.isNaN(v) ? undefined : v;
+  }
+
+  // Every signal seen so far, by "Message.Signal"
+  snapshot(): Record<string, number> {
+    const data: Record<string, number> = {};
+    this.slots.forEach((slot, i) => {
+      if (!Number.isNaN(this.values[i])) data[slot.name] = this.values[i];
+    });
+    return data;
+  }
+
+  // Table position: PDU2 below PDU2_COUNT, PDU1 above
+  private indexOf(pgn: number): number {
+    const dp = (pgn >> 16) & 0x01;
+    const pf = (pgn >> 8) & 0xFF;
+    return pf >= 240 ? (dp << 12) | (pgn & 0xFFF) : PDU2_COUNT + ((dp << 8) | pf);
+  }
+}
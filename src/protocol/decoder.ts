@@ -0,0 +1,155 @@
+// Decoder for OSSM sensor PGNs
+//
+// Signals, scaling and the per-PGN decode functions are generated from
+// definitions/ossm.json (scripts/gen-signals.js); this module holds the
+// store they decode into.
+import { PDU2_DECODERS, PGN_DESCRIPTORS, SIGNAL, SIGNAL_COUNT } from './signals.generated';
+import type { SensorData } from './signals.generated';
+
+export { PGN, PGN_DESCRIPTORS, SIGNAL, SIGNAL_COUNT } from './signals.generated';
+export type { SensorData } from './signals.generated';
+
+export type SignalName = keyof SensorData;
+
+// Signal names in slot order
+export const SIGNAL_NAMES = Object.keys(SIGNAL) as SignalName[];
+
+export interface SignalField {
+  signal: number;  // SIGNAL slot
+  byte: number;    // Offset of the first byte in the frame
+  width: 1 | 2;    // Field width in bytes (little-endian)
+  scale: number;   // Units per bit
+  offset: number;  // Added after scaling
+  na: number;      // Raw "not available" sentinel
+}
+
+export interface PgnDescriptor {
+  pgn: number;
+  intervalMs: number;  // Assumed broadcast interval (0 = not watched)
+  fields: SignalField[];
+}
+
+// Decodes one PGN's frame at data[base] into the store arrays; returns a
+// bit per SIGNAL slot whose value changed, and sets sampled[0] to a bit per
+// slot the frame carried a value for (skipping not-available and cut-off
+// fields)
+export type FrameDecoder = (
+  values: Float64Array,
+  updated: Float64Array,
+  data: Uint8Array,
+  base: number,
+  len: number,
+  timestamp: number,
+  sampled: Uint32Array
+) => number;
+
+// PGNs the decoders understand
+export const DECODED_PGNS = PGN_DESCRIPTORS.map(d => d.pgn);
+
+// PDU2 PGNs (PF >= 240) occupy 0xF000-0xFFFF, so the table is direct-indexed
+const PDU2_BASE = 0xF000;
+const PDU2_COUNT = 0x1000;
+
+// Read side of a signal store, which may be a mirror of one owned by
+// another thread. sync() brings values/updated up to date and returns the
+// current version.
+export interface SignalSource {
+  readonly values: Float64Array;
+  readonly updated: Float64Array;
+  sync(): number;
+}
+
+// Preallocated, fixed-layout store of decoded signal values (NaN = never seen)
+export class SignalStore implements SignalSource {
+  readonly values = new Float64Array(SIGNAL_COUNT).fill(NaN);
+  readonly updated = new Float64Array(SIGNAL_COUNT);  // Last sample time per signal (us, 0 = never)
+  version = 0;      // Bumped whenever any value changes
+  lastUpdate = 0;   // Time of the most recent decoded frame (us)
+  changedMask = 0;  // Bit per SIGNAL slot changed by the latest decode()
+  sampledMask = 0;  // Bit per SIGNAL slot the latest decode() carried, changed or not
+  private readonly view: SensorData = {};
+  private readonly sampled = new Uint32Array(1);  // Decoder out-parameter
+
+  constructor() {
+    // Give the shared view a stable shape up front
+    for (const name of SIGNAL_NAMES) this.view[name] = undefined;
+  }
+
+  // Decode one frame starting at data[base], sampled at `timestamp` (us).
+  // Returns true only if a known PGN changed a value.
+  decode(
+    pgn: number,
+    data: Uint8Array,
+    base: number = 0,
+    len: number = data.length - base,
+    timestamp: number = 0
+  ): boolean {
+    this.changedMask = 0;
+    this.sampledMask = 0;
+    const index = pgn - PDU2_BASE;
+    if (index < 0 || index >= PDU2_COUNT) return false;
+    const decoder = PDU2_DECODERS[index];
+    if (decoder === null) return false;
+
+    const changed = decoder(this.values, this.updated, data, base, len, timestamp, this.sampled);
+    this.lastUpdate = timestamp;
+    this.changedMask = changed;
+    this.sampledMask = this.sampled[0];
+    if (changed === 0) return false;
+    this.version++;
+    return true;
+  }
+
+  // True if `pgn` is one the decoder table handles
+  decodes(pgn: number): boolean {
+    const index = pgn - PDU2_BASE;
+    return index >= 0 && index < PDU2_COUNT && PDU2_DECODERS[index] !== null;
+  }
+
+  // Always current - decode() writes in place
+  sync(): number {
+    return this.version;
+  }
+
+  get(signal: number): number {
+    return this.values[signal];
+  }
+
+  // Microseconds since `signal` was last sampled, relative to `now` (us).
+  // Infinity if it has never been seen.
+  age(signal: number, now: number = Date.now() * 1000): number {
+    const t = this.updated[signal];
+    return t === 0 ? Infinity : now - t;
+  }
+
+  // Last sample time of every signal seen so far (us since the epoch)
+  timestamps(): Partial<Record<SignalName, number>> {
+    const times: Partial<Record<SignalName, number>> = {};
+    for (let i = 0; i < SIGNAL_COUNT; i++) {
+      if (this.updated[i] !== 0) times[SIGNAL_NAMES[i]] = this.updated[i];
+    }
+    return times;
+  }
+
+  // Shared SensorData view, refreshed in place (valid until the next call)
+  sensorData(): SensorData {
+    const view = this.view;
+    const values = this.values;
+    for (let i = 0; i < SIGNAL_COUNT; i++) {
+      const v = values[i];
+      view[SIGNAL_NAMES[i]] = Number.isNaN(v) ? undefined : v;
+    }
+    return view;
+  }
+
+  // Independent copy containing only signals that have been seen
+  snapshot(): SensorData {
+    const data: SensorData = {};
+    const values = this.values;
+    for (let i = 0; i < SIGNAL_COUNT; i++) {
+      const v = values[i];
+      if (!Number.isNaN(v)) data[SIGNAL_NAMES[i]] = v;
+    }
+    return data;
+  }
+}
@@ -1,22 +1,23 @@
 // J1939 protocol encoding/decoding for OSSM communication
-import { CanBus, CanFrame } from '../can/socketcan';
+import { CanFilter, CanFrame, CanTransport, FrameBatch, CAN_EFF_FLAG } from '../can/socketcan';
+import { Histogram, MetricsSnapshot } from '../metrics/metrics';
+import { GLOBAL_ADDRESS, NULL_ADDRESS, PGN_ADDRESS_CLAIM, PGN_REQUEST, addressClaimRequest, readName } from './address-claim';
+import { CommandOptions, CommandQueue, CommandQueueOptions, DeviceUnreachableError, TransmitOptions } from './command-queue';
+import type { DbcDecoder } from './dbc';
+import { DECODED_PGNS, SensorData, SignalName, SignalSource, SignalStore } from './decoder';
+import { SignalSubscriptions, SignalUpdate, SubscribeOptions } from './subscriptions';
+import { PGN_TP_CM, PGN_TP_DT, TP_MAX_SIZE, TP_MIN_SIZE, TransportProtocol } from './transport';
+import { PgnHealth, PgnWatchdog, WatchdogOptions } from './watchdog';
+
+export { PGN, SIGNAL } from './decoder';
+export type { SensorData, SignalName, SignalSource } from './decoder';
+export { DeviceUnreachableError } from './command-queue';
+export type { CommandOptions } from './command-queue';
 
 // OSSM proprietary PGNs
 const PGN_COMMAND = 65280;   // 0xFF00 - Commands TO OSSM
 const PGN_RESPONSE = 65281;  // 0xFF01 - Responses FROM OSSM
 
-// Standard J1939 PGNs for sensor data
-export const PGN = {
-  ENGINE_TEMP_1: 65262,      // 0xFEEE - Coolant, fuel, oil temps
-  ENGINE_FLUID_PRESS: 65263, // 0xFEEF - Fuel, oil, coolant pressures
-  AMBIENT_COND: 65269,       // 0xFEF5 - Baro, ambient temp
-  INLET_EXHAUST: 65270,      // 0xFEF6 - Air inlet, EGT, boost
-  ENGINE_TEMP_2: 65129,      // 0xFE69 - Additional temps
-  TURBO_INFO_1: 65189,       // 0xFEA5 - Turbo temps
-  TURBO_INFO_2: 65190,       // 0xFEA6 - Turbo pressures
-  EEC6: 65164,               // 0xFE8C - Engine bay temp, humidity
-};
-
 // Command IDs
 export const CMD = {
   ENABLE_SPN: 1,
@@ -27,66 +28,417 @@ export const CMD = {
   RESET: 7,
   NTC_PRESET: 8,
   PRESSURE_PRESET: 9,
+  FW_BEGIN: 10,  // Bootloader: erase for an image of <size u32>, via TP
+  FW_DATA: 11,   // Bootloader: <offset u32> + FW_BLOCK_MIN to FW_BLOCK_MAX bytes, via TP
+  FW_END: 12,    // Bootloader: check the whole image against <crc32 u32>, then activate, via TP
+};
+
+// FW_DATA payload limits: one TP message less the command byte and offset.
+// Anything shorter would go out as a single broadcast frame.
+export const FW_BLOCK_MIN = TP_MIN_SIZE - 5;
+export const FW_BLOCK_MAX = TP_MAX_SIZE - 5;
+
+// QUERY sections: each is returned as one (multi-packet) response.
+// Firmware contract pending - see config/readback.ts.
+export const QUERY_SECTION = {
+  CONFIG: 0,     // TC type, NTC and pressure presets
+  SPN_TABLE: 1,  // Enabled SPNs and their inputs
 };
 
 // Default OSSM source address
-const OSSM_SOURCE_ADDRESS = 149;  // 0x95
-
-export interface SensorData {
-  // Temperatures (Celsius)
-  coolantTemp?: number;
-  fuelTemp?: number;
-  oilTemp?: number;
-  ambientTemp?: number;
-  airInletTemp?: number;
-  egtTemp?: number;
-  boostTemp?: number;
-  cacInletTemp?: number;
-  transferPipeTemp?: number;
-  engineBayTemp?: number;
-
-  // Pressures (kPa)
-  oilPressure?: number;
-  fuelPressure?: number;
-  coolantPressure?: number;
-  boostPressure?: number;
-  airInletPressure?: number;
-  cacInletPressure?: number;
-
-  // Ambient
-  barometricPressure?: number;
-  humidity?: number;
+export const OSSM_SOURCE_ADDRESS = 149;  // 0x95
+
+// Source address this tool transmits from
+const TOOL_ADDRESS = 0xFE;
+
+const IDENTIFY_TIMEOUT_MS = 250;
+const PROBE_TIMEOUT_MS = 300;
+const CENSUS_MS = 500;  // Long enough for a multi-packet QUERY reply
+
+export interface J1939ProtocolOptions extends CommandQueueOptions {
+  address?: number;       // Source address of the target OSSM (default 0x95)
+  localAddress?: number;  // Our source address (default 0xFE)
+  discover?: boolean;     // Accept every node that claims an address (see requestAddressClaims)
+  dbc?: DbcDecoder;       // Also decode the messages of a DBC file (see setDbc)
+  watchdog?: WatchdogOptions;
 }
 
-export class J1939Protocol {
-  private can: CanBus;
-  private responseResolve: ((data: Buffer) => void) | null = null;
-  private sensorData: SensorData = {};
-  private sensorHandler: ((data: SensorData) => void) | null = null;
+// One module on the bus, looked up by source address. Each has its own
+// decoded signals; commands go to the protocol's current target only.
+export interface OssmNode {
+  readonly address: number;
+  name: bigint | null;   // J1939 NAME from its address claim, if seen
+  readonly signals: SignalStore;
+  readonly subscriptions: SignalSubscriptions;
+  lastSeen: number;      // Receive time of its latest frame (us, 0 = never)
+}
+
+// Source addresses and PGNs to receive; everything else is filtered in the kernel
+export interface Acceptance {
+  sourceAddresses: number[];
+  pgns: number[];
+}
+
+// Kernel filter matching one J1939 PGN, optionally from one source address.
+// Priority bits are ignored; PDU1 PGNs match any destination address.
+export function j1939Filter(pgn: number, sourceAddr?: number): CanFilter {
+  const pf = (pgn >> 8) & 0xFF;
+  const pgnMask = pf >= 240 ? 0x3FFFF : 0x3FF00;
+  return {
+    id: CAN_EFF_FLAG | ((pgn & pgnMask) << 8) | (sourceAddr ?? 0),
+    mask: CAN_EFF_FLAG | (pgnMask << 8) | (sourceAddr !== undefined ? 0xFF : 0),
+  };
+}
+
+// An OSSM response frame, or the TP.CM RTS/BAM that announces a long one
+function isResponse(pgn: number, data: Uint8Array, base: number, dlc: number): boolean {
+  if (pgn === PGN_RESPONSE) return true;
+  if (pgn !== PGN_TP_CM || dlc < 8 || (data[base] !== 16 && data[base] !== 32)) return false;
+  return (data[base + 5] | (data[base + 6] << 8) | (data[base + 7] << 16)) === PGN_RESPONSE;
+}
 
-  constructor(can: CanBus) {
+// Command API of one OSSM, implemented directly by J1939Protocol and by
+// the ingest worker client (src/ingest) when the protocol runs off-thread
+export interface OssmDevice {
+  enableSpn(spn: number, enable: boolean, input?: number, options?: CommandOptions): Promise<boolean>;
+  setNtcPreset(input: number, preset: number, options?: CommandOptions): Promise<boolean>;
+  setPressurePreset(input: number, preset: number, options?: CommandOptions): Promise<boolean>;
+  setThermocoupleType(tcType: number, options?: CommandOptions): Promise<boolean>;
+  query(options?: CommandOptions): Promise<Buffer>;
+  querySection(section: number, options?: CommandOptions): Promise<Buffer>;
+  save(options?: CommandOptions): Promise<boolean>;
+  reset(options?: CommandOptions): Promise<boolean>;
+  getSignalStore(): SignalSource;
+  getMetrics(): MetricsSnapshot | Promise<MetricsSnapshot>;
+  identify(timeoutMs?: number): Promise<bigint | null>;
+}
+
+export class J1939Protocol implements OssmDevice {
+  private can: CanTransport;
+  private readonly commands: CommandQueue;
+  private readonly nodes: (OssmNode | undefined)[] = new Array(256);  // By source address
+  private target: OssmNode;
+  private readonly sensorHandlers: ((data: SensorData) => void)[] = [];
+  private readonly changeHandlers: ((signals: SignalStore, changedMask: number, timestamp: number) => void)[] = [];
+  private readonly decodeHandlers: ((signals: SignalStore, timestamp: number) => void)[] = [];
+  private readonly nodeHandlers: ((node: OssmNode) => void)[] = [];
+  private acceptance: Acceptance;
+  private readonly acceptedSa = new Uint8Array(256);  // 1 = process frames from this SA
+  private readonly discover: boolean;
+  private dbc: DbcDecoder | null;
+  private readonly batchListener = this.handleBatch.bind(this);
+  private readonly transport: TransportProtocol;
+  private readonly counts = { framesProcessed: 0, droppedBySource: 0, unknownPgn: 0, framesDecoded: 0, dbcDecoded: 0 };
+  private readonly decodeBatch = new Histogram();
+  private readonly watchdog: PgnWatchdog;
+  private answered: Set<number> | null = null;  // Census in progress (see census)
+  readonly localAddress: number;
+
+  constructor(can: CanTransport, options: J1939ProtocolOptions = {}) {
     this.can = can;
-    this.can.onMessage(this.handleFrame.bind(this));
+    this.target = this.node(options.address ?? OSSM_SOURCE_ADDRESS);
+    this.localAddress = options.localAddress ?? TOOL_ADDRESS;
+    this.discover = options.discover ?? false;
+    this.dbc = options.dbc ?? null;
+    this.watchdog = new PgnWatchdog(options.watchdog);
+    this.acceptance = {
+      sourceAddresses: [this.address],
+      pgns: [PGN_RESPONSE, PGN_TP_CM, PGN_TP_DT, PGN_ADDRESS_CLAIM, ...DECODED_PGNS],
+    };
+    this.transport = new TransportProtocol({
+      localAddress: this.localAddress,
+      transmit: (id, data) => this.can.send({ id, data, ext: true }),
+      // CTS windows of data packets queue behind commands
+      transmitBatch: frames => this.can.sendBatch(frames.map(f => ({ id: f.canId, data: f.data, ext: true })), 'bulk'),
+      onMessage: (pgn, source, data, timestamp) => this.handleMessage(pgn, source, data, timestamp),
+    });
+    this.commands = new CommandQueue((frame, tx) => this.transmitCommand(frame, tx), options);
+    this.can.onBatch(this.batchListener);
+    this.applyAcceptance();
+    if (this.discover) this.requestAddressClaims();
+  }
+
+  // Source address of the OSSM that commands go to
+  get address(): number {
+    return this.target.address;
+  }
+
+  // Point commands (and onSensorData/subscribe) at another node on the
+  // same bus. Commands still go out on the broadcast command PGN, which
+  // every OSSM acts on, with replies matched to the target by source
+  // address only; see census() before commanding a bus with several.
+  setTarget(address: number): void {
+    if (this.commands.pending > 0) throw new Error('Cannot change target with commands pending');
+    this.target = this.node(address);
+    if (this.acceptedSa[this.target.address] === 0) {
+      this.setAcceptance({ sourceAddresses: [...this.acceptance.sourceAddresses, this.target.address] });
+    }
+  }
+
+  // Nodes seen so far, by address
+  getNodes(): OssmNode[] {
+    return this.nodes.filter((node): node is OssmNode => node !== undefined);
+  }
+
+  getNode(address: number): OssmNode | undefined {
+    return this.nodes[address & 0xFF];
+  }
+
+  // Called for each node added by an address claim. Returns an unsubscribe function.
+  onNode(handler: (node: OssmNode) => void): () => void {
+    this.nodeHandlers.push(handler);
+    return () => {
+      const i = this.nodeHandlers.indexOf(handler);
+      if (i >= 0) this.nodeHandlers.splice(i, 1);
+    };
+  }
+
+  // Ask every node (or just `destination`) to announce its address and NAME
+  requestAddressClaims(destination: number = GLOBAL_ADDRESS): void {
+    this.can.send({ id: this.buildCanId(PGN_REQUEST | destination), data: addressClaimRequest(), ext: true });
   }
 
-  private handleFrame(frame: CanFrame): void {
+  // Addresses of every OSSM that answers one broadcast QUERY within
+  // `windowMs`. OSSM firmware takes commands on a broadcast PGN with no
+  // destination, so this is how to tell whether a command meant for the
+  // target would reach other modules as well. Needs an idle command queue.
+  async census(windowMs: number = CENSUS_MS): Promise<number[]> {
+    if (this.commands.pending > 0) throw new Error('Cannot take a census with commands pending');
+    const answered = this.answered = new Set<number>();
+    this.applyAcceptance();
+    try {
+      const query = Buffer.alloc(8, 0xFF);
+      query[0] = CMD.QUERY;
+      await this.transmitCommand(query);
+      await new Promise(resolve => setTimeout(resolve, windowMs));
+    } finally {
+      this.answered = null;
+      this.applyAcceptance();
+    }
+    return [...answered].sort((a, b) => a - b);
+  }
+
+  // The target's J1939 NAME, asking for its address claim if not yet seen.
+  // Null when it does not answer within `timeoutMs`.
+  async identify(timeoutMs: number = IDENTIFY_TIMEOUT_MS): Promise<bigint | null> {
+    const target = this.target;
+    if (target.name !== null) return target.name;
+
+    return new Promise(resolve => {
+      const timer = setTimeout(() => {
+        unsubscribe();
+        resolve(target.name);
+      }, timeoutMs);
+      const unsubscribe = this.onNode(node => {
+        if (node.address !== target.address) return;
+        clearTimeout(timer);
+        unsubscribe();
+        resolve(node.name);
+      });
+      this.requestAddressClaims(target.address);
+    });
+  }
+
+  private node(address: number): OssmNode {
+    const sa = address & 0xFF;
+    return this.nodes[sa] ??= {
+      address: sa,
+      name: null,
+      signals: new SignalStore(),
+      subscriptions: new SignalSubscriptions(),
+      lastSeen: 0,
+    };
+  }
+
+  // Detach from the bus, failing anything still queued
+  close(): void {
+    this.commands.cancelAll(new Error('Protocol closed'));
+    this.transport.close();
+    this.watchdog.close();
+    this.can.removeHandler(this.batchListener);
+    this.can.clearFilters(this);
+  }
+
+  // Decode the messages of a DBC file in the same pass as OSSM frames,
+  // from whichever source addresses it names (null to stop)
+  setDbc(dbc: DbcDecoder | null): void {
+    this.dbc = dbc;
+    this.applyAcceptance();
+  }
+
+  getDbc(): DbcDecoder | null {
+    return this.dbc;
+  }
+
+  // Change the source addresses and/or PGNs received from the bus.
+  // Takes effect immediately, including the kernel-side CAN filters.
+  setAcceptance(acceptance: Partial<Acceptance>): void {
+    this.acceptance = {
+      sourceAddresses: acceptance.sourceAddresses ?? this.acceptance.sourceAddresses,
+      pgns: acceptance.pgns ?? this.acceptance.pgns,
+    };
+    this.applyAcceptance();
+  }
+
+  getAcceptance(): Acceptance {
+    return {
+      sourceAddresses: [...this.acceptance.sourceAddresses],
+      pgns: [...this.acceptance.pgns],
+    };
+  }
+
+  private applyAcceptance(): void {
+    const { sourceAddresses, pgns } = this.acceptance;
+    this.acceptedSa.fill(0);
+    for (const sa of sourceAddresses) {
+      this.acceptedSa[sa & 0xFF] = 1;
+      this.node(sa);
+    }
+
+    const filters: CanFilter[] = [];
+    for (const sa of sourceAddresses) {
+      for (const pgn of pgns) filters.push(j1939Filter(pgn, sa));
+    }
+    if (this.discover) filters.push(j1939Filter(PGN_ADDRESS_CLAIM));
+    if (this.answered) filters.push(j1939Filter(PGN_RESPONSE), j1939Filter(PGN_TP_CM));
+    for (const { pgn, sourceAddress } of this.dbc?.acceptance ?? []) {
+      filters.push(j1939Filter(pgn, sourceAddress < 0 ? undefined : sourceAddress));
+    }
+    this.can.setFilters(filters, this);
+  }
+
+  // Process a packed batch of received frames without per-frame allocation
+  handleBatch(batch: FrameBatch): void {
+    const started = performance.now();
+    const { ids, ext, dlcs, data, timestamps } = batch;
+    for (let i = 0; i < batch.count; i++) {
+      if (ext[i] === 1) this.processFrame(ids[i], data, i * 8, dlcs[i], timestamps[i]);
+    }
+    this.counts.framesProcessed += batch.count;
+    this.decodeBatch.record((performance.now() - started) * 1000);
+  }
+
+  handleFrame(frame: CanFrame): void {
+    this.counts.framesProcessed++;
     if (!frame.ext) return;  // J1939 uses extended IDs
+    this.processFrame(frame.id, frame.data, 0, frame.data.length, frame.timestamp ?? Date.now() * 1000);
+  }
 
-    const pgn = this.extractPgn(frame.id);
-    const sourceAddr = frame.id & 0xFF;
+  // Counters for the bus, this protocol instance and its command queue
+  getMetrics(): MetricsSnapshot {
+    return {
+      bus: this.can.getMetrics(),
+      protocol: { ...this.counts, decodeBatch: this.decodeBatch.snapshot() },
+      commands: this.commands.getMetrics(),
+      pgns: this.watchdog.health(this.address),
+    };
+  }
 
-    // Only process frames from OSSM
-    if (sourceAddr !== OSSM_SOURCE_ADDRESS) return;
+  // Broadcast health of each PGN seen from a node (see watchdog.ts)
+  getHealth(address: number = this.address): PgnHealth[] {
+    return this.watchdog.health(address);
+  }
+
+  // Bit per SIGNAL slot of a node whose PGNs have all gone quiet
+  getStaleSignals(address: number = this.address): number {
+    return this.watchdog.staleMask(address);
+  }
+
+  // Called when a PGN from an accepted node goes stale or comes back.
+  // Returns an unsubscribe function.
+  onStale(handler: (health: PgnHealth) => void): () => void {
+    return this.watchdog.onStale(handler);
+  }
+
+  private processFrame(canId: number, data: Uint8Array, base: number, dlc: number, timestamp: number): void {
+    const pgn = this.extractPgn(canId);
+    const sourceAddr = canId & 0xFF;
+
+    // Claims are taken from any address when discovering
+    if (pgn === PGN_ADDRESS_CLAIM && (this.discover || this.acceptedSa[sourceAddr] === 1)) {
+      this.handleAddressClaim(sourceAddr, data, base, dlc);
+      return;
+    }
+
+    // Replies to a census QUERY, single-frame or announced by TP.CM
+    if (this.answered !== null && isResponse(pgn, data, base, dlc)) this.answered.add(sourceAddr);
+
+    // DBC messages, wherever they come from
+    const dbcMatched = this.dbc !== null && this.dbc.decode(canId, data, base, dlc, timestamp);
+    if (dbcMatched) this.counts.dbcDecoded++;
+
+    // Only process frames from OSSM (backs up the kernel filter)
+    if (this.acceptedSa[sourceAddr] === 0) {
+      if (!dbcMatched) this.counts.droppedBySource++;
+      return;
+    }
+    const node = this.node(sourceAddr);
+    node.lastSeen = timestamp;
+
+    // Multi-packet transfers (reassembled messages come back via handleMessage)
+    if (pgn === PGN_TP_CM || pgn === PGN_TP_DT) {
+      this.transport.handleFrame(pgn, sourceAddr, (canId >> 8) & 0xFF, data, base, dlc, timestamp);
+      return;
+    }
 
     // Handle command response
-    if (pgn === PGN_RESPONSE && this.responseResolve) {
-      this.responseResolve(frame.data);
-      this.responseResolve = null;
+    if (pgn === PGN_RESPONSE) {
+      if (sourceAddr !== this.address) return;
+      this.commands.handleResponse(Buffer.from(data.subarray(base, base + dlc)));
       return;
     }
 
     // Handle sensor data PGNs
-    this.decodeSensorData(pgn, frame.data);
+    if (dbcMatched && !node.signals.decodes(pgn)) return;
+    this.decodeSensorData(node, pgn, data, base, dlc, timestamp);
+  }
+
+  private handleAddressClaim(sourceAddr: number, data: Uint8Array, base: number, dlc: number): void {
+    if (dlc < 8 || sourceAddr === NULL_ADDRESS || sourceAddr === this.localAddress) return;
+    const name = readName(data, base);
+
+    // A node that re-claimed elsewhere leaves its old address free
+    for (const node of this.nodes) {
+      if (node && node.name === name && node.address !== sourceAddr && node !== this.target) {
+        this.nodes[node.address] = undefined;
+      }
+    }
+
+    const previous = this.nodes[sourceAddr];
+    if (previous?.name === name) return;  // Already known
+    if (previous && previous.name !== null && previous !== this.target) {
+      // A different device now holds this address; start it afresh
+      this.nodes[sourceAddr] = undefined;
+    }
+    const node = this.node(sourceAddr);
+    node.name = name;
+
+    if (this.acceptedSa[sourceAddr] === 0) {
+      this.setAcceptance({ sourceAddresses: [...this.acceptance.sourceAddresses, sourceAddr] });
+    }
+    for (const handler of this.nodeHandlers) handler(node);
+  }
+
+  // A complete message reassembled by the transport protocol
+  private handleMessage(pgn: number, sourceAddr: number, data: Buffer, timestamp: number): void {
+    if (pgn === PGN_RESPONSE) {
+      if (sourceAddr === this.address) this.commands.handleResponse(Buffer.from(data));
+      return;
+    }
+    const node = this.nodes[sourceAddr];
+    if (node) this.decodeSensorData(node, pgn, data, 0, data.length, timestamp);
+  }
+
+  // Single-frame commands go straight out, or are withdrawn if they wait
+  // longer than the command may; longer ones use TP (RTS/CTS)
+  private transmitCommand(frame: Buffer, tx?: TransmitOptions): Promise<void> {
+    if (frame.length <= 8) {
+      return new Promise((resolve, reject) => {
+        this.can.send({ id: this.buildCanId(PGN_COMMAND), data: frame, ext: true }, 'control',
+          { ...tx, onDone: err => (err ? reject(err) : resolve()) });
+      });
+    }
+    return this.transport.send(PGN_COMMAND, this.address, frame);
   }
 
   private extractPgn(canId: number): number {
@@ -103,151 +455,192 @@ export class J1939Protocol {
     }
   }
 
-  private buildCanId(pgn: number, sourceAddr: number = 0xFE, priority: number = 6): number {
+  private buildCanId(pgn: number, sourceAddr: number = this.localAddress, priority: number = 6): number {
     // Build 29-bit J1939 CAN ID
     return (priority << 26) | (pgn << 8) | sourceAddr;
   }
 
-  private decodeSensorData(pgn: number, data: Buffer): void {
-    switch (pgn) {
-      case PGN.ENGINE_TEMP_1:
-        // Byte 0: Coolant temp (offset -40)
-        // Byte 2: Fuel temp (offset -40)
-        // Byte 3: Oil temp (offset -40)
-        if (data[0] !== 0xFF) this.sensorData.coolantTemp = data[0] - 40;
-        if (data[2] !== 0xFF) this.sensorData.fuelTemp = data[2] - 40;
-        if (data[3] !== 0xFF) this.sensorData.oilTemp = data[3] - 40;
-        break;
-
-      case PGN.ENGINE_FLUID_PRESS:
-        // Byte 0-1: Fuel delivery pressure (4 kPa/bit)
-        // Byte 3: Oil pressure (4 kPa/bit)
-        // Byte 4: Coolant pressure (2 kPa/bit)
-        if (data[3] !== 0xFF) this.sensorData.oilPressure = data[3] * 4;
-        if (data[4] !== 0xFF) this.sensorData.coolantPressure = data[4] * 2;
-        const fuelPress = data[0] | (data[1] << 8);
-        if (fuelPress !== 0xFFFF) this.sensorData.fuelPressure = fuelPress * 4;
-        break;
-
-      case PGN.AMBIENT_COND:
-        // Byte 0: Barometric pressure (0.5 kPa/bit)
-        // Byte 3-4: Ambient temp (0.03125 C/bit, offset -273)
-        if (data[0] !== 0xFF) this.sensorData.barometricPressure = data[0] * 0.5;
-        const ambientRaw = data[3] | (data[4] << 8);
-        if (ambientRaw !== 0xFFFF) this.sensorData.ambientTemp = ambientRaw * 0.03125 - 273;
-        break;
-
-      case PGN.INLET_EXHAUST:
-        // Byte 1: Boost pressure (2 kPa/bit)
-        // Byte 2-3: EGT (0.03125 C/bit, offset -273)
-        // Byte 4: Air inlet temp (offset -40)
-        // Byte 5: Air inlet pressure (2 kPa/bit)
-        if (data[1] !== 0xFF) this.sensorData.boostPressure = data[1] * 2;
-        if (data[4] !== 0xFF) this.sensorData.airInletTemp = data[4] - 40;
-        if (data[5] !== 0xFF) this.sensorData.airInletPressure = data[5] * 2;
-        const egtRaw = data[2] | (data[3] << 8);
-        if (egtRaw !== 0xFFFF) this.sensorData.egtTemp = egtRaw * 0.03125 - 273;
-        break;
-
-      case PGN.ENGINE_TEMP_2:
-        // Byte 0-1: Boost temp (0.03125 C/bit, offset -273)
-        const boostTempRaw = data[0] | (data[1] << 8);
-        if (boostTempRaw !== 0xFFFF) this.sensorData.boostTemp = boostTempRaw * 0.03125 - 273;
-        break;
-
-      case PGN.TURBO_INFO_1:
-        // Byte 0: CAC inlet temp (offset -40)
-        // Byte 1: Transfer pipe temp (offset -40)
-        // Byte 2: Engine bay temp (offset -40)
-        if (data[0] !== 0xFF) this.sensorData.cacInletTemp = data[0] - 40;
-        if (data[1] !== 0xFF) this.sensorData.transferPipeTemp = data[1] - 40;
-        if (data[2] !== 0xFF) this.sensorData.engineBayTemp = data[2] - 40;
-        break;
-
-      case PGN.TURBO_INFO_2:
-        // Byte 2: CAC inlet pressure (2 kPa/bit)
-        if (data[2] !== 0xFF) this.sensorData.cacInletPressure = data[2] * 2;
-        break;
-
-      case PGN.EEC6:
-        // Byte 0: Engine bay temp (offset -40)
-        // Byte 6: Humidity (0.5%/bit)
-        if (data[0] !== 0xFF) this.sensorData.engineBayTemp = data[0] - 40;
-        if (data[6] !== 0xFF) this.sensorData.humidity = data[6] * 0.5;
-        break;
-    }
-
-    // Notify listener
-    if (this.sensorHandler) {
-      this.sensorHandler(this.sensorData);
-    }
-  }
-
-  onSensorData(handler: (data: SensorData) => void): void {
-    this.sensorHandler = handler;
-  }
-
-  getSensorData(): SensorData {
-    return { ...this.sensorData };
-  }
-
-  private async sendCommand(cmdId: number, data: number[] = []): Promise<Buffer> {
-    const buf = Buffer.alloc(8, 0xFF);
-    buf[0] = cmdId;
-    data.forEach((byte, i) => {
-      if (i < 7) buf[i + 1] = byte;
-    });
+  private decodeSensorData(
+    node: OssmNode,
+    pgn: number,
+    data: Uint8Array,
+    base: number,
+    dlc: number,
+    timestamp: number
+  ): void {
+    const signals = node.signals;
+    if (!signals.decodes(pgn)) {
+      this.counts.unknownPgn++;
+      return;
+    }
+    this.counts.framesDecoded++;
+    this.watchdog.seen(node.address, pgn, timestamp);
+
+    const changed = signals.decode(pgn, data, base, dlc, timestamp);
+    const target = node === this.target;
+    if (target) for (const handler of this.decodeHandlers) handler(signals, timestamp);
+
+    // Only notify the rest when a known PGN actually changed a value
+    if (!changed) return;
+    node.subscriptions.dispatch(signals, signals.changedMask, timestamp);
+    if (!target) return;
+    for (const handler of this.changeHandlers) handler(signals, signals.changedMask, timestamp);
+    if (this.sensorHandlers.length > 0) {
+      const snapshot = signals.sensorData();
+      for (const handler of this.sensorHandlers) handler(snapshot);
+    }
+  }
 
-    const canId = this.buildCanId(PGN_COMMAND);
+  // Called with every signal of the target whenever any of them changes.
+  // Returns an unsubscribe function.
+  onSensorData(handler: (data: SensorData) => void): () => void {
+    this.sensorHandlers.push(handler);
+    return () => {
+      const i = this.sensorHandlers.indexOf(handler);
+      if (i >= 0) this.sensorHandlers.splice(i, 1);
+    };
+  }
 
-    return new Promise((resolve, reject) => {
-      const timeout = setTimeout(() => {
-        this.responseResolve = null;
-        reject(new Error('No response from OSSM - check connection'));
-      }, 2000);
+  // Called with the target's live store and the mask of changed signals
+  // (one bit per SIGNAL slot) on every decode that changed a value, before
+  // onSensorData handlers. Returns an unsubscribe function.
+  onSignalChange(handler: (signals: SignalStore, changedMask: number, timestamp: number) => void): () => void {
+    this.changeHandlers.push(handler);
+    return () => {
+      const i = this.changeHandlers.indexOf(handler);
+      if (i >= 0) this.changeHandlers.splice(i, 1);
+    };
+  }
 
-      this.responseResolve = (responseData) => {
-        clearTimeout(timeout);
-        resolve(responseData);
-      };
+  // Called with the target's live store on every decoded frame, changed or
+  // not; its changedMask and sampledMask describe the frame. Runs before
+  // the change handlers. Returns an unsubscribe function.
+  onDecode(handler: (signals: SignalStore, timestamp: number) => void): () => void {
+    this.decodeHandlers.push(handler);
+    return () => {
+      const i = this.decodeHandlers.indexOf(handler);
+      if (i >= 0) this.decodeHandlers.splice(i, 1);
+    };
+  }
 
-      this.can.send({ id: canId, data: buf, ext: true });
-    });
+  // Called only when the given signal(s) change, optionally with a deadband
+  // and a minimum reporting interval. Returns an unsubscribe function.
+  subscribe(
+    signals: SignalName | SignalName[],
+    handler: (update: SignalUpdate) => void,
+    options?: SubscribeOptions
+  ): () => void {
+    return this.target.subscriptions.subscribe(signals, handler, options);
+  }
+
+  getSensorData(address: number = this.address): SensorData {
+    return this.node(address).signals.snapshot();
+  }
+
+  // When each signal was last sampled (kernel receive time, us since the epoch)
+  getSensorTimestamps(address: number = this.address): Partial<Record<SignalName, number>> {
+    return this.node(address).signals.timestamps();
+  }
+
+  // Live decoded signal store, for consumers that poll without copying
+  getSignalStore(address: number = this.address): SignalStore {
+    return this.node(address).signals;
   }
 
-  async enableSpn(spn: number, enable: boolean, input: number = 0): Promise<boolean> {
+  // Queue a command; several may be in flight at once (see CommandQueue).
+  // Up to 7 data bytes fit one frame (padded with 0xFF); more go out via TP.
+  private sendCommand(cmdId: number, data: ArrayLike<number> = [], options?: CommandOptions): Promise<Buffer> {
+    const buf = Buffer.alloc(Math.max(8, data.length + 1), 0xFF);
+    buf[0] = cmdId;
+    buf.set(data, 1);
+
+    return this.commands.enqueue(buf, options);
+  }
+
+  async enableSpn(spn: number, enable: boolean, input: number = 0, options?: CommandOptions): Promise<boolean> {
     const spnHi = (spn >> 8) & 0xFF;
     const spnLo = spn & 0xFF;
-    const response = await this.sendCommand(CMD.ENABLE_SPN, [spnHi, spnLo, enable ? 1 : 0, input]);
+    const response = await this.sendCommand(CMD.ENABLE_SPN, [spnHi, spnLo, enable ? 1 : 0, input], options);
     return response[0] === 0;  // 0 = OK
   }
 
-  async setNtcPreset(input: number, preset: number): Promise<boolean> {
-    const response = await this.sendCommand(CMD.NTC_PRESET, [input, preset]);
+  async setNtcPreset(input: number, preset: number, options?: CommandOptions): Promise<boolean> {
+    const response = await this.sendCommand(CMD.NTC_PRESET, [input, preset], options);
     return response[0] === 0;
   }
 
-  async setPressurePreset(input: number, preset: number): Promise<boolean> {
-    const response = await this.sendCommand(CMD.PRESSURE_PRESET, [input, preset]);
+  async setPressurePreset(input: number, preset: number, options?: CommandOptions): Promise<boolean> {
+    const response = await this.sendCommand(CMD.PRESSURE_PRESET, [input, preset], options);
     return response[0] === 0;
   }
 
-  async setThermocoupleType(tcType: number): Promise<boolean> {
-    const response = await this.sendCommand(CMD.SET_TC_TYPE, [tcType]);
+  async setThermocoupleType(tcType: number, options?: CommandOptions): Promise<boolean> {
+    const response = await this.sendCommand(CMD.SET_TC_TYPE, [tcType], options);
     return response[0] === 0;
   }
 
-  async query(): Promise<Buffer> {
-    return this.sendCommand(CMD.QUERY);
+  async query(options?: CommandOptions): Promise<Buffer> {
+    return this.sendCommand(CMD.QUERY, [], options);
   }
 
-  async save(): Promise<boolean> {
-    const response = await this.sendCommand(CMD.SAVE);
+  // Read one configuration section; the module answers with a single
+  // response, using a TP transfer when it exceeds one frame
+  async querySection(section: number, options?: CommandOptions): Promise<Buffer> {
+    // Multi-packet replies take far longer than a round trip; not adaptive
+    return this.sendCommand(CMD.QUERY, [section], { timeoutMs: this.commands.timeoutMs, ...options });
+  }
+
+  // EEPROM writes, likewise on a fixed timeout. SAVE and RESET are never
+  // resent, as the module may have acted on a copy whose reply was lost.
+  async save(options?: CommandOptions): Promise<boolean> {
+    const response = await this.sendCommand(CMD.SAVE, [], { timeoutMs: this.commands.timeoutMs, ...options, idempotent: false });
     return response[0] === 0;
   }
 
-  async reset(): Promise<boolean> {
-    const response = await this.sendCommand(CMD.RESET);
+  async reset(options?: CommandOptions): Promise<boolean> {
+    const response = await this.sendCommand(CMD.RESET, [], { timeoutMs: this.commands.timeoutMs, ...options, idempotent: false });
     return response[0] === 0;
   }
+
+  // Firmware update (see src/provision/firmware.ts). Each resolves to the
+  // bootloader's status byte, 0 = OK. Every step is long enough to go as a
+  // TP message to the target alone: the single-frame command PGN is
+  // broadcast, and every module on the bus would erase or activate.
+  async beginFirmware(size: number, options?: CommandOptions): Promise<number> {
+    const data = Buffer.alloc(TP_MIN_SIZE - 1, 0xFF);  // 4 reserved bytes
+    data.writeUInt32LE(size);
+    return (await this.sendCommand(CMD.FW_BEGIN, data, options))[0];
+  }
+
+  async writeFirmware(offset: number, block: Uint8Array, options?: CommandOptions): Promise<number> {
+    if (block.length > FW_BLOCK_MAX) throw new RangeError(`Firmware block exceeds ${FW_BLOCK_MAX} bytes`);
+    if (block.length < FW_BLOCK_MIN) throw new RangeError(`Firmware block is under ${FW_BLOCK_MIN} bytes`);
+    const data = Buffer.alloc(4 + block.length);
+    data.writeUInt32LE(offset);
+    data.set(block, 4);
+    return (await this.sendCommand(CMD.FW_DATA, data, options))[0];
+  }
+
+  async endFirmware(crc: number, options?: CommandOptions): Promise<number> {
+    const data = Buffer.alloc(TP_MIN_SIZE - 1, 0xFF);  // 4 reserved bytes
+    data.writeUInt32LE(crc >>> 0);
+    // Activation is not repeatable, so never resent
+    return (await this.sendCommand(CMD.FW_END, data, { ...options, idempotent: false }))[0];
+  }
+
+  // Fast presence check: one QUERY on a short timeout, which also seeds
+  // the adaptive timeout. If the module stays silent, anything queued is
+  // failed and DeviceUnreachableError thrown.
+  async probe(timeoutMs: number = PROBE_TIMEOUT_MS): Promise<void> {
+    try {
+      await this.sendCommand(CMD.QUERY, [], { timeoutMs, retries: 0, rttSample: true });
+    } catch (err) {
+      if (err instanceof DeviceUnreachableError) throw err;
+      const unreachable = new DeviceUnreachableError(
+        `OSSM at 0x${this.address.toString(16)} not found: ${(err as Error).message}`
+      );
+      this.commands.abort(unreachable);
+      throw unreachable;
+    }
+  }
 }
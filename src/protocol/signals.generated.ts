@@ -0,0 +1,457 @@
+// Generated by scripts/gen-signals.js from definitions/ossm.json - do not edit
+//
+// Edit the definition file and run `npm run generate` (also run by
+// `npm run build`).
+import type { FrameDecoder, PgnDescriptor } from './decoder';
+
+// Standard J1939 PGNs for sensor data
+export const PGN = {
+  ENGINE_TEMP_1: 65262,      // 0xFEEE - Coolant, fuel, oil temps
+  ENGINE_FLUID_PRESS: 65263, // 0xFEEF - Fuel, oil, coolant pressures
+  AMBIENT_COND: 65269,       // 0xFEF5 - Baro, ambient temp
+  INLET_EXHAUST: 65270,      // 0xFEF6 - Air inlet, EGT, boost
+  ENGINE_TEMP_2: 65129,      // 0xFE69 - Additional temps
+  TURBO_INFO_1: 65189,       // 0xFEA5 - Turbo temps
+  TURBO_INFO_2: 65190,       // 0xFEA6 - Turbo pressures
+  EEC6: 65164,               // 0xFE8C - Engine bay temp, humidity
+} as const;
+
+export interface SensorData {
+  // Temperatures (Celsius)
+  coolantTemp?: number;        // C, SPN 110
+  fuelTemp?: number;           // C, SPN 174
+  oilTemp?: number;            // C, SPN 175
+  ambientTemp?: number;        // C, SPN 171
+  airInletTemp?: number;       // C, SPN 172
+  egtTemp?: number;            // C, SPN 173
+  boostTemp?: number;          // C, ENGINE_TEMP_2
+  cacInletTemp?: number;       // C, TURBO_INFO_1
+  transferPipeTemp?: number;   // C, TURBO_INFO_1
+  engineBayTemp?: number;      // C, TURBO_INFO_1, EEC6
+
+  // Pressures (kPa)
+  oilPressure?: number;        // kPa, SPN 100
+  fuelPressure?: number;       // kPa, SPN 94
+  coolantPressure?: number;    // kPa, SPN 109
+  boostPressure?: number;      // kPa, SPN 102
+  airInletPressure?: number;   // kPa, SPN 106
+  cacInletPressure?: number;   // kPa, TURBO_INFO_2
+
+  // Ambient
+  barometricPressure?: number;  // kPa, SPN 108
+  humidity?: number;           // %, SPN 354
+}
+
+// Signal IDs - fixed slot index into the sensor store
+export const SIGNAL = {
+  coolantTemp: 0,
+  fuelTemp: 1,
+  oilTemp: 2,
+  ambientTemp: 3,
+  airInletTemp: 4,
+  egtTemp: 5,
+  boostTemp: 6,
+  cacInletTemp: 7,
+  transferPipeTemp: 8,
+  engineBayTemp: 9,
+  oilPressure: 10,
+  fuelPressure: 11,
+  coolantPressure: 12,
+  boostPressure: 13,
+  airInletPressure: 14,
+  cacInletPressure: 15,
+  barometricPressure: 16,
+  humidity: 17,
+} as const satisfies Record<keyof SensorData, number>;
+
+export const SIGNAL_COUNT = 18;
+
+// One descriptor per PGN broadcast by OSSM
+export const PGN_DESCRIPTORS: PgnDescriptor[] = [
+  {
+    pgn: PGN.ENGINE_TEMP_1,
+    intervalMs: 1000,
+    fields: [
+      { signal: SIGNAL.coolantTemp, byte: 0, width: 1, scale: 1, offset: -40, na: 0xFF },
+      { signal: SIGNAL.fuelTemp, byte: 2, width: 1, scale: 1, offset: -40, na: 0xFF },
+      { signal: SIGNAL.oilTemp, byte: 3, width: 1, scale: 1, offset: -40, na: 0xFF },
+    ],
+  },
+  {
+    pgn: PGN.ENGINE_FLUID_PRESS,
+    intervalMs: 500,
+    fields: [
+      { signal: SIGNAL.fuelPressure, byte: 0, width: 2, scale: 4, offset: 0, na: 0xFFFF },
+      { signal: SIGNAL.oilPressure, byte: 3, width: 1, scale: 4, offset: 0, na: 0xFF },
+      { signal: SIGNAL.coolantPressure, byte: 4, width: 1, scale: 2, offset: 0, na: 0xFF },
+    ],
+  },
+  {
+    pgn: PGN.AMBIENT_COND,
+    intervalMs: 1000,
+    fields: [
+      { signal: SIGNAL.barometricPressure, byte: 0, width: 1, scale: 0.5, offset: 0, na: 0xFF },
+      { signal: SIGNAL.ambientTemp, byte: 3, width: 2, scale: 0.03125, offset: -273, na: 0xFFFF },
+    ],
+  },
+  {
+    pgn: PGN.INLET_EXHAUST,
+    intervalMs: 500,
+    fields: [
+      { signal: SIGNAL.boostPressure, byte: 1, width: 1, scale: 2, offset: 0, na: 0xFF },
+      { signal: SIGNAL.egtTemp, byte: 2, width: 2, scale: 0.03125, offset: -273, na: 0xFFFF },
+      { signal: SIGNAL.airInletTemp, byte: 4, width: 1, scale: 1, offset: -40, na: 0xFF },
+      { signal: SIGNAL.airInletPressure, byte: 5, width: 1, scale: 2, offset: 0, na: 0xFF },
+    ],
+  },
+  {
+    pgn: PGN.ENGINE_TEMP_2,
+    intervalMs: 1000,
+    fields: [
+      { signal: SIGNAL.boostTemp, byte: 0, width: 2, scale: 0.03125, offset: -273, na: 0xFFFF },
+    ],
+  },
+  {
+    pgn: PGN.TURBO_INFO_1,
+    intervalMs: 500,
+    fields: [
+      { signal: SIGNAL.cacInletTemp, byte: 0, width: 1, scale: 1, offset: -40, na: 0xFF },
+      { signal: SIGNAL.transferPipeTemp, byte: 1, width: 1, scale: 1, offset: -40, na: 0xFF },
+      { signal: SIGNAL.engineBayTemp, byte: 2, width: 1, scale: 1, offset: -40, na: 0xFF },
+    ],
+  },
+  {
+    pgn: PGN.TURBO_INFO_2,
+    intervalMs: 500,
+    fields: [
+      { signal: SIGNAL.cacInletPressure, byte: 2, width: 1, scale: 2, offset: 0, na: 0xFF },
+    ],
+  },
+  {
+    pgn: PGN.EEC6,
+    intervalMs: 1000,
+    fields: [
+      { signal: SIGNAL.engineBayTemp, byte: 0, width: 1, scale: 1, offset: -40, na: 0xFF },
+      { signal: SIGNAL.humidity, byte: 6, width: 1, scale: 0.5, offset: 0, na: 0xFF },
+    ],
+  },
+];
+
+// 0xFEEE ENGINE_TEMP_1
+const decodeEngineTemp1: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {
+  let changed = 0;
+  let carried = 0;
+  let raw: number;
+  let value: number;
+  if (len >= 1) {  // coolantTemp
+    raw = data[base];
+    if (raw !== 0xFF) {
+      value = raw - 40;
+      updated[0] = timestamp;
+      carried |= 0x1;
+      if (values[0] !== value) {
+        values[0] = value;
+        changed |= 0x1;
+      }
+    }
+  }
+  if (len >= 3) {  // fuelTemp
+    raw = data[base + 2];
+    if (raw !== 0xFF) {
+      value = raw - 40;
+      updated[1] = timestamp;
+      carried |= 0x2;
+      if (values[1] !== value) {
+        values[1] = value;
+        changed |= 0x2;
+      }
+    }
+  }
+  if (len >= 4) {  // oilTemp
+    raw = data[base + 3];
+    if (raw !== 0xFF) {
+      value = raw - 40;
+      updated[2] = timestamp;
+      carried |= 0x4;
+      if (values[2] !== value) {
+        values[2] = value;
+        changed |= 0x4;
+      }
+    }
+  }
+  sampled[0] = carried;
+  return changed;
+};
+
+// 0xFEEF ENGINE_FLUID_PRESS
+const decodeEngineFluidPress: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {
+  let changed = 0;
+  let carried = 0;
+  let raw: number;
+  let value: number;
+  if (len >= 2) {  // fuelPressure
+    raw = data[base] | (data[base + 1] << 8);
+    if (raw !== 0xFFFF) {
+      value = raw * 4;
+      updated[11] = timestamp;
+      carried |= 0x800;
+      if (values[11] !== value) {
+        values[11] = value;
+        changed |= 0x800;
+      }
+    }
+  }
+  if (len >= 4) {  // oilPressure
+    raw = data[base + 3];
+    if (raw !== 0xFF) {
+      value = raw * 4;
+      updated[10] = timestamp;
+      carried |= 0x400;
+      if (values[10] !== value) {
+        values[10] = value;
+        changed |= 0x400;
+      }
+    }
+  }
+  if (len >= 5) {  // coolantPressure
+    raw = data[base + 4];
+    if (raw !== 0xFF) {
+      value = raw * 2;
+      updated[12] = timestamp;
+      carried |= 0x1000;
+      if (values[12] !== value) {
+        values[12] = value;
+        changed |= 0x1000;
+      }
+    }
+  }
+  sampled[0] = carried;
+  return changed;
+};
+
+// 0xFEF5 AMBIENT_COND
+const decodeAmbientCond: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {
+  let changed = 0;
+  let carried = 0;
+  let raw: number;
+  let value: number;
+  if (len >= 1) {  // barometricPressure
+    raw = data[base];
+    if (raw !== 0xFF) {
+      value = raw * 0.5;
+      updated[16] = timestamp;
+      carried |= 0x10000;
+      if (values[16] !== value) {
+        values[16] = value;
+        changed |= 0x10000;
+      }
+    }
+  }
+  if (len >= 5) {  // ambientTemp
+    raw = data[base + 3] | (data[base + 4] << 8);
+    if (raw !== 0xFFFF) {
+      value = raw * 0.03125 - 273;
+      updated[3] = timestamp;
+      carried |= 0x8;
+      if (values[3] !== value) {
+        values[3] = value;
+        changed |= 0x8;
+      }
+    }
+  }
+  sampled[0] = carried;
+  return changed;
+};
+
+// 0xFEF6 INLET_EXHAUST
+const decodeInletExhaust: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {
+  let changed = 0;
+  let carried = 0;
+  let raw: number;
+  let value: number;
+  if (len >= 2) {  // boostPressure
+    raw = data[base + 1];
+    if (raw !== 0xFF) {
+      value = raw * 2;
+      updated[13] = timestamp;
+      carried |= 0x2000;
+      if (values[13] !== value) {
+        values[13] = value;
+        changed |= 0x2000;
+      }
+    }
+  }
+  if (len >= 4) {  // egtTemp
+    raw = data[base + 2] | (data[base + 3] << 8);
+    if (raw !== 0xFFFF) {
+      value = raw * 0.03125 - 273;
+      updated[5] = timestamp;
+      carried |= 0x20;
+      if (values[5] !== value) {
+        values[5] = value;
+        changed |= 0x20;
+      }
+    }
+  }
+  if (len >= 5) {  // airInletTemp
+    raw = data[base + 4];
+    if (raw !== 0xFF) {
+      value = raw - 40;
+      updated[4] = timestamp;
+      carried |= 0x10;
+      if (values[4] !== value) {
+        values[4] = value;
+        changed |= 0x10;
+      }
+    }
+  }
+  if (len >= 6) {  // airInletPressure
+    raw = data[base + 5];
+    if (raw !== 0xFF) {
+      value = raw * 2;
+      updated[14] = timestamp;
+      carried |= 0x4000;
+      if (values[14] !== value) {
+        values[14] = value;
+        changed |= 0x4000;
+      }
+    }
+  }
+  sampled[0] = carried;
+  return changed;
+};
+
+// 0xFE69 ENGINE_TEMP_2
+const decodeEngineTemp2: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {
+  let changed = 0;
+  let carried = 0;
+  let raw: number;
+  let value: number;
+  if (len >= 2) {  // boostTemp
+    raw = data[base] | (data[base + 1] << 8);
+    if (raw !== 0xFFFF) {
+      value = raw * 0.03125 - 273;
+      updated[6] = timestamp;
+      carried |= 0x40;
+      if (values[6] !== value) {
+        values[6] = value;
+        changed |= 0x40;
+      }
+    }
+  }
+  sampled[0] = carried;
+  return changed;
+};
+
+// 0xFEA5 TURBO_INFO_1
+const decodeTurboInfo1: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {
+  let changed = 0;
+  let carried = 0;
+  let raw: number;
+  let value: number;
+  if (len >= 1) {  // cacInletTemp
+    raw = data[base];
+    if (raw !== 0xFF) {
+      value = raw - 40;
+      updated[7] = timestamp;
+      carried |= 0x80;
+      if (values[7] !== value) {
+        values[7] = value;
+        changed |= 0x80;
+      }
+    }
+  }
+  if (len >= 2) {  // transferPipeTemp
+    raw = data[base + 1];
+    if (raw !== 0xFF) {
+      value = raw - 40;
+      updated[8] = timestamp;
+      carried |= 0x100;
+      if (values[8] !== value) {
+        values[8] = value;
+        changed |= 0x100;
+      }
+    }
+  }
+  if (len >= 3) {  // engineBayTemp
+    raw = data[base + 2];
+    if (raw !== 0xFF) {
+      value = raw - 40;
+      updated[9] = timestamp;
+      carried |= 0x200;
+      if (values[9] !== value) {
+        values[9] = value;
+        changed |= 0x200;
+      }
+    }
+  }
+  sampled[0] = carried;
+  return changed;
+};
+
+// 0xFEA6 TURBO_INFO_2
+const decodeTurboInfo2: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {
+  let changed = 0;
+  let carried = 0;
+  let raw: number;
+  let value: number;
+  if (len >= 3) {  // cacInletPressure
+    raw = data[base + 2];
+    if (raw !== 0xFF) {
+      value = raw * 2;
+      updated[15] = timestamp;
+      carried |= 0x8000;
+      if (values[15] !== value) {
+        values[15] = value;
+        changed |= 0x8000;
+      }
+    }
+  }
+  sampled[0] = carried;
+  return changed;
+};
+
+// 0xFE8C EEC6
+const decodeEec6: FrameDecoder = (values, updated, data, base, len, timestamp, sampled) => {
+  let changed = 0;
+  let carried = 0;
+  let raw: number;
+  let value: number;
+  if (len >= 1) {  // engineBayTemp
+    raw = data[base];
+    if (raw !== 0xFF) {
+      value = raw - 40;
+      updated[9] = timestamp;
+      carried |= 0x200;
+      if (values[9] !== value) {
+        values[9] = value;
+        changed |= 0x200;
+      }
+    }
+  }
+  if (len >= 7) {  // humidity
+    raw = data[base + 6];
+    if (raw !== 0xFF) {
+      value = raw * 0.5;
+      updated[17] = timestamp;
+      carried |= 0x20000;
+      if (values[17] !== value) {
+        values[17] = value;
+        changed |= 0x20000;
+      }
+    }
+  }
+  sampled[0] = carried;
+  return changed;
+};
+
+// Direct-indexed by PGN - 0xF000
+export const PDU2_DECODERS: (FrameDecoder | null)[] = new Array(0x1000).fill(null);
+PDU2_DECODERS[0xEEE] = decodeEngineTemp1;
+PDU2_DECODERS[0xEEF] = decodeEngineFluidPress;
+PDU2_DECODERS[0xEF5] = decodeAmbientCond;
+PDU2_DECODERS[0xEF6] = decodeInletExhaust;
+PDU2_DECODERS[0xE69] = decodeEngineTemp2;
+PDU2_DECODERS[0xEA5] = decodeTurboInfo1;
+PDU2_DECODERS[0xEA6] = decodeTurboInfo2;
+PDU2_DECODERS[0xE8C] = decodeEec6;
@@ -0,0 +1,182 @@
+// Per-signal subscriptions with deadband and rate limiting
+//
+// Subscribers are indexed by SIGNAL slot, and dispatch walks only the bits
+// of the decoder's changed mask, so a frame that changes nothing anyone
+// listens to costs a couple of array lookups. Deadband and interval are
+// judged against the last value actually delivered to each subscriber:
+// a slow drift is reported once it adds up to the deadband, and a change
+// held back by the interval is delivered when the interval is up, whether
+// or not another frame has changed it by then.
+import { SIGNAL, SIGNAL_COUNT, SIGNAL_NAMES, SignalName, SignalStore } from './decoder';
+
+// Timers run on the event loop's clock, which can trail performance.now()
+const TIMER_SLACK_MS = 1;
+
+export interface SignalUpdate {
+  signal: SignalName;
+  value: number;
+  previous: number;   // Last value delivered to this subscriber (NaN on the first update)
+  timestamp: number;  // Frame receive time, us since the epoch
+}
+
+export interface SubscribeOptions {
+  deadband?: number;       // Minimum absolute change to report (default 0 = any change)
+  minIntervalMs?: number;  // Minimum time between reports, by frame timestamps (default 0)
+}
+
+interface Subscription {
+  handler: (update: SignalUpdate) => void;
+  deadband: number;
+  minIntervalUs: number;
+  // Per subscribed signal slot
+  lastValue: Float64Array;
+  lastTime: Float64Array;
+  dueAt: Float64Array;              // performance.now() a held slot is due
+  heldMask: number;                 // Slots with a change held back by the interval
+  timer: NodeJS.Timeout | null;     // Trailing delivery of the earliest held slot
+  timerDue: number;
+  active: boolean;
+}
+
+export class SignalSubscriptions {
+  private readonly bySignal: Subscription[][] = Array.from({ length: SIGNAL_COUNT }, () => []);
+  private watchedMask = 0;
+  private store: SignalStore | null = null;  // For trailing deliveries
+
+  subscribe(
+    signals: SignalName | SignalName[],
+    handler: (update: SignalUpdate) => void,
+    options: SubscribeOptions = {}
+  ): () => void {
+    const names = Array.isArray(signals) ? signals : [signals];
+    const slots = names.map(name => {
+      if (!Object.hasOwn(SIGNAL, name)) throw new Error(`Unknown signal '${name}'`);
+      return SIGNAL[name];
+    });
+
+    const sub: Subscription = {
+      handler,
+      deadband: Math.max(0, options.deadband ?? 0),
+      minIntervalUs: Math.max(0, options.minIntervalMs ?? 0) * 1000,
+      lastValue: new Float64Array(SIGNAL_COUNT).fill(NaN),
+      lastTime: new Float64Array(SIGNAL_COUNT).fill(-Infinity),
+      dueAt: new Float64Array(SIGNAL_COUNT),
+      heldMask: 0,
+      timer: null,
+      timerDue: 0,
+      active: true,
+    };
+    for (const slot of slots) {
+      if (!this.bySignal[slot].includes(sub)) this.bySignal[slot].push(sub);
+    }
+    this.updateMask();
+
+    return () => {
+      if (!sub.active) return;
+      sub.active = false;
+      if (sub.timer) clearTimeout(sub.timer);
+      sub.timer = null;
+      for (const slot of slots) {
+        const list = this.bySignal[slot];
+        const i = list.indexOf(sub);
+        if (i >= 0) list.splice(i, 1);
+      }
+      this.updateMask();
+    };
+  }
+
+  // Deliver the signals in `changedMask` to their subscribers
+  dispatch(store: SignalStore, changedMask: number, timestamp: number): void {
+    let mask = changedMask & this.watchedMask;
+    const values = store.values;
+    this.store = store;
+
+    while (mask !== 0) {
+      const slot = 31 - Math.clz32(mask & -mask);
+      mask &= mask - 1;
+
+      const value = values[slot];
+      const list = this.bySignal[slot];
+      for (let i = 0; i < list.length; i++) {
+        const sub = list[i];
+        const previous = sub.lastValue[slot];
+        if (!Number.isNaN(previous) && Math.abs(value - previous) < sub.deadband) continue;
+        const wait = sub.lastTime[slot] + sub.minIntervalUs - timestamp;
+        if (wait > 0) {
+          this.hold(sub, slot, wait);
+          continue;
+        }
+
+        sub.heldMask &= ~(1 << slot);
+        sub.lastValue[slot] = value;
+        sub.lastTime[slot] = timestamp;
+        sub.handler({ signal: SIGNAL_NAMES[slot], value, previous, timestamp });
+      }
+    }
+  }
+
+  // Deliver `slot` once its interval is up. The wait is measured in frame
+  // time, so it also holds for replayed logs. A slot already held keeps
+  // its due time.
+  private hold(sub: Subscription, slot: number, waitUs: number): void {
+    const bit = 1 << slot;
+    if ((sub.heldMask & bit) === 0) {
+      sub.heldMask |= bit;
+      sub.dueAt[slot] = performance.now() + waitUs / 1000;
+    }
+    this.arm(sub);
+  }
+
+  // One timer per subscriber, for the earliest held slot
+  private arm(sub: Subscription): void {
+    let due = Infinity;
+    for (let mask = sub.heldMask; mask !== 0; mask &= mask - 1) {
+      due = Math.min(due, sub.dueAt[31 - Math.clz32(mask & -mask)]);
+    }
+    if (due === Infinity || (sub.timer && sub.timerDue <= due)) return;
+    if (sub.timer) clearTimeout(sub.timer);
+    sub.timerDue = due;
+    sub.timer = setTimeout(() => {
+      sub.timer = null;
+      if (sub.active) this.flush(sub);
+    }, Math.max(0, Math.ceil(due - performance.now())));
+    sub.timer.unref();
+  }
+
+  // Trailing delivery of the held slots that are due, at the latest value
+  // and sample time; the rest wait for their own due time
+  private flush(sub: Subscription): void {
+    const store = this.store;
+    const now = performance.now() + TIMER_SLACK_MS;
+    let mask = 0;
+    for (let held = sub.heldMask; held !== 0; held &= held - 1) {
+      const slot = 31 - Math.clz32(held & -held);
+      if (sub.dueAt[slot] <= now) mask |= 1 << slot;
+    }
+    sub.heldMask &= ~mask;
+    if (!store) return;
+
+    while (mask !== 0) {
+      const slot = 31 - Math.clz32(mask & -mask);
+      mask &= mask - 1;
+
+      const value = store.values[slot];
+      const previous = sub.lastValue[slot];
+      if (!Number.isNaN(previous) && Math.abs(value - previous) < sub.deadband) continue;
+      const timestamp = store.updated[slot];
+      sub.lastValue[slot] = value;
+      sub.lastTime[slot] = timestamp;
+      sub.handler({ signal: SIGNAL_NAMES[slot], value, previous, timestamp });
+      if (!sub.active) return;
+    }
+    this.arm(sub);
+  }
+
+  private updateMask(): void {
+    let mask = 0;
+    for (let slot = 0; slot < SIGNAL_COUNT; slot++) {
+      if (this.bySignal[slot].length > 0) mask |= 1 << slot;
+    }
+    this.watchedMask = mask;
+  }
+}
@@ -0,0 +1,315 @@
+// J1939-21 transport protocol: TP.CM / TP.DT segmentation and reassembly
+//
+// Handles both broadcast (BAM) and connection-mode (RTS/CTS) transfers of
+// up to 1785 bytes. Sessions are kept in flat 256-entry tables keyed by
+// the peer's address, one receive and one transmit session per peer.
+
+export const PGN_TP_CM = 60416;  // 0xEC00 - Connection management
+export const PGN_TP_DT = 60160;  // 0xEB00 - Data transfer
+
+export const TP_MIN_SIZE = 9;     // Shorter messages fit in one frame
+export const TP_MAX_SIZE = 1785;  // 255 packets * 7 bytes
+
+// TP.CM control bytes
+const TP_RTS = 16;
+const TP_CTS = 17;
+const TP_EOM_ACK = 19;
+const TP_BAM = 32;
+const TP_ABORT = 255;
+
+// TP.CM_Abort reasons
+const ABORT_RESOURCES = 2;
+const ABORT_TIMEOUT = 3;
+
+// Timeouts (ms) from J1939-21
+const T1 = 750;   // Receiver: gap between data packets
+const T2 = 1250;  // Receiver: data after sending CTS
+const T3 = 1250;  // Sender: CTS / EOM_ACK after sending data
+const T4 = 1050;  // Sender: CTS after a "hold" CTS
+
+const GLOBAL_ADDRESS = 0xFF;
+const TP_PRIORITY = 7;
+
+export interface TransportOptions {
+  localAddress: number;
+  transmit: (canId: number, data: Buffer) => void;
+  transmitBatch?: (frames: { canId: number; data: Buffer }[]) => void;  // Used for CTS windows
+  onMessage: (pgn: number, source: number, data: Buffer, timestamp: number) => void;
+  ctsWindow?: number;  // Packets granted per CTS when receiving (default 16)
+  bamGapMs?: number;   // Delay between BAM data packets (default 50, per J1939-21)
+}
+
+interface RxSession {
+  pgn: number;
+  size: number;
+  packets: number;
+  data: Buffer;
+  nextSeq: number;    // Next expected sequence number (1-based)
+  windowEnd: number;  // Last sequence number covered by the current CTS
+  resentFrom: number; // Sequence a recovery CTS was last sent for (0 = none)
+  bam: boolean;
+  timer: NodeJS.Timeout | null;
+}
+
+interface TxSession {
+  pgn: number;
+  dest: number;
+  payload: Buffer;
+  packets: number;
+  timer: NodeJS.Timeout | null;
+  resolve: () => void;
+  reject: (err: Error) => void;
+}
+
+export class TransportProtocol {
+  private readonly localAddress: number;
+  private readonly transmit: (canId: number, data: Buffer) => void;
+  private readonly transmitBatch: (frames: { canId: number; data: Buffer }[]) => void;
+  private readonly onMessage: TransportOptions['onMessage'];
+  private readonly ctsWindow: number;
+  private readonly bamGapMs: number;
+  private readonly rx: (RxSession | null)[] = new Array(256).fill(null);
+  private readonly tx: (TxSession | null)[] = new Array(256).fill(null);
+  private readonly txChain = new Map<number, Promise<void>>();
+
+  constructor(options: TransportOptions) {
+    this.localAddress = options.localAddress;
+    this.transmit = options.transmit;
+    this.transmitBatch = options.transmitBatch
+      ?? (frames => frames.forEach(f => this.transmit(f.canId, f.data)));
+    this.onMessage = options.onMessage;
+    this.ctsWindow = Math.min(255, Math.max(1, options.ctsWindow ?? 16));
+    this.bamGapMs = options.bamGapMs ?? 50;
+  }
+
+  // Feed a received TP.CM or TP.DT frame. `dest` is the PDU1 destination.
+  handleFrame(pgn: number, source: number, dest: number, data: Uint8Array, base: number, dlc: number, timestamp: number): void {
+    if (dlc < 8) return;
+    if (dest !== this.localAddress && dest !== GLOBAL_ADDRESS) return;
+
+    if (pgn === PGN_TP_CM) {
+      this.handleControl(source, dest, data, base);
+    } else if (pgn === PGN_TP_DT) {
+      this.handleData(source, dest, data, base, timestamp);
+    }
+  }
+
+  // Send `payload` as `pgn` to `dest`: BAM for the global address, RTS/CTS otherwise.
+  // Transfers to the same destination are serialised.
+  send(pgn: number, dest: number, payload: Buffer): Promise<void> {
+    if (payload.length > TP_MAX_SIZE) {
+      return Promise.reject(new Error(`TP payload too large (${payload.length} > ${TP_MAX_SIZE} bytes)`));
+    }
+
+    const previous = this.txChain.get(dest) ?? Promise.resolve();
+    const next = previous.catch(() => {}).then(() =>
+      dest === GLOBAL_ADDRESS ? this.sendBam(pgn, payload) : this.sendRts(pgn, dest, payload)
+    );
+    this.txChain.set(dest, next);
+    const cleanup = () => {
+      if (this.txChain.get(dest) === next) this.txChain.delete(dest);
+    };
+    next.then(cleanup, cleanup);
+    return next;
+  }
+
+  // Drop every session, failing pending sends
+  close(): void {
+    for (let sa = 0; sa < 256; sa++) {
+      this.endRx(sa);
+      const tx = this.tx[sa];
+      if (tx) this.endTx(tx, new Error('Transport closed'));
+    }
+  }
+
+  private handleControl(source: number, dest: number, data: Uint8Array, base: number): void {
+    const control = data[base];
+    const pgn = data[base + 5] | (data[base + 6] << 8) | (data[base + 7] << 16);
+
+    switch (control) {
+      case TP_RTS:
+      case TP_BAM: {
+        const bam = control === TP_BAM;
+        if (bam !== (dest === GLOBAL_ADDRESS)) return;
+
+        const size = data[base + 1] | (data[base + 2] << 8);
+        const packets = data[base + 3];
+        if (size < TP_MIN_SIZE || size > TP_MAX_SIZE || packets !== Math.ceil(size / 7)) {
+          if (!bam) this.sendAbort(source, pgn, ABORT_RESOURCES);
+          return;
+        }
+
+        // A new announcement from the same peer replaces any stale session
+        this.endRx(source);
+        const session: RxSession = {
+          pgn, size, packets, data: Buffer.alloc(packets * 7, 0xFF),
+          nextSeq: 1, windowEnd: 0, resentFrom: 0, bam, timer: null
+        };
+        this.rx[source] = session;
+
+        if (bam) {
+          this.armRx(source, T1);
+        } else {
+          const maxPerCts = data[base + 4] === 0xFF ? 255 : data[base + 4];
+          this.sendCts(source, session, maxPerCts);
+        }
+        break;
+      }
+
+      case TP_CTS: {
+        const tx = this.tx[source];
+        if (!tx || tx.pgn !== pgn) return;
+        const count = data[base + 1];
+        const first = data[base + 2];
+        this.clearTxTimer(tx);
+
+        if (count === 0) {
+          // Receiver asked us to hold
+          tx.timer = setTimeout(() => this.abortTx(tx), T4);
+          return;
+        }
+        const window: { canId: number; data: Buffer }[] = [];
+        for (let seq = first; seq < first + count && seq <= tx.packets; seq++) {
+          window.push({ canId: this.canId(PGN_TP_DT, tx.dest), data: this.packet(tx.payload, seq) });
+        }
+        this.transmitBatch(window);
+        tx.timer = setTimeout(() => this.abortTx(tx), T3);
+        break;
+      }
+
+      case TP_EOM_ACK: {
+        const tx = this.tx[source];
+        if (tx && tx.pgn === pgn) this.endTx(tx);
+        break;
+      }
+
+      case TP_ABORT: {
+        const tx = this.tx[source];
+        if (tx && tx.pgn === pgn) this.endTx(tx, new Error(`TP transfer aborted by 0x${source.toString(16)} (reason ${data[base + 1]})`));
+        const rx = this.rx[source];
+        if (rx && rx.pgn === pgn) this.endRx(source);
+        break;
+      }
+    }
+  }
+
+  private handleData(source: number, dest: number, data: Uint8Array, base: number, timestamp: number): void {
+    const session = this.rx[source];
+    if (!session || session.bam !== (dest === GLOBAL_ADDRESS)) return;
+
+    const seq = data[base];
+    if (seq < session.nextSeq) return;  // Duplicate
+    if (seq > session.nextSeq) {
+      // Lost a packet: BAM cannot recover, RTS/CTS asks again from the gap
+      // (once - the rest of the current window is still in flight)
+      if (session.bam) {
+        this.endRx(source);
+      } else if (session.resentFrom !== session.nextSeq) {
+        session.resentFrom = session.nextSeq;
+        this.sendCts(source, session, 255);
+      }
+      return;
+    }
+
+    session.data.set(data.subarray(base + 1, base + 8), (seq - 1) * 7);
+    session.nextSeq++;
+
+    if (session.nextSeq > session.packets) {
+      if (!session.bam) {
+        this.transmit(this.canId(PGN_TP_CM, source), cm(TP_EOM_ACK, session.size & 0xFF, session.size >> 8, session.packets, 0xFF, session.pgn));
+      }
+      this.endRx(source);
+      this.onMessage(session.pgn, source, session.data.subarray(0, session.size), timestamp);
+    } else if (!session.bam && session.nextSeq > session.windowEnd) {
+      this.sendCts(source, session, 255);
+    } else {
+      this.armRx(source, T1);
+    }
+  }
+
+  private sendCts(peer: number, session: RxSession, maxPerCts: number): void {
+    const remaining = session.packets - session.nextSeq + 1;
+    const count = Math.min(remaining, this.ctsWindow, maxPerCts);
+    session.windowEnd = session.nextSeq + count - 1;
+    this.transmit(this.canId(PGN_TP_CM, peer), cm(TP_CTS, count, session.nextSeq, 0xFF, 0xFF, session.pgn));
+    this.armRx(peer, T2);
+  }
+
+  private sendAbort(peer: number, pgn: number, reason: number): void {
+    this.transmit(this.canId(PGN_TP_CM, peer), cm(TP_ABORT, reason, 0xFF, 0xFF, 0xFF, pgn));
+  }
+
+  private armRx(peer: number, ms: number): void {
+    const session = this.rx[peer];
+    if (!session) return;
+    if (session.timer) clearTimeout(session.timer);
+    session.timer = setTimeout(() => {
+      if (this.rx[peer] !== session) return;
+      if (!session.bam) this.sendAbort(peer, session.pgn, ABORT_TIMEOUT);
+      this.rx[peer] = null;
+    }, ms);
+  }
+
+  private endRx(peer: number): void {
+    const session = this.rx[peer];
+    if (!session) return;
+    if (session.timer) clearTimeout(session.timer);
+    this.rx[peer] = null;
+  }
+
+  private sendRts(pgn: number, dest: number, payload: Buffer): Promise<void> {
+    return new Promise((resolve, reject) => {
+      const packets = Math.ceil(payload.length / 7);
+      const tx: TxSession = { pgn, dest, payload, packets, timer: null, resolve, reject };
+      this.tx[dest] = tx;
+      this.transmit(this.canId(PGN_TP_CM, dest), cm(TP_RTS, payload.length & 0xFF, payload.length >> 8, packets, 0xFF, pgn));
+      tx.timer = setTimeout(() => this.abortTx(tx), T3);
+    });
+  }
+
+  private async sendBam(pgn: number, payload: Buffer): Promise<void> {
+    const packets = Math.ceil(payload.length / 7);
+    const id = this.canId(PGN_TP_CM, GLOBAL_ADDRESS);
+    this.transmit(id, cm(TP_BAM, payload.length & 0xFF, payload.length >> 8, packets, 0xFF, pgn));
+    for (let seq = 1; seq <= packets; seq++) {
+      await new Promise(resolve => setTimeout(resolve, this.bamGapMs));
+      this.transmit(this.canId(PGN_TP_DT, GLOBAL_ADDRESS), this.packet(payload, seq));
+    }
+  }
+
+  private abortTx(tx: TxSession): void {
+    if (this.tx[tx.dest] !== tx) return;
+    this.sendAbort(tx.dest, tx.pgn, ABORT_TIMEOUT);
+    this.endTx(tx, new Error(`TP transfer to 0x${tx.dest.toString(16)} timed out`));
+  }
+
+  private endTx(tx: TxSession, err?: Error): void {
+    this.clearTxTimer(tx);
+    if (this.tx[tx.dest] === tx) this.tx[tx.dest] = null;
+    if (err) tx.reject(err);
+    else tx.resolve();
+  }
+
+  private clearTxTimer(tx: TxSession): void {
+    if (tx.timer) {
+      clearTimeout(tx.timer);
+      tx.timer = null;
+    }
+  }
+
+  private packet(payload: Buffer, seq: number): Buffer {
+    const buf = Buffer.alloc(8, 0xFF);
+    buf[0] = seq;
+    payload.copy(buf, 1, (seq - 1) * 7, Math.min(seq * 7, payload.length));
+    return buf;
+  }
+
+  private canId(pgn: number, dest: number): number {
+    return (TP_PRIORITY << 26) | (pgn << 8) | (dest << 8) | this.localAddress;
+  }
+}
+
+// TP.CM frame: control byte, four parameter bytes, 24-bit PGN
+function cm(control: number, b1: number, b2: number, b3: number, b4: number, pgn: number): Buffer {
+  return Buffer.from([control, b1, b2, b3, b4, pgn & 0xFF, (pgn >> 8) & 0xFF, (pgn >> 16) & 0xFF]);
+}
@@ -0,0 +1,288 @@
+// Broadcast-rate watchdog for decoded PGNs
+//
+// Each PGN in definitions/ossm.json has the interval OSSM is expected to
+// broadcast it at. These are assumptions, not rates taken from the OSSM
+// firmware: each is the usual J1939-71 rate for its PGN (1 s or 0.5 s),
+// and WatchdogOptions.intervals overrides them per PGN. A received frame
+// only updates its entry (last seen, missed frames, jitter); finding the
+// ones that went quiet is left to one hashed timer wheel shared by every
+// tracked (node, PGN) pair. Entries are re-filed lazily: when the wheel
+// reaches an entry that has been received since it was filed, the entry
+// moves on to its new deadline, so the receive path never touches the
+// wheel and there is no timer per signal.
+//
+// A PGN is stale once `staleIntervals` intervals pass without it, and a
+// signal once every PGN carrying it is stale. PGNs are tracked from their
+// first frame, so ones the module was never configured to send stay quiet.
+// Missed frames are counted by the wheel as well: at the stale deadline,
+// then every interval until the PGN is back, so a PGN that stops keeps
+// adding to its count. The next frame adds any misses not yet counted.
+//
+// Deadlines are in frame time, so the wheel runs on the same clock: the
+// latest frame's timestamp plus the wall time since the last tick that
+// saw it advance. A replayed log keeps its recorded times, and when the
+// frames stop, time still moves on. Frames more than REWIND_US older than
+// the latest (a looped log, a clock step) start a new timeline.
+import { PGN_DESCRIPTORS, SIGNAL_COUNT, SignalSource } from './decoder';
+
+export interface PgnHealth {
+  address: number;
+  pgn: number;
+  intervalMs: number;   // Expected broadcast interval
+  frames: number;
+  missed: number;       // Intervals that passed without a frame
+  jitterUs: number;     // Smoothed deviation from the interval (RFC 3550 style)
+  maxJitterUs: number;
+  stale: boolean;
+  lastSeen: number;     // Receive time of the latest frame (us)
+}
+
+export interface WatchdogOptions {
+  staleIntervals?: number;              // Default STALE_INTERVALS
+  intervals?: Record<number, number>;   // Per-PGN overrides of intervalMs
+}
+
+interface Entry extends PgnHealth {
+  staleUs: number;
+  mask: number;      // SIGNAL slots this PGN carries
+  filed: boolean;    // In the wheel
+  resumed: boolean;  // The timeline restarted since the last frame, so no gap to measure
+  counted: number;   // Misses already counted since the last frame
+}
+
+export const STALE_INTERVALS = 3;
+
+const TICK_MS = 50;
+const TICK_US = TICK_MS * 1000;
+const WHEEL_SLOTS = 128;  // Power of two; 6.4 s per turn
+const JITTER_GAIN = 1 / 16;
+const REWIND_US = 1e6;
+
+// PGN - 0xF000 -> descriptor index, -1 = not decoded
+const PDU2_BASE = 0xF000;
+const PGN_INDEX = new Int8Array(0x1000).fill(-1);
+PGN_DESCRIPTORS.forEach((d, i) => { PGN_INDEX[d.pgn - PDU2_BASE] = i; });
+const PGN_MASKS = PGN_DESCRIPTORS.map(d => d.fields.reduce((mask, f) => mask | (1 << f.signal), 0));
+
+// Shortest broadcast interval of any PGN carrying each signal (ms, 0 = none)
+export const SIGNAL_INTERVAL_MS = (() => {
+  const intervals = new Float64Array(SIGNAL_COUNT);
+  for (const d of PGN_DESCRIPTORS) {
+    if (d.intervalMs === 0) continue;
+    for (const f of d.fields) {
+      if (intervals[f.signal] === 0 || d.intervalMs < intervals[f.signal]) intervals[f.signal] = d.intervalMs;
+    }
+  }
+  return intervals;
+})();
+
+// Bit per signal that was seen but not sampled for `staleIntervals` of its
+// interval. Works on any SignalSource, including worker and daemon mirrors.
+export function staleSignals(
+  source: SignalSource,
+  now: number = Date.now() * 1000,
+  staleIntervals: number = STALE_INTERVALS
+): number {
+  let mask = 0;
+  const { updated } = source;
+  for (let i = 0; i < SIGNAL_COUNT; i++) {
+    const interval = SIGNAL_INTERVAL_MS[i];
+    if (interval !== 0 && updated[i] !== 0 && now - updated[i] > interval * staleIntervals * 1000) mask |= 1 << i;
+  }
+  return mask;
+}
+
+export class PgnWatchdog {
+  private readonly nodes: (Entry[] | undefined)[] = new Array(256);  // By source address, then PGN index
+  private readonly staleMasks = new Uint32Array(256);
+  private readonly intervals: number[];
+  private readonly staleIntervals: number;
+  private readonly wheel: Entry[][] = Array.from({ length: WHEEL_SLOTS }, () => []);
+  private spare: Entry[] = [];
+  private tickAt = 0;  // Last processed tick (us / TICK_US)
+  private latest = 0;  // Newest frame time (us)
+  private clockOffset = 0;  // Frame time - wall time (us), as of the last tick
+  private latestAtTick = 0;
+  private timer: NodeJS.Timeout | null = null;
+  private readonly handlers: ((health: PgnHealth) => void)[] = [];
+
+  constructor(options: WatchdogOptions = {}) {
+    this.staleIntervals = Math.max(1, options.staleIntervals ?? STALE_INTERVALS);
+    this.intervals = PGN_DESCRIPTORS.map(d => options.intervals?.[d.pgn] ?? d.intervalMs);
+  }
+
+  // A frame of `pgn` from `address`, received at `timestamp` (us)
+  seen(address: number, pgn: number, timestamp: number): void {
+    const index = PGN_INDEX[pgn - PDU2_BASE];
+    if (index < 0 || this.intervals[index] === 0) return;
+    if (timestamp > this.latest) this.latest = timestamp;
+    else if (timestamp < this.latest - REWIND_US) this.rewind(timestamp);
+    const entries = this.nodes[address] ??= [];
+    const entry = entries[index] ??= this.track(address, index);
+
+    const gap = timestamp - entry.lastSeen;
+    const counted = entry.counted;
+    if (entry.resumed) {
+      entry.resumed = false;
+    } else if (entry.frames > 0 && gap > 0) {
+      const intervalUs = entry.intervalMs * 1000;
+      const periods = Math.round(gap / intervalUs);
+      if (periods > 1) {
+        entry.missed += Math.max(0, periods - 1 - counted);
+      } else {
+        const deviation = Math.abs(gap - intervalUs);
+        entry.jitterUs += (deviation - entry.jitterUs) * JITTER_GAIN;
+        if (deviation > entry.maxJitterUs) entry.maxJitterUs = deviation;
+      }
+    }
+    entry.frames++;
+    if (timestamp > entry.lastSeen) {
+      entry.lastSeen = timestamp;
+      entry.counted = 0;
+    }
+
+    if (entry.stale) {
+      entry.stale = false;
+      this.changed(entry);
+    }
+    if (!entry.filed) this.file(entry, entry.lastSeen + entry.staleUs);
+  }
+
+  // Every tracked PGN, optionally of one node
+  health(address?: number): PgnHealth[] {
+    const out: PgnHealth[] = [];
+    this.nodes.forEach((entries, a) => {
+      if (!entries || (address !== undefined && a !== address)) return;
+      for (const entry of entries) if (entry) out.push(snapshot(entry));
+    });
+    return out;
+  }
+
+  // Bit per SIGNAL slot of `address` whose every carrying PGN is stale
+  staleMask(address: number): number {
+    return this.staleMasks[address & 0xFF];
+  }
+
+  // Called when a PGN goes stale or is received again (see health.stale).
+  // Returns an unsubscribe function.
+  onStale(handler: (health: PgnHealth) => void): () => void {
+    this.handlers.push(handler);
+    return () => {
+      const i = this.handlers.indexOf(handler);
+      if (i >= 0) this.handlers.splice(i, 1);
+    };
+  }
+
+  close(): void {
+    if (this.timer) clearInterval(this.timer);
+    this.timer = null;
+  }
+
+  private track(address: number, index: number): Entry {
+    const intervalMs = this.intervals[index];
+    if (!this.timer) {
+      this.startClock();
+      this.timer = setInterval(() => this.tick(), TICK_MS);
+      this.timer.unref();
+    }
+    return {
+      address, pgn: PGN_DESCRIPTORS[index].pgn, intervalMs,
+      frames: 0, missed: 0, jitterUs: 0, maxJitterUs: 0, stale: false, lastSeen: 0,
+      staleUs: intervalMs * this.staleIntervals * 1000, mask: PGN_MASKS[index], filed: false, resumed: false,
+      counted: 0,
+    };
+  }
+
+  // Put the frame clock at the latest frame, and the wheel with it
+  private startClock(): void {
+    this.clockOffset = this.latest - Date.now() * 1000;
+    this.latestAtTick = this.latest;
+    this.tickAt = Math.floor(this.latest / TICK_US);
+  }
+
+  // Frame time went back: restart every deadline from `timestamp`. Stale
+  // PGNs stay stale until their next frame, and count misses from here.
+  private rewind(timestamp: number): void {
+    this.latest = timestamp;
+    this.startClock();
+    for (const slot of this.wheel) slot.length = 0;
+    for (const entries of this.nodes) {
+      if (!entries) continue;
+      for (const entry of entries) {
+        if (!entry) continue;
+        entry.lastSeen = timestamp;
+        entry.resumed = true;
+        entry.counted = 0;
+        this.file(entry, timestamp + entry.staleUs);
+      }
+    }
+  }
+
+  private file(entry: Entry, deadline: number): void {
+    const tick = Math.max(this.tickAt + 1, Math.ceil(deadline / TICK_US));
+    this.wheel[tick & (WHEEL_SLOTS - 1)].push(entry);
+    entry.filed = true;
+  }
+
+  // Process every slot up to now (frame time); after a stall, at most one
+  // full turn
+  private tick(): void {
+    const wall = Date.now() * 1000;
+    if (this.latest !== this.latestAtTick) {
+      this.latestAtTick = this.latest;
+      this.clockOffset = this.latest - wall;
+    }
+    const now = wall + this.clockOffset;
+    const target = Math.floor(now / TICK_US);
+    let at = Math.max(this.tickAt, target - WHEEL_SLOTS);
+    while (at < target) {
+      at++;
+      this.tickAt = at;
+      this.expire(at & (WHEEL_SLOTS - 1), now);
+    }
+  }
+
+  private expire(slot: number, now: number): void {
+    const due = this.wheel[slot];
+    if (due.length === 0) return;
+    this.wheel[slot] = this.spare;
+    for (const entry of due) {
+      const deadline = entry.lastSeen + entry.staleUs;
+      if (deadline > now) {
+        this.file(entry, deadline);  // Received since, or due in a later turn
+        continue;
+      }
+      const intervalUs = entry.intervalMs * 1000;
+      const missed = Math.round((now - entry.lastSeen) / intervalUs) - 1;
+      if (missed > entry.counted) {
+        entry.missed += missed - entry.counted;
+        entry.counted = missed;
+      }
+      this.file(entry, now + intervalUs);
+      if (entry.stale) continue;
+      entry.stale = true;
+      this.changed(entry);
+    }
+    due.length = 0;
+    this.spare = due;
+  }
+
+  private changed(entry: Entry): void {
+    let fresh = 0;
+    let seen = 0;
+    for (const e of this.nodes[entry.address]!) {
+      if (!e) continue;
+      seen |= e.mask;
+      if (!e.stale) fresh |= e.mask;
+    }
+    this.staleMasks[entry.address] = seen & ~fresh;
+    if (this.handlers.length === 0) return;
+    const health = snapshot(entry);
+    for (const handler of this.handlers) handler(health);
+  }
+}
+
+function snapshot(entry: Entry): PgnHealth {
+  const { address, pgn, intervalMs, frames, missed, jitterUs, maxJitterUs, stale, lastSeen } = entry;
+  return { address, pgn, intervalMs, frames, missed, jitterUs: Math.round(jitterUs), maxJitterUs, stale, lastSeen };
+}
@@ -0,0 +1,151 @@
+// Firmware update over CAN
+//
+// Needs the OSSM bootloader's update commands on PGN 65280:
+//
+//   FW_BEGIN <size u32> <4 x 0xFF>    Erase room for the image    -> status
+//   FW_DATA  <offset u32> <bytes>     Write one block              -> status
+//   FW_END   <crc32 u32> <4 x 0xFF>   Check the image and activate -> status
+//
+// All values are little-endian, and a status of 0 means OK. Each step is
+// one TP (RTS/CTS) message to the target's address, so other modules on
+// the bus never see it; a single frame would be a broadcast. The reserved
+// bytes and the FW_BLOCK_MIN block size keep every step over the TP
+// minimum. The module paces block data with its own CTS windows. Several
+// blocks are queued at once: the next RTS goes out as soon as the previous
+// transfer is acknowledged, without waiting for that block's status.
+// Blocks carry their offset, so one that is resent after a timeout simply
+// overwrites itself.
+//
+// The image is read from disk one block at a time, and its CRC-32 is
+// summed as it is read, so memory use does not depend on image size. The
+// old firmware stays active until FW_END has checked the CRC. A module in
+// its bootloader may not answer QUERY, so flashing skips the probe.
+import * as fs from 'fs';
+import type { ProgressReporter } from '../config/progress';
+import { FW_BLOCK_MAX, FW_BLOCK_MIN, J1939Protocol } from '../protocol/j1939';
+
+export interface FlashOptions {
+  blockSize?: number;  // Bytes per FW_DATA block (default and max FW_BLOCK_MAX, min 2 * FW_BLOCK_MIN)
+  window?: number;     // Blocks queued ahead of the last acknowledged one (default 4)
+  progress?: ProgressReporter;
+}
+
+export interface FlashResult {
+  bytes: number;
+  blocks: number;
+  crc: number;
+  elapsedMs: number;
+}
+
+const STATUS: Record<number, string> = {
+  1: 'not in update mode',
+  2: 'offset out of range',
+  3: 'flash write failed',
+  4: 'CRC mismatch',
+  5: 'image too large',
+};
+
+// Erasing and the final check run on the module, far longer than a round trip
+const ERASE_TIMEOUT_MS = 30000;
+const VERIFY_TIMEOUT_MS = 10000;
+// Queued blocks wait behind each other's TP transfers
+const BLOCK_TIMEOUT_MS = 5000;
+const BLOCK_RETRIES = 2;
+const DEFAULT_WINDOW = 4;
+
+// A rejected update step; nothing is activated
+export class FirmwareError extends Error {
+  readonly status: number;
+
+  constructor(step: string, status: number) {
+    super(`Module rejected ${step}: ${STATUS[status] ?? `status ${status}`}`);
+    this.name = 'FirmwareError';
+    this.status = status;
+  }
+}
+
+export async function flashFirmware(
+  protocol: J1939Protocol,
+  imagePath: string,
+  options: FlashOptions = {}
+): Promise<FlashResult> {
+  const { progress } = options;
+  const blockSize = Math.min(FW_BLOCK_MAX, Math.max(2 * FW_BLOCK_MIN, options.blockSize ?? FW_BLOCK_MAX));
+  const window = Math.max(1, options.window ?? DEFAULT_WINDOW);
+  const started = Date.now();
+
+  const fd = fs.openSync(imagePath, 'r');
+  try {
+    const size = fs.fstatSync(fd).size;
+    if (size < FW_BLOCK_MIN) throw new Error(`${imagePath} is ${size === 0 ? 'empty' : 'too small'}`);
+    const blocks = Math.ceil(size / blockSize);
+
+    progress?.step('erasing');
+    check('FW_BEGIN', await protocol.beginFirmware(size, { timeoutMs: ERASE_TIMEOUT_MS, retries: 0 }));
+
+    progress?.step('writing', blocks);
+    const pending = new Set<Promise<void>>();
+    let failure: Error | null = null;
+    let crc = 0;
+    for (let offset = 0, length = 0; offset < size && !failure; offset += length) {
+      length = Math.min(blockSize, size - offset);
+      // Leave the last block at least FW_BLOCK_MIN bytes
+      const rest = size - offset - length;
+      if (rest > 0 && rest < FW_BLOCK_MIN) length -= FW_BLOCK_MIN - rest;
+      const block = Buffer.allocUnsafe(length);
+      readFully(fd, block, offset);
+      crc = crc32(block, crc);
+
+      const write: Promise<void> = protocol
+        .writeFirmware(offset, block, { timeoutMs: BLOCK_TIMEOUT_MS, retries: BLOCK_RETRIES })
+        .then(status => {
+          check(`FW_DATA at ${offset}`, status);
+          progress?.advance();
+        })
+        .catch(err => {
+          failure ??= err as Error;
+        })
+        .finally(() => pending.delete(write));
+      pending.add(write);
+      if (pending.size >= window) await Promise.race(pending);
+    }
+    await Promise.all(pending);
+    if (failure) throw failure;
+
+    progress?.step('verifying');
+    check('FW_END', await protocol.endFirmware(crc, { timeoutMs: VERIFY_TIMEOUT_MS, retries: 0 }));
+    return { bytes: size, blocks, crc, elapsedMs: Date.now() - started };
+  } finally {
+    fs.closeSync(fd);
+  }
+}
+
+function check(step: string, status: number): void {
+  if (status !== 0) throw new FirmwareError(step, status);
+}
+
+function readFully(fd: number, buf: Buffer, position: number): void {
+  let done = 0;
+  while (done < buf.length) {
+    const n = fs.readSync(fd, buf, done, buf.length - done, position + done);
+    if (n === 0) throw new Error('Firmware image changed while flashing');
+    done += n;
+  }
+}
+
+// CRC-32 (IEEE 802.3, as zlib): crc32(b, crc32(a)) === crc32(a + b)
+const CRC_TABLE = (() => {
+  const table = new Int32Array(256);
+  for (let n = 0; n < 256; n++) {
+    let c = n;
+    for (let k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >>> 1) : c >>> 1;
+    table[n] = c;
+  }
+  return table;
+})();
+
+export function crc32(data: Uint8Array, previous: number = 0): number {
+  let crc = ~previous;
+  for (let i = 0; i < data.length; i++) crc = CRC_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >>> 8);
+  return ~crc >>> 0;
+}
@@ -0,0 +1,181 @@
+// Multi-device provisioning across several CAN interfaces
+//
+// OSSM commands are broadcast on PGN 65280 with no destination address and
+// every module on a bus acts on them, so a bus is only commanded while it
+// holds a single module: each interface starts with a census QUERY, and
+// its targets fail if more than one module answers, or if the answer is
+// not from the target. Jobs that only send to the target's address (a
+// firmware update) may run with `exclusive: false` and share a bus.
+// Separate interfaces run in parallel, so station throughput scales with
+// port count.
+import { CanBus } from '../can/socketcan';
+import type { ProgressReporter } from '../config/progress';
+import { J1939Protocol, J1939ProtocolOptions, OSSM_SOURCE_ADDRESS } from '../protocol/j1939';
+
+export interface Target {
+  interface: string;
+  address: number;
+}
+
+export type DeviceState = 'queued' | 'running' | 'done' | 'failed';
+
+export interface DeviceProgress {
+  target: Target;
+  state: DeviceState;
+  step: string;       // Current activity
+  done: number;       // Work items completed in this step
+  total: number;
+  error?: string;
+  elapsedMs: number;
+}
+
+export type DeviceJob = (protocol: J1939Protocol, progress: ProgressReporter, target: Target) => Promise<void>;
+
+export type StationOptions = Omit<J1939ProtocolOptions, 'address'>;
+
+export interface RunOptions {
+  probe?: boolean;      // QUERY each target before the job (default true; off for bootloaders)
+  exclusive?: boolean;  // Refuse buses with more than one module (default true)
+}
+
+// "can0", "can1:150" or "can1:0x96"
+export function parseTarget(spec: string): Target {
+  const [iface, addr] = spec.split(':');
+  const address = addr === undefined ? OSSM_SOURCE_ADDRESS : Number(addr);
+  if (!iface || !Number.isInteger(address) || address < 0 || address > 0xFD) {
+    throw new Error(`Invalid target '${spec}' (expected <interface>[:<address>])`);
+  }
+  return { interface: iface, address };
+}
+
+export function targetName(target: Target): string {
+  return `${target.interface}:0x${target.address.toString(16).padStart(2, '0')}`;
+}
+
+export class Station {
+  private readonly targets: Target[];
+  private readonly options: StationOptions;
+  private readonly buses = new Map<string, CanBus>();
+
+  constructor(targets: Target[], options: StationOptions = {}) {
+    this.targets = targets;
+    this.options = options;
+  }
+
+  // Open every interface once; throws on the first one that fails
+  open(): void {
+    for (const target of this.targets) {
+      if (this.buses.has(target.interface)) continue;
+      const can = new CanBus(target.interface);
+      can.connect();
+      this.buses.set(target.interface, can);
+    }
+  }
+
+  close(): void {
+    for (const can of this.buses.values()) can.disconnect();
+    this.buses.clear();
+  }
+
+  async run(
+    job: DeviceJob,
+    onProgress: (progress: DeviceProgress) => void = () => {},
+    options: RunOptions = {}
+  ): Promise<DeviceProgress[]> {
+    const states = this.targets.map(target => ({
+      target, state: 'queued' as DeviceState, step: 'queued', done: 0, total: 0, elapsedMs: 0
+    }));
+
+    // One lane per interface, lanes run concurrently
+    const lanes = new Map<string, DeviceProgress[]>();
+    for (const state of states) {
+      const lane = lanes.get(state.target.interface) ?? [];
+      lane.push(state);
+      lanes.set(state.target.interface, lane);
+    }
+
+    await Promise.all([...lanes.entries()].map(async ([iface, lane]) => {
+      const can = this.buses.get(iface);
+      const error = !can ? `Interface ${iface} is not open`
+        : options.exclusive ?? true ? await this.checkBus(can, lane) : null;
+      for (const progress of lane) {
+        if (error) {
+          this.finish(progress, 'failed', 0, onProgress, error);
+          continue;
+        }
+        await this.runOne(can!, progress, job, onProgress, options.probe ?? true);
+      }
+    }));
+
+    return states;
+  }
+
+  // Why the lane cannot be commanded without reaching other modules, if so.
+  // A module that stays silent (in its bootloader, say) is not counted.
+  private async checkBus(can: CanBus, lane: DeviceProgress[]): Promise<string | null> {
+    const protocol = new J1939Protocol(can, { ...this.options, address: lane[0].target.address });
+    let answered: number[];
+    try {
+      answered = await protocol.census();
+    } finally {
+      protocol.close();
+    }
+    const modules = new Set([...answered, ...lane.map(p => p.target.address)]);
+    if (modules.size <= 1) return null;
+    const list = [...modules].sort((a, b) => a - b).map(a => `0x${a.toString(16).padStart(2, '0')}`).join(', ');
+    return `Modules ${list} share ${lane[0].target.interface}; OSSM commands are broadcast, ` +
+      'so connect one module per interface';
+  }
+
+  private async runOne(
+    can: CanBus,
+    progress: DeviceProgress,
+    job: DeviceJob,
+    onProgress: (progress: DeviceProgress) => void,
+    probe: boolean
+  ): Promise<void> {
+    const started = Date.now();
+    const protocol = new J1939Protocol(can, { ...this.options, address: progress.target.address });
+    const reporter: ProgressReporter = {
+      step: (name, total = 0) => {
+        progress.step = name;
+        progress.done = 0;
+        progress.total = total;
+        progress.elapsedMs = Date.now() - started;
+        onProgress(progress);
+      },
+      advance: (count = 1) => {
+        progress.done += count;
+      },
+    };
+
+    progress.state = 'running';
+    try {
+      // A missing module fails here in a fraction of a second
+      if (probe) {
+        reporter.step('probing');
+        await protocol.probe();
+      }
+      await job(protocol, reporter, progress.target);
+      this.finish(progress, 'done', started, onProgress);
+    } catch (err) {
+      this.finish(progress, 'failed', started, onProgress, (err as Error).message);
+    } finally {
+      protocol.close();
+    }
+  }
+
+  private finish(
+    progress: DeviceProgress,
+    state: DeviceState,
+    started: number,
+    onProgress: (progress: DeviceProgress) => void,
+    error?: string
+  ): void {
+    progress.state = state;
+    progress.step = state;
+    progress.error = error;
+    progress.elapsedMs = started ? Date.now() - started : 0;
+    onProgress(progress);
+  }
+}
@@ -0,0 +1,411 @@
+// Derived signals and alarms, evaluated as frames are decoded
+//
+//   {
+//     "derived": {
+//       "boost": "boostPressure - barometricPressure",
+//       "egtRate": { "expr": "rate(egtTemp)", "unit": "C/s" }
+//     },
+//     "alarms": {
+//       "egtHigh": { "when": "egtTemp > 750", "hysteresis": 25, "latch": true, "severity": "critical" },
+//       "lowOil": { "when": "oilPressure < (oilTemp > 100 ? 150 : 100)", "forMs": 500 }
+//     }
+//   }
+//
+// Rules form a dependency graph over signals and derived values, kept in
+// topological order. The decoder's changed mask marks the rules reading a
+// changed signal; one forward pass evaluates those, and a derived value
+// that actually changed marks its own dependents further down. Rules over
+// inputs that did not change are not run, except those calling rate():
+// they run whenever a signal under them is sampled, so a rate falls back
+// to 0 once its input holds steady. Every decoded frame is an update, so
+// an alarm waiting out its forMs raises on the first frame past the delay
+// even if nothing changed. Alarms fire synchronously from the decode of
+// the frame that tripped them.
+import * as fs from 'fs';
+import { SIGNAL, SIGNAL_COUNT, SignalName, SignalStore } from '../protocol/decoder';
+import type { J1939Protocol } from '../protocol/j1939';
+import {
+  Compiled, EvalContext, Expr, RateHistory, compileExpression, expressionInputs, parseExpression, usesRate
+} from './expression';
+
+export interface DerivedDefinition {
+  expr: string;
+  unit?: string;
+}
+
+export type Severity = 'info' | 'warning' | 'critical';
+
+export interface AlarmDefinition {
+  when: string;
+  clear?: string;        // Clears once this is true (default: once `when` is false)
+  hysteresis?: number;   // For a `when` of the form a > b or a < b: clear only past b -/+ this
+  forMs?: number;        // `when` must hold this long, by frame time, before raising
+  latch?: boolean;       // Stay raised after clearing until acknowledged
+  severity?: Severity;   // Default 'warning'
+  message?: string;
+}
+
+export interface RuleSet {
+  derived?: Record<string, string | DerivedDefinition>;
+  alarms?: Record<string, AlarmDefinition>;
+}
+
+// 'latched' = the condition has cleared but the alarm awaits acknowledgement
+export type AlarmState = 'normal' | 'pending' | 'active' | 'latched';
+
+export interface AlarmEvent {
+  alarm: string;
+  kind: 'raised' | 'cleared' | 'acknowledged';
+  severity: Severity;
+  message: string;
+  timestamp: number;  // us since the epoch (frame time, or now for acknowledgements)
+}
+
+export interface AlarmStatus {
+  alarm: string;
+  state: AlarmState;
+  acknowledged: boolean;
+  severity: Severity;
+  message: string;
+  since: number;  // When the current state was entered (us, 0 = never left normal)
+}
+
+interface DerivedNode {
+  name: string;
+  unit: string;
+  expr: Expr;
+  evaluate: Compiled;
+  slot: number;  // Index into `derived`
+}
+
+interface AlarmNode {
+  name: string;
+  when: Compiled;
+  hold: Compiled | null;   // While active, stays active as long as this is true
+  clear: Compiled | null;
+  rate: boolean;           // Uses rate(), so every sample must be evaluated
+  forUs: number;
+  latch: boolean;
+  severity: Severity;
+  message: string;
+  state: AlarmState;
+  acknowledged: boolean;
+  since: number;
+}
+
+export class RuleEngine {
+  readonly derived: Float64Array;  // Current derived values, NaN = unknown
+  private readonly derivedNodes: DerivedNode[];
+  private readonly alarmNodes: AlarmNode[];
+  private readonly derivedSlots = new Map<string, number>();
+  private readonly bySignal: number[][] = Array.from({ length: SIGNAL_COUNT }, () => []);
+  private readonly bySample: number[][] = Array.from({ length: SIGNAL_COUNT }, () => []);  // rate() rules
+  private readonly dependents: number[][];  // Per derived slot, nodes reading it
+  private readonly derivedSignals: number[];  // Per derived slot, signals it reads, directly or not
+  private readonly dirty: Uint8Array;       // Per node: derived slots first, then alarms
+  private readonly pending = new Set<AlarmNode>();
+  private readonly ctx: EvalContext;
+  private readonly alarmHandlers: ((event: AlarmEvent) => void)[] = [];
+  private inputMask = 0;
+  private sampleMask = 0;
+
+  constructor(rules: RuleSet) {
+    const nodes = sortDerived(rules.derived ?? {});
+    this.derived = new Float64Array(nodes.length).fill(NaN);
+    nodes.forEach((node, slot) => this.derivedSlots.set(node.name, slot));
+    this.dependents = nodes.map(() => []);
+    this.derivedSignals = nodes.map(() => 0);
+    this.ctx = { signals: new Float64Array(SIGNAL_COUNT), derived: this.derived, timestamp: 0 };
+
+    const resolve = (name: string) => {
+      if (Object.hasOwn(SIGNAL, name)) return { signal: SIGNAL[name as SignalName] };
+      const slot = this.derivedSlots.get(name);
+      return slot === undefined ? undefined : { derived: slot };
+    };
+
+    this.derivedNodes = nodes.map(({ name, unit, expr }, slot) => {
+      this.derivedSignals[slot] = this.link(expressionInputs(expr), slot, usesRate(expr));
+      return { name, unit, expr, evaluate: compileExpression(expr, resolve), slot };
+    });
+
+    this.alarmNodes = Object.entries(rules.alarms ?? {}).map(([name, def], i) => {
+      const index = nodes.length + i;
+      try {
+        if (typeof def.when !== 'string') throw new Error('"when" must be an expression');
+        const when = parseExpression(def.when);
+        const clear = def.clear !== undefined ? parseExpression(def.clear) : null;
+        const inputs = expressionInputs(when);
+        if (clear) expressionInputs(clear, inputs);
+        const rate = usesRate(when) || (clear !== null && usesRate(clear));
+        this.link(inputs, index, rate);
+        // One rate() history for all three, so they see the same samples
+        const rates: RateHistory = new Map();
+        return {
+          name,
+          when: compileExpression(when, resolve, rates),
+          hold: def.hysteresis !== undefined ? compileExpression(widen(when, def.hysteresis), resolve, rates) : null,
+          clear: clear ? compileExpression(clear, resolve, rates) : null,
+          rate,
+          forUs: Math.max(0, def.forMs ?? 0) * 1000,
+          latch: def.latch ?? false,
+          severity: def.severity ?? 'warning',
+          message: def.message ?? def.when,
+          state: 'normal' as AlarmState,
+          acknowledged: false,
+          since: 0,
+        };
+      } catch (err) {
+        throw new Error(`Alarm '${name}': ${(err as Error).message}`);
+      }
+    });
+
+    this.dirty = new Uint8Array(nodes.length + this.alarmNodes.length);
+  }
+
+  static load(path: string): RuleEngine {
+    let rules: RuleSet;
+    try {
+      rules = JSON.parse(fs.readFileSync(path, 'utf8'));
+    } catch (err) {
+      throw new Error(`Cannot read rules ${path}: ${(err as Error).message}`);
+    }
+    return new RuleEngine(rules);
+  }
+
+  // Evaluate on every decoded frame of the protocol's target, changed or
+  // not. Everything is evaluated once straight away against the current
+  // values.
+  attach(protocol: J1939Protocol): () => void {
+    const store = protocol.getSignalStore();
+    this.update(store, -1, store.lastUpdate || Date.now() * 1000);
+    return protocol.onDecode((signals, timestamp) => (
+      this.update(signals, signals.changedMask, timestamp, signals.sampledMask)
+    ));
+  }
+
+  // Re-evaluate the rules reading any signal in `changedMask`, and the
+  // rate() rules over any signal in `sampledMask`, then raise the held
+  // alarms whose delay has passed
+  update(store: SignalStore, changedMask: number, timestamp: number, sampledMask: number = changedMask): void {
+    const ctx = this.ctx;
+    ctx.signals = store.values;
+    ctx.timestamp = timestamp;
+    const dirty = this.dirty;
+
+    let first = this.mark(this.bySignal, changedMask & this.inputMask, dirty.length);
+    first = this.mark(this.bySample, sampledMask & this.sampleMask, first);
+
+    const derivedCount = this.derivedNodes.length;
+    for (let i = first; i < dirty.length; i++) {
+      if (dirty[i] === 0) continue;
+      dirty[i] = 0;
+      if (i < derivedCount) this.evaluateDerived(this.derivedNodes[i]);
+      else this.evaluateAlarm(this.alarmNodes[i - derivedCount], timestamp);
+    }
+
+    // A held condition raises on the first frame past its delay, changed or not
+    for (const alarm of this.pending) {
+      if (timestamp - alarm.since >= alarm.forUs) this.raise(alarm, timestamp);
+    }
+  }
+
+  value(name: string): number {
+    const slot = this.derivedSlots.get(name);
+    if (slot === undefined) throw new Error(`Unknown derived signal '${name}'`);
+    return this.derived[slot];
+  }
+
+  // Derived values that are known
+  snapshot(): Record<string, number> {
+    const values: Record<string, number> = {};
+    for (const node of this.derivedNodes) {
+      const v = this.derived[node.slot];
+      if (!Number.isNaN(v)) values[node.name] = v;
+    }
+    return values;
+  }
+
+  units(): Record<string, string> {
+    return Object.fromEntries(this.derivedNodes.map(node => [node.name, node.unit]));
+  }
+
+  alarms(): AlarmStatus[] {
+    return this.alarmNodes.map(({ name, state, acknowledged, severity, message, since }) => (
+      { alarm: name, state, acknowledged, severity, message, since }
+    ));
+  }
+
+  // Acknowledge a raised alarm; a latched one whose condition has cleared
+  // then returns to normal. False if it is not raised.
+  acknowledge(name: string): boolean {
+    const alarm = this.alarmNodes.find(a => a.name === name);
+    if (!alarm) throw new Error(`Unknown alarm '${name}'`);
+    const now = Date.now() * 1000;
+    if (alarm.state === 'latched') {
+      this.enter(alarm, 'normal', now);
+      this.emit(alarm, 'cleared', now);
+      return true;
+    }
+    if (alarm.state !== 'active' || alarm.acknowledged) return false;
+    alarm.acknowledged = true;
+    this.emit(alarm, 'acknowledged', now);
+    return true;
+  }
+
+  // Called on every alarm transition. Returns an unsubscribe function.
+  onAlarm(handler: (event: AlarmEvent) => void): () => void {
+    this.alarmHandlers.push(handler);
+    return () => {
+      const i = this.alarmHandlers.indexOf(handler);
+      if (i >= 0) this.alarmHandlers.splice(i, 1);
+    };
+  }
+
+  // Index `node` under its inputs; returns the signals it reads, through
+  // derived values too
+  private link(inputs: Set<string>, node: number, rate: boolean): number {
+    let signals = 0;
+    for (const name of inputs) {
+      if (Object.hasOwn(SIGNAL, name)) {
+        const slot = SIGNAL[name as SignalName];
+        this.bySignal[slot].push(node);
+        this.inputMask |= 1 << slot;
+        signals |= 1 << slot;
+        continue;
+      }
+      const slot = this.derivedSlots.get(name);
+      if (slot === undefined) throw new Error(`Unknown signal '${name}'`);
+      this.dependents[slot].push(node);
+      signals |= this.derivedSignals[slot];
+    }
+    if (rate) {
+      for (let mask = signals; mask !== 0; mask &= mask - 1) {
+        this.bySample[31 - Math.clz32(mask & -mask)].push(node);
+      }
+      this.sampleMask |= signals;
+    }
+    return signals;
+  }
+
+  // Mark the nodes indexed under `mask`; returns the lowest marked, or `first`
+  private mark(index: number[][], mask: number, first: number): number {
+    while (mask !== 0) {
+      const slot = 31 - Math.clz32(mask & -mask);
+      mask &= mask - 1;
+      for (const node of index[slot]) {
+        this.dirty[node] = 1;
+        if (node < first) first = node;
+      }
+    }
+    return first;
+  }
+
+  private evaluateDerived(node: DerivedNode): void {
+    const value = node.evaluate(this.ctx);
+    const previous = this.derived[node.slot];
+    if (value === previous || (value !== value && previous !== previous)) return;
+    this.derived[node.slot] = value;
+    for (const dependent of this.dependents[node.slot]) this.dirty[dependent] = 1;
+  }
+
+  // Unknown (NaN) conditions leave the state as it is
+  private evaluateAlarm(alarm: AlarmNode, timestamp: number): void {
+    const ctx = this.ctx;
+    // Take every sample whatever the state; the branches below then reuse them
+    if (alarm.rate) {
+      alarm.when(ctx);
+      alarm.clear?.(ctx);
+    }
+    switch (alarm.state) {
+      case 'normal':
+        if (alarm.when(ctx) !== 1) return;
+        if (alarm.forUs > 0) {
+          this.enter(alarm, 'pending', timestamp);
+          this.pending.add(alarm);
+        } else {
+          this.raise(alarm, timestamp);
+        }
+        return;
+      case 'pending':
+        if (alarm.when(ctx) !== 0) return;
+        this.pending.delete(alarm);
+        this.enter(alarm, 'normal', timestamp);
+        return;
+      case 'active': {
+        const cleared = alarm.clear ? alarm.clear(ctx) === 1 : (alarm.hold ?? alarm.when)(ctx) === 0;
+        if (!cleared) return;
+        if (alarm.latch && !alarm.acknowledged) {
+          this.enter(alarm, 'latched', timestamp);
+        } else {
+          this.enter(alarm, 'normal', timestamp);
+          this.emit(alarm, 'cleared', timestamp);
+        }
+        return;
+      }
+      case 'latched':
+        // Back before anyone acknowledged it; still the same alarm
+        if (alarm.when(ctx) === 1) this.enter(alarm, 'active', timestamp);
+        return;
+    }
+  }
+
+  private raise(alarm: AlarmNode, timestamp: number): void {
+    this.pending.delete(alarm);
+    alarm.acknowledged = false;
+    this.enter(alarm, 'active', timestamp);
+    this.emit(alarm, 'raised', timestamp);
+  }
+
+  private enter(alarm: AlarmNode, state: AlarmState, timestamp: number): void {
+    alarm.state = state;
+    alarm.since = timestamp;
+  }
+
+  private emit(alarm: AlarmNode, kind: AlarmEvent['kind'], timestamp: number): void {
+    const event: AlarmEvent = { alarm: alarm.name, kind, severity: alarm.severity, message: alarm.message, timestamp };
+    for (const handler of this.alarmHandlers) handler(event);
+  }
+}
+
+// Parse the derived definitions and order them so each comes after every
+// derived value it reads; throws on a cycle
+function sortDerived(defs: Record<string, string | DerivedDefinition>): { name: string; unit: string; expr: Expr }[] {
+  const parsed = new Map<string, { unit: string; expr: Expr; inputs: Set<string> }>();
+  for (const [name, def] of Object.entries(defs)) {
+    if (Object.hasOwn(SIGNAL, name)) throw new Error(`Derived signal '${name}' shadows a decoded signal`);
+    const source = typeof def === 'string' ? def : def.expr;
+    try {
+      if (typeof source !== 'string') throw new Error('expected an expression');
+      const expr = parseExpression(source);
+      parsed.set(name, { unit: typeof def === 'string' ? '' : def.unit ?? '', expr, inputs: expressionInputs(expr) });
+    } catch (err) {
+      throw new Error(`Derived signal '${name}': ${(err as Error).message}`);
+    }
+  }
+
+  const sorted: { name: string; unit: string; expr: Expr }[] = [];
+  const state = new Map<string, 'visiting' | 'done'>();
+  const visit = (name: string, path: string[]) => {
+    if (state.get(name) === 'done') return;
+    if (state.get(name) === 'visiting') throw new Error(`Derived signals depend on each other: ${[...path, name].join(' -> ')}`);
+    state.set(name, 'visiting');
+    const def = parsed.get(name)!;
+    for (const input of def.inputs) {
+      if (parsed.has(input)) visit(input, [...path, name]);
+    }
+    state.set(name, 'done');
+    sorted.push({ name, unit: def.unit, expr: def.expr });
+  };
+  for (const name of parsed.keys()) visit(name, []);
+  return sorted;
+}
+
+// `a > b` held with hysteresis h stays true until a <= b - h (and `a < b`
+// until a >= b + h)
+function widen(when: Expr, hysteresis: number): Expr {
+  if (when.kind !== 'binary' || !['<', '<=', '>', '>='].includes(when.op)) {
+    throw new Error('"hysteresis" needs a "when" of the form a > b or a < b');
+  }
+  const shift = when.op === '>' || when.op === '>=' ? -hysteresis : hysteresis;
+  return { ...when, right: { kind: 'binary', op: '+', left: when.right, right: { kind: 'number', value: shift } } };
+}
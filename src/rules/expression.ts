@@ -0,0 +1,325 @@
+// Expressions over decoded signals, for derived values and alarms
+//
+//   boostPressure - barometricPressure
+//   egtTemp > 700 && rate(egtTemp) > 20
+//   oilPressure < (oilTemp > 100 ? 150 : 100)
+//
+// Numbers, names, + - * / %, comparisons, && || !, ?: and the functions
+// abs, min, max, sqrt and rate (change per second between evaluations).
+// Comparisons and logic give 1 or 0. A signal that has not been seen is
+// NaN, and NaN propagates, so a rule over unknown inputs is unknown
+// rather than false.
+//
+// parseExpression only builds the tree; compileExpression turns it into
+// closures, resolving names once, so evaluation does no lookups.
+
+export type Expr =
+  | { kind: 'number'; value: number }
+  | { kind: 'name'; name: string }
+  | { kind: 'unary'; op: '-' | '!'; arg: Expr }
+  | { kind: 'binary'; op: BinaryOp; left: Expr; right: Expr }
+  | { kind: 'conditional'; test: Expr; then: Expr; else: Expr }
+  | { kind: 'call'; fn: string; args: Expr[] };
+
+export type BinaryOp = '+' | '-' | '*' | '/' | '%' | '<' | '<=' | '>' | '>=' | '==' | '!=' | '&&' | '||';
+
+// What compiled code reads: raw signal values and the engine's derived values
+export interface EvalContext {
+  signals: Float64Array;
+  derived: Float64Array;
+  timestamp: number;  // us since the epoch, of the frame being evaluated
+}
+
+export type Compiled = (ctx: EvalContext) => number;
+
+// Where a name lives, or undefined if it is unknown
+export type Resolve = (name: string) => { signal: number } | { derived: number } | undefined;
+
+// Previous samples of rate() arguments, keyed by the argument expression.
+// Expressions compiled with one history share them: every rate() of the
+// same argument sees the same samples, however many of them are evaluated.
+export type RateHistory = Map<string, RateSample>;
+
+interface RateSample {
+  value: number;
+  time: number;   // us, 0 = no sample yet
+  at: number;     // Timestamp of the latest evaluation
+  rate: number;   // Its result
+}
+
+export class ExpressionError extends Error {
+  constructor(message: string, source: string, at: number) {
+    super(`${message} at ${at + 1} in '${source}'`);
+    this.name = 'ExpressionError';
+  }
+}
+
+const BINARY_PRECEDENCE: Record<string, number> = {
+  '||': 2, '&&': 3,
+  '==': 4, '!=': 4,
+  '<': 5, '<=': 5, '>': 5, '>=': 5,
+  '+': 6, '-': 6,
+  '*': 7, '/': 7, '%': 7,
+};
+const UNARY_PRECEDENCE = 8;
+
+const FUNCTIONS: Record<string, [number, number]> = {  // [min, max] arguments
+  abs: [1, 1],
+  sqrt: [1, 1],
+  min: [2, Infinity],
+  max: [2, Infinity],
+  rate: [1, 1],
+};
+
+interface Token {
+  kind: 'number' | 'name' | 'op' | 'end';
+  text: string;
+  at: number;
+}
+
+const TOKEN = /\s*(?:(\d+(?:\.\d*)?(?:[eE][+-]?\d+)?|\.\d+(?:[eE][+-]?\d+)?)|([A-Za-z_][A-Za-z0-9_]*)|(<=|>=|==|!=|&&|\|\||[-+*/%<>!?:(),]))/y;
+
+function tokenize(source: string): Token[] {
+  const tokens: Token[] = [];
+  TOKEN.lastIndex = 0;
+  let at = 0;
+  while (at < source.length) {
+    if (/^\s*$/.test(source.slice(at))) break;
+    TOKEN.lastIndex = at;
+    const m = TOKEN.exec(source);
+    if (!m) throw new ExpressionError(`Unexpected '${source.slice(at).trim()[0]}'`, source, at);
+    const start = m.index + m[0].length - (m[1] ?? m[2] ?? m[3]).length;
+    if (m[1] !== undefined) tokens.push({ kind: 'number', text: m[1], at: start });
+    else if (m[2] !== undefined) tokens.push({ kind: 'name', text: m[2], at: start });
+    else tokens.push({ kind: 'op', text: m[3], at: start });
+    at = TOKEN.lastIndex;
+  }
+  tokens.push({ kind: 'end', text: '', at: source.length });
+  return tokens;
+}
+
+export function parseExpression(source: string): Expr {
+  const tokens = tokenize(source);
+  let pos = 0;
+  const peek = () => tokens[pos];
+  const fail = (message: string, token: Token = peek()): never => {
+    throw new ExpressionError(message, source, token.at);
+  };
+  const expect = (text: string) => {
+    if (peek().text !== text || peek().kind !== 'op') fail(`Expected '${text}'`);
+    pos++;
+  };
+
+  // Precedence climbing; ?: binds loosest and groups to the right
+  const parse = (minPrecedence: number): Expr => {
+    let left = primary();
+    while (true) {
+      const token = peek();
+      if (token.kind !== 'op') break;
+      if (token.text === '?' && minPrecedence <= 1) {
+        pos++;
+        const then = parse(1);
+        expect(':');
+        left = { kind: 'conditional', test: left, then, else: parse(1) };
+        continue;
+      }
+      const precedence = BINARY_PRECEDENCE[token.text];
+      if (precedence === undefined || precedence < minPrecedence) break;
+      pos++;
+      left = { kind: 'binary', op: token.text as BinaryOp, left, right: parse(precedence + 1) };
+    }
+    return left;
+  };
+
+  const primary = (): Expr => {
+    const token = tokens[pos++];
+    if (token.kind === 'number') return { kind: 'number', value: Number(token.text) };
+    if (token.kind === 'name') {
+      if (peek().text !== '(') return { kind: 'name', name: token.text };
+      const arity = FUNCTIONS[token.text];
+      if (!arity) fail(`Unknown function '${token.text}'`, token);
+      pos++;
+      const args: Expr[] = [];
+      if (peek().text !== ')') {
+        args.push(parse(0));
+        while (peek().text === ',') {
+          pos++;
+          args.push(parse(0));
+        }
+      }
+      expect(')');
+      if (args.length < arity[0] || args.length > arity[1]) fail(`Wrong number of arguments to ${token.text}()`, token);
+      return { kind: 'call', fn: token.text, args };
+    }
+    if (token.text === '(') {
+      const inner = parse(0);
+      expect(')');
+      return inner;
+    }
+    if (token.text === '-' || token.text === '!') {
+      return { kind: 'unary', op: token.text, arg: parse(UNARY_PRECEDENCE) };
+    }
+    return fail(token.kind === 'end' ? 'Unexpected end' : `Unexpected '${token.text}'`, token);
+  };
+
+  const expr = parse(0);
+  if (peek().kind !== 'end') fail(`Unexpected '${peek().text}'`);
+  return expr;
+}
+
+// Every name the expression reads
+export function expressionInputs(expr: Expr, into: Set<string> = new Set()): Set<string> {
+  switch (expr.kind) {
+    case 'name': into.add(expr.name); break;
+    case 'unary': expressionInputs(expr.arg, into); break;
+    case 'binary': expressionInputs(expr.left, into); expressionInputs(expr.right, into); break;
+    case 'conditional':
+      expressionInputs(expr.test, into);
+      expressionInputs(expr.then, into);
+      expressionInputs(expr.else, into);
+      break;
+    case 'call': for (const arg of expr.args) expressionInputs(arg, into); break;
+  }
+  return into;
+}
+
+// True if the expression calls rate() anywhere
+export function usesRate(expr: Expr): boolean {
+  switch (expr.kind) {
+    case 'unary': return usesRate(expr.arg);
+    case 'binary': return usesRate(expr.left) || usesRate(expr.right);
+    case 'conditional': return usesRate(expr.test) || usesRate(expr.then) || usesRate(expr.else);
+    case 'call': return expr.fn === 'rate' || expr.args.some(usesRate);
+    default: return false;
+  }
+}
+
+export function compileExpression(expr: Expr, resolve: Resolve, rates: RateHistory = new Map()): Compiled {
+  switch (expr.kind) {
+    case 'number': {
+      const value = expr.value;
+      return () => value;
+    }
+    case 'name': {
+      const where = resolve(expr.name);
+      if (!where) throw new Error(`Unknown signal '${expr.name}'`);
+      if ('signal' in where) {
+        const slot = where.signal;
+        return ctx => ctx.signals[slot];
+      }
+      const slot = where.derived;
+      return ctx => ctx.derived[slot];
+    }
+    case 'unary': {
+      const arg = compileExpression(expr.arg, resolve, rates);
+      return expr.op === '-' ? ctx => -arg(ctx) : ctx => not(arg(ctx));
+    }
+    case 'binary':
+      return compileBinary(expr.op, compileExpression(expr.left, resolve, rates), compileExpression(expr.right, resolve, rates));
+    case 'conditional': {
+      const test = compileExpression(expr.test, resolve, rates);
+      const then = compileExpression(expr.then, resolve, rates);
+      const otherwise = compileExpression(expr.else, resolve, rates);
+      return ctx => {
+        const t = test(ctx);
+        return t !== t ? NaN : t !== 0 ? then(ctx) : otherwise(ctx);
+      };
+    }
+    case 'call': {
+      const args = expr.args.map(arg => compileExpression(arg, resolve, rates));
+      if (expr.fn !== 'rate') return compileCall(expr.fn, args);
+      const key = JSON.stringify(expr.args[0]);
+      let sample = rates.get(key);
+      if (!sample) rates.set(key, sample = { value: NaN, time: 0, at: 0, rate: NaN });
+      return compileRate(args[0], sample);
+    }
+  }
+}
+
+function compileBinary(op: BinaryOp, a: Compiled, b: Compiled): Compiled {
+  switch (op) {
+    case '+': return ctx => a(ctx) + b(ctx);
+    case '-': return ctx => a(ctx) - b(ctx);
+    case '*': return ctx => a(ctx) * b(ctx);
+    case '/': return ctx => a(ctx) / b(ctx);
+    case '%': return ctx => a(ctx) % b(ctx);
+    case '<': return ctx => {
+      const x = a(ctx);
+      const y = b(ctx);
+      return x !== x || y !== y ? NaN : x < y ? 1 : 0;
+    };
+    case '<=': return ctx => {
+      const x = a(ctx);
+      const y = b(ctx);
+      return x !== x || y !== y ? NaN : x <= y ? 1 : 0;
+    };
+    case '>': return ctx => {
+      const x = a(ctx);
+      const y = b(ctx);
+      return x !== x || y !== y ? NaN : x > y ? 1 : 0;
+    };
+    case '>=': return ctx => {
+      const x = a(ctx);
+      const y = b(ctx);
+      return x !== x || y !== y ? NaN : x >= y ? 1 : 0;
+    };
+    case '==': return ctx => {
+      const x = a(ctx);
+      const y = b(ctx);
+      return x !== x || y !== y ? NaN : x === y ? 1 : 0;
+    };
+    case '!=': return ctx => {
+      const x = a(ctx);
+      const y = b(ctx);
+      return x !== x || y !== y ? NaN : x !== y ? 1 : 0;
+    };
+    // A known false side decides the result even if the other is unknown
+    case '&&': return ctx => {
+      const x = a(ctx);
+      if (x === 0) return 0;
+      const y = b(ctx);
+      if (y === 0) return 0;
+      return x !== x || y !== y ? NaN : 1;
+    };
+    case '||': return ctx => {
+      const x = a(ctx);
+      if (x === x && x !== 0) return 1;
+      const y = b(ctx);
+      if (y === y && y !== 0) return 1;
+      return x !== x || y !== y ? NaN : 0;
+    };
+  }
+}
+
+function compileCall(fn: string, args: Compiled[]): Compiled {
+  const [a] = args;
+  switch (fn) {
+    case 'abs': return ctx => Math.abs(a(ctx));
+    case 'sqrt': return ctx => Math.sqrt(a(ctx));
+    case 'min': return ctx => args.reduce((m, arg) => Math.min(m, arg(ctx)), Infinity);
+    case 'max': return ctx => args.reduce((m, arg) => Math.max(m, arg(ctx)), -Infinity);
+    default:
+      throw new Error(`Unknown function '${fn}'`);
+  }
+}
+
+// Change per second since the previous sample. Evaluated again at the same
+// timestamp (by another expression sharing the history), it repeats its result.
+function compileRate(a: Compiled, sample: RateSample): Compiled {
+  return ctx => {
+    if (ctx.timestamp === sample.at) return sample.rate;
+    sample.at = ctx.timestamp;
+    const value = a(ctx);
+    const dt = (ctx.timestamp - sample.time) / 1e6;
+    const rate = sample.time === 0 || dt <= 0 ? NaN : (value - sample.value) / dt;
+    if (value === value && dt !== 0) {
+      sample.value = value;
+      sample.time = ctx.timestamp;
+    }
+    return sample.rate = rate;
+  };
+}
+
+function not(x: number): number {
+  return x !== x ? NaN : x === 0 ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+// Command queue: response matching, adaptive timeout, retries and sending
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import { setTimeout as sleep } from 'node:timers/promises';
+import { CommandQueue, DeviceUnreachableError, Transmit } from '../protocol/command-queue';
+
+const frame = (n: number) => Buffer.from([n]);
+
+// A transmit that records each frame, sent at once
+function recorder(): { sent: number[]; transmit: Transmit } {
+  const sent: number[] = [];
+  return { sent, transmit: data => { sent.push(data[0]); } };
+}
+
+test('pipelines up to its depth and matches responses in order', async () => {
+  const { sent, transmit } = recorder();
+  const queue = new CommandQueue(transmit, { pipelineDepth: 2 });
+  const replies = [1, 2, 3].map(n => queue.enqueue(frame(n)));
+  assert.deepEqual(sent, [1, 2]);
+  queue.handleResponse(Buffer.from('a'));
+  assert.deepEqual(sent, [1, 2, 3]);
+  queue.handleResponse(Buffer.from('b'));
+  queue.handleResponse(Buffer.from('c'));
+  assert.deepEqual((await Promise.all(replies)).map(String), ['a', 'b', 'c']);
+  assert.equal(queue.pending, 0);
+});
+
+test('adapts its timeout to round trips and backs off after a timeout', async () => {
+  const { transmit } = recorder();
+  const queue = new CommandQueue(transmit, { timeoutMs: 2000, minTimeoutMs: 20, resyncMs: 1, retries: 1 });
+  assert.equal(queue.timeout, 2000);
+  const first = queue.enqueue(frame(1));
+  queue.handleResponse(Buffer.alloc(0));
+  await first;
+  assert.equal(queue.timeout, 20);
+
+  const second = queue.enqueue(frame(2));
+  await sleep(30);
+  assert.equal(queue.timeout, 40);
+  queue.handleResponse(Buffer.alloc(0));
+  await second;
+});
+
+test('resends idempotent commands after a timeout, in order', async () => {
+  const { sent, transmit } = recorder();
+  const queue = new CommandQueue(transmit, { timeoutMs: 20, resyncMs: 1, retries: 1, unreachableAfter: 5 });
+  const replies = [queue.enqueue(frame(1)), queue.enqueue(frame(2))];
+  await sleep(30);
+  assert.deepEqual(sent, [1, 2, 1, 2]);
+  queue.handleResponse(Buffer.from('a'));
+  queue.handleResponse(Buffer.from('b'));
+  assert.deepEqual((await Promise.all(replies)).map(String), ['a', 'b']);
+  assert.equal(queue.getMetrics().retries, 2);
+});
+
+test('never resends a command that is not idempotent', async () => {
+  const { sent, transmit } = recorder();
+  const queue = new CommandQueue(transmit, { timeoutMs: 20, resyncMs: 1, retries: 3, unreachableAfter: 5 });
+  await assert.rejects(queue.enqueue(frame(1), { idempotent: false }), /not resent/);
+  assert.deepEqual(sent, [1]);
+});
+
+test('fails everything queued once the device stops answering', async () => {
+  const { transmit } = recorder();
+  const queue = new CommandQueue(transmit, { timeoutMs: 20, resyncMs: 1, pipelineDepth: 1, unreachableAfter: 2 });
+  const replies = [1, 2, 3].map(n => queue.enqueue(frame(n)));
+  await assert.rejects(replies[0], /No response/);
+  await assert.rejects(replies[1], DeviceUnreachableError);
+  await assert.rejects(replies[2], DeviceUnreachableError);
+});
+
+test('starts the timeout once the frame is sent', async () => {
+  const transmit: Transmit = () => sleep(60);
+  const queue = new CommandQueue(transmit, { timeoutMs: 40 });
+  const reply = queue.enqueue(frame(1), { timeoutMs: 40 });
+  await sleep(80);  // Sent at 60 ms; 20 ms into its timeout
+  queue.handleResponse(Buffer.from('a'));
+  assert.equal(String(await reply), 'a');
+  assert.equal(queue.getMetrics().timeouts, 0);
+});
+
+test('fails a command whose frame was never sent, without a timeout', async () => {
+  const transmit: Transmit = () => Promise.reject(new Error('Frame not sent'));
+  const queue = new CommandQueue(transmit);
+  await assert.rejects(queue.enqueue(frame(1)), /Frame not sent/);
+  assert.equal(queue.getMetrics().timeouts, 0);
+  assert.equal(queue.pending, 0);
+});
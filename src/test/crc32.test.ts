@@ -0,0 +1,15 @@
+// CRC-32 used to check firmware images
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import { crc32 } from '../provision/firmware';
+
+test('matches the IEEE 802.3 check value', () => {
+  assert.equal(crc32(Buffer.from('123456789')), 0xCBF43926);
+  assert.equal(crc32(Buffer.alloc(0)), 0);
+});
+
+test('continues across blocks', () => {
+  const image = Buffer.from('The quick brown fox jumps over the lazy dog');
+  assert.equal(crc32(image), 0x414FA339);
+  assert.equal(crc32(image.subarray(10), crc32(image.subarray(0, 10))), crc32(image));
+});
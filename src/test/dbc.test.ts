@@ -0,0 +1,112 @@
+// DBC import: parsing, bit extraction, not-available values and multiplexing
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import { DbcDecoder, parseDbc, pgnOf } from '../protocol/dbc';
+
+const DBC = `
+VERSION ""
+
+BO_ 2364540158 EEC1: 8 Vector__XXX
+ SG_ EngineSpeed : 24|16@1+ (0.125,0) [0|8031.875] "rpm" Vector__XXX
+ SG_ Torque : 16|8@1+ (1,-125) [-125|125] "%" Vector__XXX
+
+BO_ 2566845182 PROP: 8 Vector__XXX
+ SG_ Big : 7|16@0+ (1,0) [0|65535] "" Vector__XXX
+ SG_ Mode M : 16|8@1+ (1,0) [0|255] "" Vector__XXX
+ SG_ A m1 : 24|8@1+ (1,0) [0|255] "" Vector__XXX
+ SG_ B m2 : 24|8@1- (1,0) [-128|127] "" Vector__XXX
+
+BO_ 2566845438 NESTED: 8 Vector__XXX
+ SG_ Outer M : 0|8@1+ (1,0) [0|255] "" Vector__XXX
+ SG_ Inner m1M : 8|8@1+ (1,0) [0|255] "" Vector__XXX
+ SG_ Leaf m2 : 16|8@1+ (1,0) [0|255] "" Vector__XXX
+
+BO_ 100 STANDARD: 8 Vector__XXX
+ SG_ Ignored : 0|8@1+ (1,0) [0|255] "" Vector__XXX
+
+BO_ 3221225472 VECTOR__INDEPENDENT_SIG_MSG: 0 Vector__XXX
+ SG_ Orphan : 0|8@1+ (1,0) [0|255] "" Vector__XXX
+
+CM_ BO_ 2364540158 "Engine controller";
+`;
+
+const EEC1 = 0x0CF004FE;
+const PROP = 0x18FEF2FE;
+const frame = (...bytes: number[]) => Buffer.from([...bytes, ...new Array(8 - bytes.length).fill(0xFF)]);
+
+test('parses extended-ID messages and their signals', () => {
+  const messages = parseDbc(DBC);
+  assert.deepEqual(messages.map(m => m.name), ['EEC1', 'PROP', 'NESTED']);
+  const eec1 = messages[0];
+  assert.equal(eec1.pgn, 0xF004);
+  assert.equal(eec1.sourceAddress, 0xFE);
+  assert.deepEqual(eec1.signals[0], {
+    name: 'EngineSpeed', startBit: 24, length: 16, littleEndian: true, signed: false, factor: 0.125, offset: 0,
+    minimum: 0, maximum: 8031.875, unit: 'rpm', multiplexor: false, multiplex: null,
+  });
+  assert.deepEqual(messages[1].signals.map(s => [s.name, s.multiplexor, s.multiplex]), [
+    ['Big', false, null], ['Mode', true, null], ['A', false, 1], ['B', false, 2],
+  ]);
+});
+
+test('skips signals that need extended multiplexing', () => {
+  const nested = parseDbc(DBC)[2];
+  assert.deepEqual(nested.signals.map(s => s.name), ['Outer']);
+  assert.equal(nested.skipped.length, 2);
+  assert.deepEqual(new DbcDecoder(parseDbc(DBC)).skipped.map(s => s.split(':')[0]), ['NESTED.Inner', 'NESTED.Leaf']);
+});
+
+test('reports malformed lines with their number', () => {
+  assert.throws(() => parseDbc('BO_ 2364540158 EEC1: 8 X\n SG_ Broken : 24|16@1+ (0.125'), /DBC line 2: malformed signal/);
+  assert.throws(() => parseDbc('BO_ 2364540158 EEC1: 8 X\n SG_ Wide : 0|64@1+ (1,0) [0|1] "" X'), /64 bits/);
+});
+
+test('finds the PGN of PDU1 and PDU2 identifiers', () => {
+  assert.equal(pgnOf(0x18EA00FE), 0xEA00);
+  assert.equal(pgnOf(0x18FEF2FE), 0xFEF2);
+  assert.equal(pgnOf(0x19F00400), 0x1F004);
+});
+
+test('decodes Intel and Motorola signals with scaling', () => {
+  const decoder = new DbcDecoder(parseDbc(DBC));
+  assert.equal(decoder.decode(EEC1, frame(0xFF, 0xFF, 150, 0x40, 0x1F), 0, 8, 1000), true);
+  assert.equal(decoder.get('EEC1.EngineSpeed'), 1000);
+  assert.equal(decoder.get('Torque'), 25);
+  decoder.decode(PROP, frame(0x12, 0x34, 0), 0, 8, 1000);
+  assert.equal(decoder.get('PROP.Big'), 0x1234);
+});
+
+test('reads not-available raw values as unknown', () => {
+  const decoder = new DbcDecoder(parseDbc(DBC));
+  decoder.decode(EEC1, frame(0xFF, 0xFF, 150, 0x40, 0x1F), 0, 8, 1000);
+  decoder.decode(EEC1, frame(0xFF, 0xFF, 150, 0x00, 0xFB), 0, 8, 2000);
+  assert.equal(decoder.get('EngineSpeed'), undefined);
+  assert.equal(decoder.updated[decoder.slot('EngineSpeed')], 2000);
+  assert.deepEqual(decoder.snapshot(), { 'EEC1.Torque': 25 });
+});
+
+test('decodes multiplexed signals only for their multiplexor value', () => {
+  const decoder = new DbcDecoder(parseDbc(DBC));
+  decoder.decode(PROP, frame(0, 0, 1, 200), 0, 8, 1000);
+  assert.equal(decoder.get('A'), 200);
+  assert.equal(decoder.get('B'), undefined);
+  decoder.decode(PROP, frame(0, 0, 2, 0xFE), 0, 8, 2000);
+  assert.equal(decoder.get('A'), 200);
+  assert.equal(decoder.get('B'), -2);
+});
+
+test('matches the source address unless anySource is set', () => {
+  const other = (EEC1 & ~0xFF) | 0x00;
+  assert.equal(new DbcDecoder(parseDbc(DBC)).decode(other, frame(0, 0, 150), 0, 8, 1000), false);
+  const any = new DbcDecoder(parseDbc(DBC), { anySource: true });
+  assert.equal(any.decode(other, frame(0, 0, 150), 0, 8, 1000), true);
+  assert.equal(any.get('Torque'), 25);
+  assert.deepEqual(any.acceptance.find(a => a.pgn === 0xF004), { pgn: 0xF004, sourceAddress: -1 });
+});
+
+test('skips signals past a short frame', () => {
+  const decoder = new DbcDecoder(parseDbc(DBC));
+  decoder.decode(EEC1, Buffer.from([0xFF, 0xFF, 150, 0x40]), 0, 4, 1000);
+  assert.equal(decoder.get('Torque'), 25);
+  assert.equal(decoder.updated[decoder.slot('EngineSpeed')], 0);
+});
@@ -0,0 +1,77 @@
+// Decoder table: scaling, not-available values, short frames and masks
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import { PGN, SIGNAL, SignalStore } from '../protocol/decoder';
+
+// ENGINE_TEMP_1: coolant byte 0, fuel byte 2, oil byte 3, all raw - 40
+function engineTemp1(coolant: number, fuel: number, oil: number): Buffer {
+  return Buffer.from([coolant, 0xFF, fuel, oil, 0xFF, 0xFF, 0xFF, 0xFF]);
+}
+
+test('decodes and scales each field, stamping its sample time', () => {
+  const store = new SignalStore();
+  assert.equal(store.decode(PGN.ENGINE_TEMP_1, engineTemp1(130, 60, 140), 0, 8, 1000), true);
+  assert.equal(store.get(SIGNAL.coolantTemp), 90);
+  assert.equal(store.get(SIGNAL.fuelTemp), 20);
+  assert.equal(store.get(SIGNAL.oilTemp), 100);
+  assert.equal(store.updated[SIGNAL.coolantTemp], 1000);
+  assert.equal(store.lastUpdate, 1000);
+});
+
+test('reports changed signals only', () => {
+  const store = new SignalStore();
+  store.decode(PGN.ENGINE_TEMP_1, engineTemp1(130, 60, 140), 0, 8, 1000);
+  const version = store.version;
+
+  assert.equal(store.decode(PGN.ENGINE_TEMP_1, engineTemp1(130, 60, 140), 0, 8, 2000), false);
+  assert.equal(store.changedMask, 0);
+  assert.equal(store.version, version);
+  assert.equal(store.updated[SIGNAL.oilTemp], 2000);
+
+  assert.equal(store.decode(PGN.ENGINE_TEMP_1, engineTemp1(130, 61, 140), 0, 8, 3000), true);
+  assert.equal(store.changedMask, 1 << SIGNAL.fuelTemp);
+  assert.equal(store.version, version + 1);
+});
+
+test('leaves not-available fields untouched', () => {
+  const store = new SignalStore();
+  store.decode(PGN.ENGINE_TEMP_1, engineTemp1(0xFF, 60, 0xFF), 0, 8, 1000);
+  assert.ok(Number.isNaN(store.get(SIGNAL.coolantTemp)));
+  assert.equal(store.updated[SIGNAL.coolantTemp], 0);
+  assert.equal(store.get(SIGNAL.fuelTemp), 20);
+});
+
+test('skips fields past a short frame', () => {
+  const store = new SignalStore();
+  store.decode(PGN.ENGINE_TEMP_1, engineTemp1(130, 60, 140), 0, 3, 1000);
+  assert.equal(store.get(SIGNAL.fuelTemp), 20);
+  assert.ok(Number.isNaN(store.get(SIGNAL.oilTemp)));
+});
+
+test('decodes two-byte little-endian fields at an offset into a batch', () => {
+  const store = new SignalStore();
+  // INLET_EXHAUST EGT at bytes 2-3, 0.03125 C/bit - 273
+  const batch = new Uint8Array(16).fill(0xFF);
+  const raw = (500 + 273) / 0.03125;
+  batch[8 + 2] = raw & 0xFF;
+  batch[8 + 3] = raw >> 8;
+  store.decode(PGN.INLET_EXHAUST, batch, 8, 8, 1000);
+  assert.equal(store.get(SIGNAL.egtTemp), 500);
+});
+
+test('ignores PGNs it has no decoder for', () => {
+  const store = new SignalStore();
+  assert.equal(store.decodes(0xFECA), false);
+  assert.equal(store.decode(0xFECA, Buffer.alloc(8), 0, 8, 1000), false);
+  assert.equal(store.decode(0x1234, Buffer.alloc(8), 0, 8, 1000), false);
+  assert.equal(store.lastUpdate, 0);
+});
+
+test('marks as sampled only the fields a frame carried', () => {
+  const store = new SignalStore();
+  store.decode(PGN.ENGINE_TEMP_1, engineTemp1(130, 0xFF, 140), 0, 8, 1000);
+  assert.equal(store.sampledMask, (1 << SIGNAL.coolantTemp) | (1 << SIGNAL.oilTemp));
+  store.decode(PGN.ENGINE_TEMP_1, engineTemp1(130, 60, 140), 0, 3, 2000);
+  assert.equal(store.sampledMask, (1 << SIGNAL.coolantTemp) | (1 << SIGNAL.fuelTemp));
+  assert.equal(store.changedMask, 1 << SIGNAL.fuelTemp);
+});
@@ -0,0 +1,104 @@
+// Rules engine: derived values, alarm states, hysteresis and rate()
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import { PGN, SignalStore } from '../protocol/decoder';
+import { AlarmEvent, RuleEngine, RuleSet } from '../rules/engine';
+
+const SECOND = 1_000_000;
+
+// Feeds ENGINE_TEMP_1 (coolant, byte 0) and INLET_EXHAUST (EGT, bytes 2-3)
+// frames to an engine, recording its alarm events
+function harness(rules: RuleSet) {
+  const store = new SignalStore();
+  const engine = new RuleEngine(rules);
+  const events: string[] = [];
+  engine.onAlarm((event: AlarmEvent) => events.push(`${event.alarm} ${event.kind}`));
+  const feed = (pgn: number, frame: Buffer, seconds: number) => {
+    const timestamp = SECOND + seconds * SECOND;
+    store.decode(pgn, frame, 0, 8, timestamp);
+    engine.update(store, store.changedMask, timestamp, store.sampledMask);
+  };
+  return {
+    engine,
+    events,
+    coolant: (value: number, seconds: number) => {
+      feed(PGN.ENGINE_TEMP_1, Buffer.from([value + 40, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF]), seconds);
+    },
+    egt: (value: number, seconds: number) => {
+      const frame = Buffer.alloc(8, 0xFF);
+      frame.writeUInt16LE((value + 273) / 0.03125, 2);
+      feed(PGN.INLET_EXHAUST, frame, seconds);
+    },
+  };
+}
+
+test('evaluates derived values in dependency order', () => {
+  const { engine, coolant } = harness({
+    derived: {
+      doubled: { expr: 'twice * 1' },
+      twice: { expr: 'coolantTemp * 2', unit: 'C' },
+    },
+  });
+  assert.ok(Number.isNaN(engine.value('twice')));
+  coolant(90, 0);
+  assert.equal(engine.value('twice'), 180);
+  assert.equal(engine.value('doubled'), 180);
+  assert.deepEqual(engine.snapshot(), { doubled: 180, twice: 180 });
+});
+
+test('rejects cycles and names that shadow decoded signals', () => {
+  assert.throws(() => new RuleEngine({ derived: { a: { expr: 'b' }, b: { expr: 'a' } } }), /a -> b -> a|b -> a -> b/);
+  assert.throws(() => new RuleEngine({ derived: { coolantTemp: { expr: '1' } } }), /shadows/);
+  assert.throws(() => new RuleEngine({ alarms: { hot: { when: 'nosuch > 1' } } }), /Alarm 'hot'/);
+  // Inherited object keys are not signals
+  assert.throws(() => new RuleEngine({ alarms: { odd: { when: 'toString > 1' } } }), /Alarm 'odd'/);
+  assert.doesNotThrow(() => new RuleEngine({ derived: { constructor: { expr: '1' } } }));
+});
+
+test('raises and clears with hysteresis', () => {
+  const { engine, events, coolant } = harness({ alarms: { hot: { when: 'coolantTemp > 100', hysteresis: 5 } } });
+  coolant(101, 0);
+  coolant(97, 1);
+  assert.equal(engine.alarms()[0].state, 'active');
+  coolant(95, 2);
+  assert.equal(engine.alarms()[0].state, 'normal');
+  assert.deepEqual(events, ['hot raised', 'hot cleared']);
+});
+
+test('holds an alarm for forMs, raising on the first frame past the delay', () => {
+  const { engine, events, coolant } = harness({ alarms: { hot: { when: 'coolantTemp > 100', forMs: 2000 } } });
+  coolant(101, 0);
+  assert.equal(engine.alarms()[0].state, 'pending');
+  coolant(101, 1);
+  assert.deepEqual(events, []);
+  coolant(101, 2);
+  assert.deepEqual(events, ['hot raised']);
+});
+
+test('keeps a latched alarm until it is acknowledged', () => {
+  const { engine, events, coolant } = harness({ alarms: { hot: { when: 'coolantTemp > 100', latch: true } } });
+  coolant(101, 0);
+  coolant(90, 1);
+  assert.equal(engine.alarms()[0].state, 'latched');
+  assert.equal(engine.acknowledge('hot'), true);
+  assert.equal(engine.alarms()[0].state, 'normal');
+  assert.deepEqual(events, ['hot raised', 'hot cleared']);
+});
+
+test('raises, clears and re-raises a rate() alarm with hysteresis', () => {
+  const { engine, events, egt } = harness({ alarms: { rising: { when: 'rate(egtTemp) > 20', hysteresis: 5 } } });
+  const state = () => engine.alarms()[0].state;
+  egt(500, 0);
+  egt(530, 1);  // 30 C/s
+  assert.equal(state(), 'active');
+  egt(550, 2);  // 20 C/s, within the hysteresis
+  assert.equal(state(), 'active');
+  egt(550, 3);  // Steady: the unchanged frame still samples rate()
+  assert.equal(state(), 'normal');
+  for (let t = 4; t <= 100; t++) egt(550, t);
+  egt(580, 101);
+  assert.equal(state(), 'active');
+  egt(605, 102);  // 25 C/s against the previous frame, not the last time it was active
+  assert.equal(state(), 'active');
+  assert.deepEqual(events, ['rising raised', 'rising cleared', 'rising raised']);
+});
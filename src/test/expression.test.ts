@@ -0,0 +1,59 @@
+// Expression parser and compiler
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import { EvalContext, ExpressionError, compileExpression, expressionInputs, parseExpression } from '../rules/expression';
+
+// Names a..c are signals 0..2
+function evaluate(source: string, signals: number[] = [], timestamp = 1): number {
+  const resolve = (name: string) => {
+    const signal = ['a', 'b', 'c'].indexOf(name);
+    return signal < 0 ? undefined : { signal };
+  };
+  const ctx: EvalContext = { signals: Float64Array.from(signals), derived: new Float64Array(0), timestamp };
+  return compileExpression(parseExpression(source), resolve)(ctx);
+}
+
+test('follows operator precedence and associativity', () => {
+  assert.equal(evaluate('1 + 2 * 3'), 7);
+  assert.equal(evaluate('10 - 4 - 3'), 3);
+  assert.equal(evaluate('-2 * -3'), 6);
+  assert.equal(evaluate('1 + 2 > 2 && 0 || 1'), 1);
+  assert.equal(evaluate('1 ? 0 ? 5 : 6 : 7'), 6);
+  assert.equal(evaluate('(1 + 2) * 3'), 9);
+});
+
+test('reads signals, with NaN for unseen ones propagating', () => {
+  assert.equal(evaluate('max(a, b, c) - min(a, b)', [3, 1, 7]), 6);
+  assert.ok(Number.isNaN(evaluate('a > 1', [NaN])));
+  assert.ok(Number.isNaN(evaluate('!a', [NaN])));
+  assert.equal(evaluate('!a', [0]), 1);
+});
+
+test('collects the names an expression reads', () => {
+  assert.deepEqual([...expressionInputs(parseExpression('a > 1 ? rate(b) : abs(c)'))], ['a', 'b', 'c']);
+});
+
+test('reports syntax errors with their position', () => {
+  assert.throws(() => parseExpression('1 +'), ExpressionError);
+  assert.throws(() => parseExpression('1 + )'), /Unexpected '\)' at 5/);
+  assert.throws(() => parseExpression('nosuch(1)'), /Unknown function 'nosuch'/);
+  assert.throws(() => parseExpression('abs(1, 2)'), /Wrong number of arguments to abs\(\)/);
+  assert.throws(() => parseExpression('a ? 1'), /Expected ':'/);
+});
+
+test('rejects unknown names at compile time', () => {
+  assert.throws(() => evaluate('d + 1'), /d/);
+});
+
+test('rate() gives change per second between samples', () => {
+  const resolve = () => ({ signal: 0 });
+  const rate = compileExpression(parseExpression('rate(a)'), resolve);
+  const at = (value: number, seconds: number) => rate({
+    signals: Float64Array.of(value), derived: new Float64Array(0), timestamp: seconds * 1e6,
+  });
+  assert.ok(Number.isNaN(at(10, 1)));
+  assert.equal(at(16, 3), 3);
+  assert.equal(at(16, 3), 3);  // Same sample again
+  assert.ok(Number.isNaN(at(NaN, 4)));
+  assert.equal(at(22, 5), 3);  // Against the last known value
+});
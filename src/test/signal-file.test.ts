@@ -0,0 +1,93 @@
+// Columnar signal recordings: SignalRecorder writes, SignalFile reads back
+import assert from 'node:assert/strict';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+import { after, test } from 'node:test';
+import { SignalFile } from '../capture/signal-reader';
+import { SignalRecorder, TRAILER_SIZE, unzigzag, zigzag } from '../capture/signal-recorder';
+import { PGN, SignalStore } from '../protocol/decoder';
+
+const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'ossm-sig-'));
+after(() => fs.rmSync(dir, { recursive: true, force: true }));
+
+const T0 = 1_700_000_000_000_000;
+const ROWS = 40;
+const time = (row: number) => T0 + row * 100_000;
+// Swings both ways, including the ends of the coolant range
+const COOLANT = Array.from({ length: ROWS }, (_, i) => (i === 5 ? -40 : i === 6 ? 210 : 90 + ((i * 7) % 23) - 11));
+// Fractional steps; every seventh frame has no EGT
+const EGT = Array.from({ length: ROWS }, (_, i) => (i % 7 === 3 ? NaN : 500 + ((i * 13) % 41) * 0.03125 - i));
+
+// Forty rows in groups of sixteen: coolant every row, EGT when available
+async function record(file: string): Promise<void> {
+  const store = new SignalStore();
+  const recorder = new SignalRecorder(file, store, { intervalMs: 0, groupRows: 16 });
+  COOLANT.forEach((coolant, i) => {
+    const timestamp = time(i);
+    store.decode(PGN.ENGINE_TEMP_1, Buffer.from([coolant + 40, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF]), 0, 8, timestamp);
+    const egt = Buffer.alloc(8, 0xFF);
+    if (!Number.isNaN(EGT[i])) egt.writeUInt16LE((EGT[i] + 273) / 0.03125, 2);
+    store.decode(PGN.INLET_EXHAUST, egt, 0, 8, timestamp);
+    recorder.sample(timestamp);
+  });
+  await recorder.close();
+}
+
+test('zigzag round-trips signed deltas', () => {
+  for (const v of [0, 1, -1, 2, -2, 1000, -1000, 2 ** 40, -(2 ** 40)]) assert.equal(unzigzag(zigzag(v)), v);
+  assert.equal(zigzag(-1), 1);
+  assert.equal(zigzag(1), 2);
+});
+
+test('reads back every row and group through the index', async () => {
+  const file = path.join(dir, 'all.sig');
+  await record(file);
+  const recording = new SignalFile(file);
+  try {
+    assert.equal(recording.rows, ROWS);
+    assert.deepEqual(recording.groups.map(g => g.rows), [16, 16, 8]);
+    const { timestamps, columns } = recording.query({ signals: ['coolantTemp', 'egtTemp'] });
+    assert.deepEqual([...timestamps], COOLANT.map((_, i) => time(i)));
+    assert.deepEqual([...columns.coolantTemp], COOLANT);
+    // A not-available frame leaves the last value in the store
+    assert.deepEqual([...columns.egtTemp], EGT.map((v, i) => (Number.isNaN(v) ? EGT[i - 1] : v)));
+    assert.ok(Number.isNaN(recording.query({ signals: ['oilTemp'] }).columns.oilTemp[0]));
+  } finally {
+    recording.close();
+  }
+});
+
+test('queries a time range across group boundaries', async () => {
+  const file = path.join(dir, 'range.sig');
+  await record(file);
+  const recording = new SignalFile(file);
+  try {
+    const { timestamps, columns } = recording.query({ from: time(14), to: time(18), signals: ['coolantTemp'] });
+    assert.deepEqual([...timestamps], [14, 15, 16, 17, 18].map(time));
+    assert.deepEqual([...columns.coolantTemp], COOLANT.slice(14, 19));
+    assert.deepEqual(Object.keys(columns), ['coolantTemp']);
+    assert.throws(() => recording.query({ signals: ['nosuch'] }), /Unknown signal 'nosuch'/);
+  } finally {
+    recording.close();
+  }
+});
+
+test('still reads a file whose index was never written', async () => {
+  const file = path.join(dir, 'cut.sig');
+  await record(file);
+  fs.truncateSync(file, fs.statSync(file).size - TRAILER_SIZE);
+  const recording = new SignalFile(file);
+  try {
+    assert.equal(recording.rows, ROWS);
+    assert.deepEqual([...recording.query({ signals: ['coolantTemp'] }).columns.coolantTemp], COOLANT);
+  } finally {
+    recording.close();
+  }
+});
+
+test('rejects files that are not recordings', () => {
+  const file = path.join(dir, 'other.bin');
+  fs.writeFileSync(file, Buffer.alloc(64));
+  assert.throws(() => new SignalFile(file), /not a signal recording/);
+});
@@ -0,0 +1,75 @@
+// Signal subscriptions: deadband, interval and trailing delivery
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import { setTimeout as sleep } from 'node:timers/promises';
+import { PGN, SignalStore } from '../protocol/decoder';
+import { SignalSubscriptions, SignalUpdate } from '../protocol/subscriptions';
+
+const MS = 1000;
+
+// Decodes ENGINE_TEMP_1 (coolant byte 0, oil byte 3, both raw - 40) and
+// dispatches the changes
+function harness() {
+  const store = new SignalStore();
+  const subscriptions = new SignalSubscriptions();
+  const feed = (coolant: number, oil: number, ms: number) => {
+    const timestamp = 1_000_000 + ms * MS;
+    store.decode(PGN.ENGINE_TEMP_1, Buffer.from([coolant + 40, 0xFF, 0xFF, oil + 40, 0xFF, 0xFF, 0xFF, 0xFF]), 0, 8, timestamp);
+    subscriptions.dispatch(store, store.changedMask, timestamp);
+  };
+  return { subscriptions, feed };
+}
+
+const describe = (u: SignalUpdate) => `${u.signal}=${u.value}`;
+
+test('delivers changes to the subscribed signals only', () => {
+  const { subscriptions, feed } = harness();
+  const updates: string[] = [];
+  const unsubscribe = subscriptions.subscribe('coolantTemp', u => updates.push(describe(u)));
+  feed(90, 100, 0);
+  feed(90, 101, 10);
+  feed(91, 101, 20);
+  unsubscribe();
+  feed(92, 101, 30);
+  assert.deepEqual(updates, ['coolantTemp=90', 'coolantTemp=91']);
+});
+
+test('applies the deadband against the last delivered value', () => {
+  const { subscriptions, feed } = harness();
+  const updates: SignalUpdate[] = [];
+  subscriptions.subscribe('coolantTemp', u => updates.push(u), { deadband: 2 });
+  for (const [i, value] of [90, 91, 92, 93, 94].entries()) feed(value, 100, i);
+  assert.deepEqual(updates.map(u => u.value), [90, 92, 94]);
+  assert.equal(updates[1].previous, 90);
+});
+
+test('holds changes inside the interval and delivers the latest when it is up', async () => {
+  const { subscriptions, feed } = harness();
+  const updates: string[] = [];
+  subscriptions.subscribe('coolantTemp', u => updates.push(describe(u)), { minIntervalMs: 30 });
+  feed(90, 100, 0);
+  feed(91, 100, 5);
+  feed(92, 100, 10);
+  assert.deepEqual(updates, ['coolantTemp=90']);
+  await sleep(50);
+  assert.deepEqual(updates, ['coolantTemp=90', 'coolantTemp=92']);
+});
+
+test('delivers each held signal at its own due time', async () => {
+  const { subscriptions, feed } = harness();
+  const updates: string[] = [];
+  subscriptions.subscribe(['coolantTemp', 'oilTemp'], u => updates.push(describe(u)), { minIntervalMs: 60 });
+  feed(90, 0xFF - 40, 0);  // Oil not available yet
+  feed(90, 100, 40);       // Oil's first value
+  feed(91, 101, 50);       // Coolant due 10 ms from now, oil 50 ms
+  assert.deepEqual(updates, ['coolantTemp=90', 'oilTemp=100']);
+  await sleep(25);
+  assert.deepEqual(updates, ['coolantTemp=90', 'oilTemp=100', 'coolantTemp=91']);
+  await sleep(45);
+  assert.deepEqual(updates, ['coolantTemp=90', 'oilTemp=100', 'coolantTemp=91', 'oilTemp=101']);
+});
+
+test('rejects unknown signal names, including inherited keys', () => {
+  const { subscriptions } = harness();
+  assert.throws(() => subscriptions.subscribe('toString' as never, () => {}), /Unknown signal 'toString'/);
+});
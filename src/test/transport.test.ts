@@ -0,0 +1,87 @@
+// Transport protocol: RTS/CTS and BAM transfers between two endpoints
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import { PGN_TP_DT, TP_MAX_SIZE, TransportProtocol } from '../protocol/transport';
+
+const PGN_CONFIG = 0xFF01;
+
+interface Received {
+  pgn: number;
+  source: number;
+  data: Buffer;
+}
+
+// Two endpoints on one simulated bus. Frames reach the other endpoint on
+// the next turn of the event loop, unless `drop` rejects them.
+function link(options: { ctsWindow?: number; drop?: (canId: number, data: Buffer) => boolean } = {}) {
+  const received: Received[] = [];
+  const endpoints: [number, TransportProtocol][] = [];
+  const make = (localAddress: number) => new TransportProtocol({
+    localAddress,
+    ctsWindow: options.ctsWindow,
+    bamGapMs: 0,
+    transmit: (canId, data) => {
+      if (options.drop?.(canId, data)) return;
+      setImmediate(() => {
+        const pgn = (canId >> 8) & 0xFF00;
+        for (const [address, endpoint] of endpoints) {
+          if (address !== localAddress) endpoint.handleFrame(pgn, localAddress, (canId >> 8) & 0xFF, data, 0, data.length, 0);
+        }
+      });
+    },
+    onMessage: (pgn, source, data) => received.push({ pgn, source, data: Buffer.from(data) }),
+  });
+  const tool = make(0xFE);
+  const module = make(0x95);
+  endpoints.push([0xFE, tool], [0x95, module]);
+  return { tool, module, received };
+}
+
+const payload = (size: number) => Buffer.from(Array.from({ length: size }, (_, i) => i & 0xFF));
+
+test('carries an RTS/CTS message across several CTS windows', async () => {
+  const { tool, received } = link({ ctsWindow: 4 });
+  await tool.send(PGN_CONFIG, 0x95, payload(100));
+  assert.equal(received.length, 1);
+  assert.equal(received[0].pgn, PGN_CONFIG);
+  assert.equal(received[0].source, 0xFE);
+  assert.deepEqual(received[0].data, payload(100));
+});
+
+test('reassembles a broadcast (BAM) message', async () => {
+  const { module, received } = link();
+  await module.send(PGN_CONFIG, 0xFF, payload(20));
+  await new Promise(resolve => setImmediate(resolve));
+  assert.equal(received.length, 1);
+  assert.equal(received[0].source, 0x95);
+  assert.deepEqual(received[0].data, payload(20));
+});
+
+test('asks again from a lost packet', async () => {
+  let dropped = false;
+  const { tool, received } = link({
+    drop: (canId, data) => {
+      const lose = !dropped && ((canId >> 8) & 0xFF00) === PGN_TP_DT && data[0] === 3;
+      if (lose) dropped = true;
+      return lose;
+    },
+  });
+  await tool.send(PGN_CONFIG, 0x95, payload(50));
+  assert.equal(dropped, true);
+  assert.deepEqual(received[0].data, payload(50));
+});
+
+test('serialises transfers to the same destination', async () => {
+  const { tool, received } = link();
+  await Promise.all([tool.send(PGN_CONFIG, 0x95, payload(30)), tool.send(PGN_CONFIG, 0x95, payload(40))]);
+  assert.deepEqual(received.map(r => r.data.length), [30, 40]);
+});
+
+test('rejects payloads over the TP maximum and fails sends on close', async () => {
+  const { tool } = link({ drop: () => true });
+  await assert.rejects(tool.send(PGN_CONFIG, 0x95, Buffer.alloc(TP_MAX_SIZE + 1)), /too large/);
+  const pending = tool.send(PGN_CONFIG, 0x95, payload(20));
+  await new Promise(resolve => setImmediate(resolve));
+  tool.close();
+  await assert.rejects(pending, /Transport closed/);
+});
@@ -0,0 +1,61 @@
+// PGN watchdog: missed frames, jitter and staleness on the frame clock
+import assert from 'node:assert/strict';
+import { afterEach, beforeEach, test, mock } from 'node:test';
+import { PGN, SIGNAL } from '../protocol/decoder';
+import { PgnWatchdog } from '../protocol/watchdog';
+
+const ADDRESS = 0x95;
+let watchdog: PgnWatchdog;
+
+beforeEach(() => {
+  mock.timers.enable({ apis: ['setInterval', 'Date'], now: 1_700_000_000_000 });
+  watchdog = new PgnWatchdog();
+});
+
+afterEach(() => {
+  watchdog.close();
+  mock.timers.reset();
+});
+
+// INLET_EXHAUST is expected every 500 ms
+const frame = () => watchdog.seen(ADDRESS, PGN.INLET_EXHAUST, Date.now() * 1000);
+const health = () => watchdog.health(ADDRESS)[0];
+
+test('counts missed frames and jitter from the gaps between frames', () => {
+  frame();
+  mock.timers.tick(520);
+  frame();
+  mock.timers.tick(1000);
+  frame();
+  assert.equal(health().frames, 3);
+  assert.equal(health().missed, 1);
+  assert.equal(health().maxJitterUs, 20_000);
+  assert.equal(health().stale, false);
+});
+
+test('goes stale after three intervals and keeps counting misses', () => {
+  const changes: boolean[] = [];
+  watchdog.onStale(h => changes.push(h.stale));
+  frame();
+  mock.timers.tick(1400);
+  assert.equal(health().stale, false);
+  mock.timers.tick(200);
+  assert.equal(health().stale, true);
+  assert.equal(health().missed, 2);
+  assert.equal(watchdog.staleMask(ADDRESS) & (1 << SIGNAL.egtTemp), 1 << SIGNAL.egtTemp);
+
+  mock.timers.tick(1500);  // 3.1 s without a frame
+  assert.equal(health().missed, 5);
+  frame();
+  assert.equal(health().missed, 5);
+  assert.equal(health().stale, false);
+  assert.deepEqual(changes, [true, false]);
+  assert.equal(watchdog.staleMask(ADDRESS), 0);
+});
+
+test('ignores PGNs it has no interval for', () => {
+  const watchdog = new PgnWatchdog({ intervals: { [PGN.INLET_EXHAUST]: 0 } });
+  watchdog.seen(ADDRESS, PGN.INLET_EXHAUST, Date.now() * 1000);
+  assert.deepEqual(watchdog.health(), []);
+  watchdog.close();
+});
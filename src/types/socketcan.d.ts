@@ -1,9 +1,25 @@
 declare module 'socketcan' {
+  export interface RawMessage {
+    id: number;
+    data: Buffer;
+    ext: boolean;
+    rtr?: boolean;
+    ts_sec?: number;   // Present when the channel was created with timestamps
+    ts_usec?: number;
+  }
+
+  export interface RawFilter {
+    id: number;       // can_id, including CAN_EFF_FLAG for extended IDs
+    mask: number;     // can_mask
+    invert?: boolean;
+  }
+
   export interface RawChannel {
-    addListener(event: 'onMessage', callback: (msg: { id: number; data: Buffer; ext: boolean }) => void): void;
+    addListener(event: 'onMessage', callback: (msg: RawMessage) => void): void;
     start(): void;
     stop(): void;
     send(msg: { id: number; data: Buffer; ext: boolean }): void;
+    setRxFilters(filters: RawFilter[]): void;  // CAN_RAW_FILTER
   }
 
   export function createRawChannel(ifname: string, timestamps?: boolean): RawChannel;
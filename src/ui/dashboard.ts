@@ -0,0 +1,205 @@
+// Rate-limited, in-place live data dashboard
+//
+// Instead of printing on every frame, the dashboard samples the signal
+// store at a fixed rate and rewrites only the cells whose value changed
+// since the last redraw, so any number of frames between ticks costs one
+// small terminal write. Values not received for a few broadcast intervals
+// are dimmed. Signals of a DBC decoder, if given, follow in rows below.
+import type { DbcDecoder } from '../protocol/dbc';
+import { SIGNAL, SIGNAL_COUNT, SignalSource } from '../protocol/decoder';
+import { staleSignals } from '../protocol/watchdog';
+
+interface Cell {
+  signal: number;
+  label: string;
+  unit: string;
+  decimals: number;
+}
+
+// Rows of cells, same grouping as the old line-per-frame output
+const LAYOUT: { title: string; cells: Cell[] }[] = [
+  {
+    title: 'Temps',
+    cells: [
+      { signal: SIGNAL.coolantTemp, label: 'Coolant', unit: 'C', decimals: 1 },
+      { signal: SIGNAL.oilTemp, label: 'Oil', unit: 'C', decimals: 1 },
+      { signal: SIGNAL.fuelTemp, label: 'Fuel', unit: 'C', decimals: 1 },
+      { signal: SIGNAL.boostTemp, label: 'Boost', unit: 'C', decimals: 1 },
+    ],
+  },
+  {
+    title: 'Temps',
+    cells: [
+      { signal: SIGNAL.airInletTemp, label: 'AirInlet', unit: 'C', decimals: 1 },
+      { signal: SIGNAL.cacInletTemp, label: 'CAC', unit: 'C', decimals: 1 },
+      { signal: SIGNAL.egtTemp, label: 'EGT', unit: 'C', decimals: 0 },
+      { signal: SIGNAL.transferPipeTemp, label: 'Xfer', unit: 'C', decimals: 1 },
+    ],
+  },
+  {
+    title: 'Press',
+    cells: [
+      { signal: SIGNAL.oilPressure, label: 'Oil', unit: 'kPa', decimals: 0 },
+      { signal: SIGNAL.fuelPressure, label: 'Fuel', unit: 'kPa', decimals: 0 },
+      { signal: SIGNAL.boostPressure, label: 'Boost', unit: 'kPa', decimals: 0 },
+      { signal: SIGNAL.coolantPressure, label: 'Coolant', unit: 'kPa', decimals: 0 },
+    ],
+  },
+  {
+    title: 'Press',
+    cells: [
+      { signal: SIGNAL.airInletPressure, label: 'AirInlet', unit: 'kPa', decimals: 0 },
+      { signal: SIGNAL.cacInletPressure, label: 'CAC', unit: 'kPa', decimals: 0 },
+    ],
+  },
+  {
+    title: 'Ambient',
+    cells: [
+      { signal: SIGNAL.ambientTemp, label: 'Ambient', unit: 'C', decimals: 1 },
+      { signal: SIGNAL.barometricPressure, label: 'Baro', unit: 'kPa', decimals: 1 },
+      { signal: SIGNAL.humidity, label: 'Humidity', unit: '%', decimals: 0 },
+      { signal: SIGNAL.engineBayTemp, label: 'EngBay', unit: 'C', decimals: 1 },
+    ],
+  },
+];
+
+const TITLE_WIDTH = 9;
+const CELL_WIDTH = 20;
+const VALUE_WIDTH = 8;
+const FIRST_ROW = 3;  // Screen row of the first cell row (1-based)
+const DBC_COLUMNS = 4;
+const DBC_LABEL_WIDTH = CELL_WIDTH - VALUE_WIDTH - 2;
+
+export interface DashboardOptions {
+  refreshHz?: number;  // Default 10
+  out?: NodeJS.WriteStream;
+  dbc?: DbcDecoder;    // Also show every DBC signal
+}
+
+export class Dashboard {
+  private readonly store: SignalSource;
+  private readonly out: NodeJS.WriteStream;
+  private readonly intervalMs: number;
+  private readonly drawn = new Float64Array(SIGNAL_COUNT);
+  private readonly positions: { row: number; col: number; cell: Cell }[] = [];
+  private readonly layout: { title: string; cells: Cell[] }[];
+  private readonly dbc: DbcDecoder | null;
+  private readonly dbcDrawn: Float64Array;
+  private readonly dbcPositions: { row: number; col: number; cell: Cell }[] = [];
+  private drawnDbcVersion = -1;
+  private drawnVersion = -1;
+  private drawnStale = 0;
+  private timer: NodeJS.Timeout | null = null;
+
+  constructor(store: SignalSource, options: DashboardOptions = {}) {
+    this.store = store;
+    this.out = options.out ?? process.stdout;
+    this.intervalMs = Math.round(1000 / Math.max(1, options.refreshHz ?? 10));
+    this.dbc = options.dbc ?? null;
+    this.dbcDrawn = new Float64Array(this.dbc?.slots.length ?? 0);
+
+    // DBC cells index the decoder's slots; 'signal' is the slot there
+    const dbcRows: { title: string; cells: Cell[] }[] = [];
+    this.dbc?.slots.forEach((slot, i) => {
+      if (i % DBC_COLUMNS === 0) dbcRows.push({ title: 'DBC', cells: [] });
+      const label = slot.signal.length > DBC_LABEL_WIDTH ? slot.signal.slice(0, DBC_LABEL_WIDTH) : slot.signal;
+      dbcRows[dbcRows.length - 1].cells.push({ signal: i, label, unit: slot.unit, decimals: 1 });
+    });
+    this.layout = [...LAYOUT, ...dbcRows];
+
+    this.layout.forEach((row, r) => {
+      const positions = r < LAYOUT.length ? this.positions : this.dbcPositions;
+      row.cells.forEach((cell, c) => {
+        const col = TITLE_WIDTH + 1 + c * CELL_WIDTH;
+        positions.push({ row: FIRST_ROW + r, col: col + cell.label.length + 2, cell });
+      });
+    });
+  }
+
+  // Rows used by the dashboard, so callers can place a prompt below it
+  get height(): number {
+    return FIRST_ROW + this.layout.length;
+  }
+
+  start(): void {
+    this.drawn.fill(NaN);
+    this.dbcDrawn.fill(NaN);
+    this.drawnVersion = -1;
+    this.drawnDbcVersion = -1;
+    this.drawnStale = 0;
+
+    if (this.out.isTTY) {
+      let frame = '\x1b[2J\x1b[H=== Live Data (press Enter to stop) ===\n';
+      this.layout.forEach((row, r) => {
+        frame += `\x1b[${FIRST_ROW + r};1H${row.title}:`;
+        row.cells.forEach((cell, c) => {
+          frame += `\x1b[${FIRST_ROW + r};${TITLE_WIDTH + 1 + c * CELL_WIDTH}H${cell.label}: ${pad('--')}`;
+        });
+      });
+      frame += `\x1b[${this.height + 1};1H`;
+      this.out.write(frame);
+    }
+
+    this.timer = setInterval(() => this.render(), this.intervalMs);
+    this.render();
+  }
+
+  stop(): void {
+    if (this.timer) {
+      clearInterval(this.timer);
+      this.timer = null;
+    }
+  }
+
+  private render(): void {
+    const store = this.store;
+    const version = store.sync();
+    const stale = staleSignals(store);
+    const dbcVersion = this.dbc?.version ?? -1;
+    if (version === this.drawnVersion && stale === this.drawnStale && dbcVersion === this.drawnDbcVersion) {
+      return;  // Nothing new since last tick
+    }
+    const restyled = stale ^ this.drawnStale;
+    this.drawnVersion = version;
+    this.drawnStale = stale;
+    this.drawnDbcVersion = dbcVersion;
+
+    const values = store.values;
+    const drawn = this.drawn;
+    let update = '';
+
+    for (const { row, col, cell } of this.positions) {
+      const v = values[cell.signal];
+      const last = drawn[cell.signal];
+      const bit = 1 << cell.signal;
+      if ((v === last || (Number.isNaN(v) && Number.isNaN(last))) && (restyled & bit) === 0) continue;
+      drawn[cell.signal] = v;
+
+      const text = `${v.toFixed(cell.decimals)}${cell.unit}`;
+      update += this.out.isTTY
+        ? `\x1b[${row};${col}H${stale & bit ? `\x1b[2m${pad(text)}\x1b[22m` : pad(text)}`
+        : `${update ? ' | ' : ''}${cell.label}: ${text}${stale & bit ? ' (stale)' : ''}`;
+    }
+
+    // DBC messages have no known interval, so they are never dimmed
+    for (const { row, col, cell } of this.dbcPositions) {
+      const v = this.dbc!.values[cell.signal];
+      const last = this.dbcDrawn[cell.signal];
+      if (v === last || (Number.isNaN(v) && Number.isNaN(last))) continue;
+      this.dbcDrawn[cell.signal] = v;
+
+      const text = `${v.toFixed(cell.decimals)}${cell.unit}`;
+      update += this.out.isTTY
+        ? `\x1b[${row};${col}H${pad(text)}`
+        : `${update ? ' | ' : ''}${cell.label}: ${text}`;
+    }
+
+    if (update === '') return;
+    // Save/restore the cursor so the pending prompt stays where it was
+    this.out.write(this.out.isTTY ? `\x1b7${update}\x1b8` : `${update}\n`);
+  }
+}
+
+function pad(text: string): string {
+  return text.length >= VALUE_WIDTH ? text : text + ' '.repeat(VALUE_WIDTH - text.length);
+}
@@ -1,27 +1,32 @@
 // BBS-style menu interface
 import * as readline from 'readline';
-import { J1939Protocol, SensorData } from '../protocol/j1939';
-
-const NTC_PRESETS = ['AEM', 'Bosch', 'GM'];
-const PRESSURE_PRESETS_BAR = [
-  '1 Bar', '1.5 Bar', '2 Bar', '2.5 Bar', '3 Bar', '4 Bar', '5 Bar',
-  '7 Bar', '10 Bar', '50 Bar', '100 Bar', '150 Bar', '200 Bar',
-  '1000 Bar', '2000 Bar', '3000 Bar'
-];
-const PRESSURE_PRESETS_PSI = [
-  '15 PSI', '30 PSI', '50 PSI', '100 PSI', '150 PSI', '200 PSI',
-  '250 PSI', '300 PSI', '350 PSI', '400 PSI', '500 PSI'
-];
-const TC_TYPES = ['B', 'E', 'J', 'K', 'N', 'R', 'S', 'T'];
+import { OssmDevice } from '../protocol/j1939';
+import {
+  NTC_PRESETS, PRESSURE_INPUTS, PRESSURE_PRESETS_BAR, PRESSURE_PRESETS_PSI, PSI_PRESET_BASE,
+  TC_TYPES, TEMP_INPUTS, pressurePresetName
+} from '../config/presets';
+import { DeviceCache, sameConfig } from '../config/cache';
+import { DeviceModel } from '../config/model';
+import { ConfigCommand, ConfigState, describeCommand } from '../config/profile';
+import { TransactionError } from '../config/transaction';
+import { HistogramSnapshot, histogramQuantile } from '../metrics/metrics';
+import type { DbcDecoder } from '../protocol/dbc';
+import { Dashboard } from './dashboard';
 
 export class Menu {
   private rl: readline.Interface;
-  private protocol: J1939Protocol;
+  private protocol: OssmDevice;
   private canInterface: string;
+  private model: DeviceModel;
+  private readonly useCache: boolean;
+  private readonly dbc: DbcDecoder | undefined;
 
-  constructor(protocol: J1939Protocol, canInterface: string) {
+  constructor(protocol: OssmDevice, canInterface: string, cache?: DeviceCache, dbc?: DbcDecoder) {
     this.protocol = protocol;
+    this.dbc = dbc;
     this.canInterface = canInterface;
+    this.model = new DeviceModel(protocol, cache);
+    this.useCache = cache !== undefined;
     this.rl = readline.createInterface({
       input: process.stdin,
       output: process.stdout
@@ -39,6 +44,12 @@ export class Menu {
   }
 
   async run(): Promise<void> {
+    // Show the cached config straight away and revalidate it meanwhile
+    if (this.useCache) {
+      this.model.loadCached().catch(() => false);
+      this.model.refresh().catch(() => {});
+    }
+
     while (true) {
       this.clear();
       console.log(`=== OSSM Config (${this.canInterface}) ===\n`);
@@ -50,6 +61,7 @@ export class Menu {
       console.log('6. Monitor live data');
       console.log('7. Save to EEPROM');
       console.log('8. Reset to defaults');
+      console.log('9. Statistics');
       console.log('0. Exit\n');
 
       const choice = await this.prompt('Choice: ');
@@ -64,6 +76,7 @@ export class Menu {
           case '6': await this.monitorLiveData(); break;
           case '7': await this.saveConfig(); break;
           case '8': await this.resetConfig(); break;
+          case '9': await this.showStatistics(); break;
           case '0':
             this.rl.close();
             return;
@@ -79,13 +92,59 @@ export class Menu {
   }
 
   private async queryConfig(): Promise<void> {
-    console.log('\nQuerying configuration...');
-    const response = await this.protocol.query();
-    console.log('\nConfiguration received (raw bytes):');
-    console.log(response.toString('hex'));
+    const cachedAt = this.model.cachedSince;
+    const cached = cachedAt ? this.model.state : null;
+    if (cached) {
+      console.log(`\n=== Last Known Configuration (cached ${formatAge(Date.now() - cachedAt)} ago) ===\n`);
+      printConfig(cached);
+    }
+
+    console.log(cached ? '\nChecking device...' : '\nQuerying configuration...');
+    const config = await this.model.refresh();
+    if (!config) {
+      // Firmware without sectioned readback only returns one status frame
+      const response = await this.protocol.query();
+      console.log('\nConfiguration received (raw bytes):');
+      console.log(response.toString('hex'));
+      await this.prompt('\nPress Enter to continue...');
+      return;
+    }
+
+    if (cached && sameConfig(cached, config)) {
+      console.log('Device matches the cached configuration.');
+    } else {
+      console.log('\n=== Current Configuration ===\n');
+      printConfig(config);
+    }
     await this.prompt('\nPress Enter to continue...');
   }
 
+  // False if the known config already has this setting and the operator
+  // chooses not to send it again
+  private async confirmChange(command: ConfigCommand): Promise<boolean> {
+    if (!this.model.isSet(command)) return true;
+
+    const source = this.model.source === 'cache' ? 'cached configuration' : 'device readback';
+    const answer = await this.prompt(`\nAlready set (${describeCommand(command)}, per ${source}). Send anyway? (y/n): `);
+    if (answer.toLowerCase().startsWith('y')) return true;
+    console.log('Nothing sent');
+    await this.prompt('Press Enter to continue...');
+    return false;
+  }
+
+  // One setting as a transaction: checked by readback where the firmware
+  // has it and put back if it does not take. Saving is left to option 7.
+  private async send(command: ConfigCommand): Promise<boolean> {
+    try {
+      await this.model.begin().stage(command).commit({ save: false, resend: true });
+      return true;
+    } catch (err) {
+      if (!(err instanceof TransactionError)) throw err;
+      console.log(`\n${err.message}`);
+      return false;
+    }
+  }
+
   private async enableSpn(): Promise<void> {
     console.log('\n=== Enable/Disable SPN ===\n');
 
@@ -111,7 +170,9 @@ export class Menu {
       if (isNaN(input)) input = 0;
     }
 
-    const success = await this.protocol.enableSpn(spn, enable, input);
+    const command: ConfigCommand = { kind: 'spn', spn, enable, input };
+    if (!(await this.confirmChange(command))) return;
+    const success = await this.send(command);
     console.log(success ? `\nOK: SPN ${spn} ${enable ? 'enabled' : 'disabled'}` : '\nFailed');
     await this.prompt('Press Enter to continue...');
   }
@@ -137,7 +198,9 @@ export class Menu {
       return;
     }
 
-    const success = await this.protocol.setNtcPreset(input, preset);
+    const command: ConfigCommand = { kind: 'ntc', input, preset };
+    if (!(await this.confirmChange(command))) return;
+    const success = await this.send(command);
     console.log(success ? `\nOK: Input ${input} set to ${NTC_PRESETS[preset]}` : '\nFailed');
     await this.prompt('Press Enter to continue...');
   }
@@ -156,7 +219,7 @@ export class Menu {
     console.log('\nBar presets (absolute/PSIA):');
     PRESSURE_PRESETS_BAR.forEach((p, i) => console.log(`  ${i}. ${p}`));
     console.log('\nPSI presets (gauge/PSIG):');
-    PRESSURE_PRESETS_PSI.forEach((p, i) => console.log(`  ${i + 20}. ${p}`));
+    PRESSURE_PRESETS_PSI.forEach((p, i) => console.log(`  ${i + PSI_PRESET_BASE}. ${p}`));
 
     const presetStr = await this.prompt('Preset number: ');
     const preset = parseInt(presetStr, 10);
@@ -166,7 +229,9 @@ export class Menu {
       return;
     }
 
-    const success = await this.protocol.setPressurePreset(input, preset);
+    const command: ConfigCommand = { kind: 'pressure', input, preset };
+    if (!(await this.confirmChange(command))) return;
+    const success = await this.send(command);
     console.log(success ? '\nOK: Preset applied' : '\nFailed');
     await this.prompt('Press Enter to continue...');
   }
@@ -185,67 +250,69 @@ export class Menu {
       return;
     }
 
-    const success = await this.protocol.setThermocoupleType(tcType);
+    const command: ConfigCommand = { kind: 'tc', tcType };
+    if (!(await this.confirmChange(command))) return;
+    const success = await this.send(command);
     console.log(success ? `\nOK: Set to Type ${TC_TYPES[tcType]}` : '\nFailed');
     await this.prompt('Press Enter to continue...');
   }
 
   private async monitorLiveData(): Promise<void> {
-    console.log('\n=== Live Data (press Enter to stop) ===\n');
-
-    let running = true;
-
-    // Set up sensor data handler
-    this.protocol.onSensorData((data: SensorData) => {
-      if (!running) return;
-      this.printSensorData(data);
-    });
+    // Redraws in place at a fixed rate from the decoded store; frames
+    // arriving between refreshes are coalesced
+    const dashboard = new Dashboard(this.protocol.getSignalStore(), { dbc: this.dbc });
+    dashboard.start();
 
     // Wait for Enter key
     await this.prompt('');
-    running = false;
-    this.protocol.onSensorData(() => {});  // Clear handler
+    dashboard.stop();
   }
 
-  private printSensorData(data: SensorData): void {
-    const time = new Date().toLocaleTimeString();
-    const lines: string[] = [];
-
-    // Temperatures
-    const temps: string[] = [];
-    if (data.coolantTemp !== undefined) temps.push(`Coolant: ${data.coolantTemp.toFixed(1)}C`);
-    if (data.oilTemp !== undefined) temps.push(`Oil: ${data.oilTemp.toFixed(1)}C`);
-    if (data.fuelTemp !== undefined) temps.push(`Fuel: ${data.fuelTemp.toFixed(1)}C`);
-    if (data.boostTemp !== undefined) temps.push(`Boost: ${data.boostTemp.toFixed(1)}C`);
-    if (temps.length > 0) lines.push(`[${time}] Temps: ${temps.join(' | ')}`);
-
-    // More temps
-    const temps2: string[] = [];
-    if (data.airInletTemp !== undefined) temps2.push(`AirInlet: ${data.airInletTemp.toFixed(1)}C`);
-    if (data.cacInletTemp !== undefined) temps2.push(`CAC: ${data.cacInletTemp.toFixed(1)}C`);
-    if (data.egtTemp !== undefined) temps2.push(`EGT: ${data.egtTemp.toFixed(0)}C`);
-    if (temps2.length > 0) lines.push(`[${time}] Temps: ${temps2.join(' | ')}`);
-
-    // Pressures
-    const press: string[] = [];
-    if (data.oilPressure !== undefined) press.push(`Oil: ${data.oilPressure}kPa`);
-    if (data.fuelPressure !== undefined) press.push(`Fuel: ${data.fuelPressure}kPa`);
-    if (data.boostPressure !== undefined) press.push(`Boost: ${data.boostPressure}kPa`);
-    if (press.length > 0) lines.push(`[${time}] Press: ${press.join(' | ')}`);
-
-    // Ambient
-    const ambient: string[] = [];
-    if (data.ambientTemp !== undefined) ambient.push(`Ambient: ${data.ambientTemp.toFixed(1)}C`);
-    if (data.barometricPressure !== undefined) ambient.push(`Baro: ${data.barometricPressure.toFixed(1)}kPa`);
-    if (data.humidity !== undefined) ambient.push(`Humidity: ${data.humidity.toFixed(0)}%`);
-    if (ambient.length > 0) lines.push(`[${time}] Ambient: ${ambient.join(' | ')}`);
-
-    lines.forEach(line => console.log(line));
+  private async showStatistics(): Promise<void> {
+    const { bus, protocol, commands, pgns } = await this.protocol.getMetrics();
+    const latency = (h: HistogramSnapshot) => h.count === 0
+      ? '--'
+      : `p50 <${formatUs(histogramQuantile(h, 0.5))}  p99 <${formatUs(histogramQuantile(h, 0.99))}  max ${formatUs(h.maxUs)}`;
+
+    console.log('\n=== Statistics ===\n');
+    console.log('Bus:');
+    console.log(`  Received:        ${bus.framesReceived} frames, ${bus.bytesReceived} bytes`);
+    console.log(`  Sent:            ${bus.framesSent} frames, ${bus.bytesSent} bytes`);
+    console.log(`  Send errors:     ${bus.sendErrors}`);
+    if (bus.busLoad) console.log(`  Bus load:        ${bus.busLoad.toFixed(1)}%`);
+    if (bus.txQueued || bus.txDropped || bus.txStalls) {
+      console.log(`  TX queue:        ${bus.txQueued} waiting, ${bus.txDropped} dropped, ${bus.txStalls} stalls`);
+    }
+    console.log('\nDecoder:');
+    console.log(`  Processed:       ${protocol.framesProcessed} frames`);
+    console.log(`  Decoded:         ${protocol.framesDecoded} sensor frames`);
+    if (protocol.dbcDecoded) console.log(`  DBC:             ${protocol.dbcDecoded} frames`);
+    console.log(`  Dropped (SA):    ${protocol.droppedBySource}`);
+    console.log(`  Unknown PGN:     ${protocol.unknownPgn}`);
+    console.log(`  Batch time:      ${latency(protocol.decodeBatch)}`);
+    if (pgns.length > 0) {
+      console.log('\nBroadcasts:');
+      for (const h of pgns) {
+        console.log(
+          `  PGN ${String(h.pgn).padEnd(6)}   ${h.stale ? 'STALE' : 'ok   '}  every ${h.intervalMs} ms, ` +
+          `${h.frames} frames, ${h.missed} missed, jitter ${formatUs(h.jitterUs)} (max ${formatUs(h.maxJitterUs)})`
+        );
+      }
+    }
+    console.log('\nCommands:');
+    console.log(`  Sent:            ${commands.sent} (${commands.retries} retries)`);
+    console.log(`  Responses:       ${commands.responses}`);
+    console.log(`  Timeouts:        ${commands.timeouts}`);
+    console.log(`  Failed:          ${commands.failed}`);
+    console.log(`  Pending:         ${commands.pending}`);
+    console.log(`  Round trip:      ${latency(commands.roundTrip)}`);
+    console.log(`  Timeout:         ${commands.timeoutMs} ms (adaptive)`);
+    await this.prompt('\nPress Enter to continue...');
   }
 
   private async saveConfig(): Promise<void> {
     console.log('\nSaving configuration to EEPROM...');
-    const success = await this.protocol.save();
+    const success = await this.model.save();
     console.log(success ? 'OK: Configuration saved' : 'Failed to save');
     await this.prompt('Press Enter to continue...');
   }
@@ -259,8 +326,37 @@ export class Menu {
     }
 
     console.log('\nResetting configuration...');
-    const success = await this.protocol.reset();
+    const success = await this.model.reset();
     console.log(success ? 'OK: Configuration reset' : 'Failed to reset');
     await this.prompt('Press Enter to continue...');
   }
 }
+
+function printConfig(config: ConfigState): void {
+  console.log(`Thermocouple type: ${config.tcType === undefined ? '--' : TC_TYPES[config.tcType] ?? config.tcType}`);
+  for (let input = 1; input <= TEMP_INPUTS; input++) {
+    const preset = config.ntcPresets.get(input);
+    console.log(`  Temp input ${input}: ${preset === undefined ? '--' : NTC_PRESETS[preset] ?? preset}`);
+  }
+  for (let input = 1; input <= PRESSURE_INPUTS; input++) {
+    const preset = config.pressurePresets.get(input);
+    console.log(`  Pressure input ${input}: ${preset === undefined ? '--' : pressurePresetName(preset) ?? preset}`);
+  }
+  const spns = [...config.spns.entries()].filter(([, s]) => s.enable).sort((a, b) => a[0] - b[0]);
+  console.log(`\nEnabled SPNs (${spns.length}):`);
+  for (const [spn, setting] of spns) {
+    console.log(`  SPN ${spn} on input ${setting.input}`);
+  }
+}
+
+function formatAge(ms: number): string {
+  const minutes = Math.round(ms / 60000);
+  if (minutes < 1) return 'moments';
+  if (minutes < 120) return `${minutes} min`;
+  const hours = Math.round(minutes / 60);
+  return hours < 48 ? `${hours} h` : `${Math.round(hours / 24)} days`;
+}
+
+function formatUs(us: number): string {
+  return us >= 1000 ? `${(us / 1000).toFixed(1)} ms` : `${Math.round(us)} us`;
+}